@@ -17,6 +17,11 @@ else()
 	find_package(Boost REQUIRED COMPONENTS system filesystem date_time thread)
 endif()
 
+find_package(Threads REQUIRED)
+
+# sudo apt install zlib1g-dev
+find_package(ZLIB REQUIRED)
+
 include(FetchContent)
 
 # {fmtlib}
@@ -27,6 +27,7 @@ function(add_project_library TARGET)
 		SOURCES
 		PUBLIC_HEADERS
 		UNIT_TEST_SOURCES
+		INTEGRATION_TEST_SOURCES
 		MOCK_SOURCES
 		PRIVATE_DEFINITIONS
 		PRIVATE_INCLUDE_DIRS
@@ -74,6 +75,17 @@ function(add_project_library TARGET)
 		run_unit_test_on_build(${TARGET}_unit_test)
 	endif()
 
+	# Integration tests are not run on build, they need servers that are configured through the environment
+	if(P_INTEGRATION_TEST_SOURCES AND ${PROJECT_NAME_UC}_TEST AND ${PROJECT_NAME_UC}_INTEGRATION_TEST)
+		add_executable(${TARGET}_integration_test ${P_INTEGRATION_TEST_SOURCES} $<TARGET_OBJECTS:${TARGET}_objects>)
+		list(APPEND COMPILE_TARGETS ${TARGET}_integration_test)
+
+		target_link_libraries(${TARGET}_integration_test PRIVATE gtest_main)
+		list(APPEND LINK_TARGETS ${TARGET}_integration_test)
+
+		gtest_discover_tests(${TARGET}_integration_test)
+	endif()
+
 	# Add library alias
 	add_library(${PROJECT_NAME}::${TARGET} ALIAS ${TARGET})
 
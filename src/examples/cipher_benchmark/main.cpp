@@ -0,0 +1,163 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Measures the SFTP upload and download throughput per cipher.
+//
+// Usage: cipher_benchmark <host> <user> [size in MiB] [remote directory] [cipher...]
+//
+// Meant for a local sshd, so the link does not limit the throughput and the CPU cost of the cipher shows.
+// Authenticates with the private keys in ~/.ssh, or with the password in FLEXFS_BENCHMARK_PASSWORD.
+// The host key is not verified.
+
+#include "flexfs/sftp/sftp_access.h"
+#include "flexfs/core/i_file.h"
+#include "flexfs/core/noop_interruptor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr auto block_size = std::size_t{ 262144u };
+
+class accept_all_hosts final : public flexfs::sftp::i_ssh_known_hosts
+{
+public:
+	result verify(const std::string& /*host*/, const std::string& /*pubkey_hash*/) override
+	{
+		return result::KNOWN;
+	}
+
+	void persist(const std::string& /*host*/, const std::string& /*pubkey_hash*/) override
+	{
+	}
+};
+
+class home_ssh_identities final : public flexfs::sftp::i_ssh_identity_factory
+{
+public:
+	std::vector<std::shared_ptr<flexfs::sftp::ssh_identity>> create() override
+	{
+		auto       result = std::vector<std::shared_ptr<flexfs::sftp::ssh_identity>>{};
+		const auto home   = std::getenv("HOME");
+		if (!home)
+		{
+			return result;
+		}
+		for (const auto name : { "id_ed25519", "id_ecdsa", "id_rsa" })
+		{
+			auto file = std::ifstream{ std::string{ home } + "/.ssh/" + name };
+			if (file)
+			{
+				auto pkey = std::ostringstream{};
+				pkey << file.rdbuf();
+				result.push_back(std::make_shared<flexfs::sftp::ssh_identity>(flexfs::sftp::ssh_identity{ name, pkey.str() }));
+			}
+		}
+		return result;
+	}
+};
+
+// Returns the throughput in MiB/s
+double measure(std::size_t size_mib, const std::function<void()>& transfer)
+{
+	const auto start = std::chrono::steady_clock::now();
+	transfer();
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return static_cast<double>(size_mib) / seconds;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: " << argv[0] << " <host> <user> [size in MiB] [remote directory] [cipher...]\n";
+		return 2;
+	}
+
+	auto opts = flexfs::sftp::options{};
+	opts.host = argv[1];
+	opts.user = argv[2];
+	if (const auto password = std::getenv("FLEXFS_BENCHMARK_PASSWORD"))
+	{
+		opts.password = password;
+	}
+
+	const auto size_mib = argc > 3 ? std::stoul(argv[3]) : 256ul;
+	const auto path     = std::string{ argc > 4 ? argv[4] : "/tmp" } + "/flexfs-cipher-benchmark";
+
+	auto ciphers = std::vector<std::string>{ argv + std::min(argc, 5), argv + argc };
+	if (ciphers.empty())
+	{
+		ciphers = { "aes128-gcm@openssh.com", "aes256-gcm@openssh.com", "chacha20-poly1305@openssh.com", "aes128-ctr", "aes256-ctr" };
+	}
+
+	auto block  = std::vector<char>(block_size);
+	auto random = std::mt19937{ 42u };
+	for (auto& c : block)
+	{
+		c = static_cast<char>(random()); // incompressible
+	}
+	const auto blocks = size_mib * 1048576u / block_size;
+
+	std::cout << std::left << std::setw(32) << "cipher" << std::right << std::setw(14) << "upload MiB/s" << std::setw(16)
+	          << "download MiB/s" << '\n';
+
+	auto status = 0;
+	for (const auto& cipher : ciphers)
+	{
+		std::cout << std::left << std::setw(32) << cipher << std::flush;
+		try
+		{
+			opts.ciphers = { cipher };
+			auto access  = flexfs::sftp::access{ opts,
+				                                 std::make_shared<accept_all_hosts>(),
+				                                 std::make_shared<home_ssh_identities>(),
+				                                 std::make_shared<flexfs::noop_interruptor>() };
+
+			const auto upload = measure(size_mib, [&] {
+				const auto file = access.open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+				for (auto i = std::size_t{}; i < blocks; ++i)
+				{
+					for (auto pos = std::size_t{}; pos < block.size();)
+					{
+						pos += file->write(block.data() + pos, block.size() - pos);
+					}
+				}
+			});
+
+			const auto download = measure(size_mib, [&] {
+				const auto file = access.open(path, O_RDONLY, 0);
+				while (file->read(block.data(), block.size()))
+				{
+				}
+			});
+
+			access.remove(path);
+			std::cout << std::right << std::fixed << std::setprecision(1) << std::setw(14) << upload << std::setw(16) << download
+			          << '\n';
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << "failed: " << e.what() << '\n';
+			status = 1;
+		}
+	}
+	return status;
+}
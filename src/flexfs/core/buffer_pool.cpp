@@ -0,0 +1,148 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/buffer_pool.h"
+#include <boost/align/aligned_alloc.hpp>
+#include <algorithm>
+#include <new>
+#include <cassert>
+
+namespace flexfs {
+
+buffer_pool::lease::lease() noexcept
+    : pool_{ nullptr }
+    , data_{ nullptr }
+{
+}
+
+buffer_pool::lease::lease(buffer_pool* pool, char* data) noexcept
+    : pool_{ pool }
+    , data_{ data }
+{
+}
+
+buffer_pool::lease::~lease() noexcept
+{
+	if (this->data_)
+	{
+		this->pool_->release(this->data_);
+	}
+}
+
+buffer_pool::lease::lease(lease&& src) noexcept
+    : pool_{ src.pool_ }
+    , data_{ src.data_ }
+{
+	src.data_ = nullptr;
+}
+
+buffer_pool::lease& buffer_pool::lease::operator=(lease&& src) noexcept
+{
+	if (this != &src)
+	{
+		if (this->data_)
+		{
+			this->pool_->release(this->data_);
+		}
+		this->pool_ = src.pool_;
+		this->data_ = src.data_;
+		src.data_   = nullptr;
+	}
+	return *this;
+}
+
+char* buffer_pool::lease::data() const noexcept
+{
+	return this->data_;
+}
+
+std::size_t buffer_pool::lease::size() const noexcept
+{
+	return this->data_ ? this->pool_->buffer_size() : 0u;
+}
+
+buffer_pool::lease::operator bool() const noexcept
+{
+	return this->data_ != nullptr;
+}
+
+buffer_pool::buffer_pool(std::size_t buffer_size, std::size_t max_buffers)
+    : buffer_size_{ (std::max(buffer_size, std::size_t{ 1u }) + alignment - 1u) / alignment * alignment }
+    , max_buffers_{ std::max(max_buffers, std::size_t{ 1u }) }
+    , allocated_{}
+    , idle_{}
+    , mutex_{}
+    , cv_{}
+{
+}
+
+buffer_pool::~buffer_pool() noexcept
+{
+	assert(this->idle_.size() == this->allocated_);
+	for (const auto data : this->idle_)
+	{
+		boost::alignment::aligned_free(data);
+	}
+}
+
+std::size_t buffer_pool::buffer_size() const noexcept
+{
+	return this->buffer_size_;
+}
+
+std::size_t buffer_pool::max_buffers() const noexcept
+{
+	return this->max_buffers_;
+}
+
+char* buffer_pool::take(std::unique_lock<std::mutex>& /*lock*/)
+{
+	if (!this->idle_.empty())
+	{
+		const auto data = this->idle_.back();
+		this->idle_.pop_back();
+		return data;
+	}
+	else if (this->allocated_ < this->max_buffers_)
+	{
+		this->idle_.reserve(this->allocated_ + 1u);
+		const auto data = static_cast<char*>(boost::alignment::aligned_alloc(alignment, this->buffer_size_));
+		if (!data)
+		{
+			throw std::bad_alloc{};
+		}
+		++this->allocated_;
+		return data;
+	}
+	return nullptr;
+}
+
+void buffer_pool::release(char* data) noexcept
+{
+	{
+		auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+		this->idle_.push_back(data); // does not allocate, the capacity is reserved when the buffer is allocated
+	}
+	this->cv_.notify_one();
+}
+
+buffer_pool::lease buffer_pool::acquire()
+{
+	auto  lock = std::unique_lock<std::mutex>{ this->mutex_ };
+	char* data = nullptr;
+	this->cv_.wait(lock, [&] { return (data = this->take(lock)) != nullptr; });
+	return lease{ this, data };
+}
+
+buffer_pool::lease buffer_pool::try_acquire()
+{
+	auto       lock = std::unique_lock<std::mutex>{ this->mutex_ };
+	const auto data = this->take(lock);
+	return data ? lease{ this, data } : lease{};
+}
+
+} // namespace flexfs
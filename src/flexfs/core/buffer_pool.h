@@ -0,0 +1,80 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+namespace flexfs {
+
+/// @brief Thread safe pool of equally sized transfer buffers.
+/// Shared between copies, it bounds the memory used by many concurrent copies and avoids reallocating
+/// the buffers for each file. The buffers are aligned for direct I/O.
+/// The pool must outlive all leases taken from it.
+class FLEXFS_EXPORT buffer_pool final
+{
+public:
+	static constexpr std::size_t alignment = 4096u;
+
+	/// @brief A buffer taken from the pool, returned to the pool on destruction.
+	class FLEXFS_EXPORT lease final
+	{
+		buffer_pool* pool_;
+		char*        data_;
+
+	public:
+		lease() noexcept;
+		lease(buffer_pool* pool, char* data) noexcept;
+		~lease() noexcept;
+
+		lease(lease&& src) noexcept;
+		lease& operator=(lease&& src) noexcept;
+
+		lease(const lease&)            = delete;
+		lease& operator=(const lease&) = delete;
+
+		char*       data() const noexcept;
+		std::size_t size() const noexcept;
+
+		explicit operator bool() const noexcept;
+	};
+
+private:
+	std::size_t             buffer_size_;
+	std::size_t             max_buffers_;
+	std::size_t             allocated_;
+	std::vector<char*>      idle_;
+	std::mutex              mutex_;
+	std::condition_variable cv_;
+
+	char* take(std::unique_lock<std::mutex>& lock);
+	void  release(char* data) noexcept;
+
+public:
+	/// @param buffer_size Size of each buffer, rounded up to a multiple of the alignment.
+	/// @param max_buffers Maximum number of buffers in use at the same time.
+	explicit buffer_pool(std::size_t buffer_size, std::size_t max_buffers);
+	~buffer_pool() noexcept;
+
+	buffer_pool(const buffer_pool&)            = delete;
+	buffer_pool& operator=(const buffer_pool&) = delete;
+
+	std::size_t buffer_size() const noexcept;
+	std::size_t max_buffers() const noexcept;
+
+	/// Waits until a buffer is available.
+	lease acquire();
+
+	/// Returns an empty lease if no buffer is available.
+	lease try_acquire();
+};
+
+} // namespace flexfs
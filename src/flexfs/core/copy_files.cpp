@@ -0,0 +1,327 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/copy_files.h"
+#include "flexfs/core/noop_interruptor.h"
+#include "flexfs/core/exceptions.h"
+#include "flexfs/core/logging.h"
+#include "flexfs/core/formatters.h"
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <thread>
+#include <utility>
+
+namespace flexfs {
+
+namespace {
+
+bool needs_positions(copy_files_options::order order)
+{
+	return order == copy_files_options::order::INODE || order == copy_files_options::order::PHYSICAL;
+}
+
+// The disk positions of the source files, for the orders that need them
+std::vector<std::optional<std::uint64_t>> locate(i_access&                    access,
+                                                 const std::vector<copy_job>& jobs,
+                                                 copy_files_options::order    order,
+                                                 i_interruptor&               interruptor)
+{
+	auto&& locate_by = [&](i_access::position_kind kind) {
+		auto result = std::vector<std::optional<std::uint64_t>>(jobs.size());
+		for (auto job = std::size_t{}; job < jobs.size(); ++job)
+		{
+			interruptor.throw_if_interrupted();
+			try
+			{
+				result[job] = access.disk_position(jobs[job].source.current_path, kind);
+			}
+			catch (const interrupted_exception&)
+			{
+				throw;
+			}
+			catch (const std::exception& e)
+			{
+				// The copy reports the problem
+				fslog(debug, "cannot locate {}: {}", jobs[job].source.current_path, e.what());
+			}
+		}
+		return result;
+	};
+
+	if (order == copy_files_options::order::PHYSICAL)
+	{
+		auto result = locate_by(i_access::position_kind::EXTENT);
+		if (std::any_of(result.begin(), result.end(), [](const auto& position) { return position.has_value(); }))
+		{
+			return result;
+		}
+		fslog(debug, "no extents reported, ordering by inode");
+	}
+	return locate_by(i_access::position_kind::INODE);
+}
+
+// positions is empty unless needs_positions(order)
+std::vector<std::size_t> schedule(const std::vector<copy_job>&                     jobs,
+                                  copy_files_options::order                        order,
+                                  const std::vector<std::optional<std::uint64_t>>& positions)
+{
+	auto result = std::vector<std::size_t>(jobs.size());
+	std::iota(result.begin(), result.end(), std::size_t{});
+
+	auto&& size_of = [&](std::size_t job) { return jobs[job].size.value_or(0u); };
+	switch (order)
+	{
+	case copy_files_options::order::AS_GIVEN:
+		break;
+	case copy_files_options::order::SMALLEST_FIRST:
+		std::stable_sort(result.begin(), result.end(), [&](std::size_t a, std::size_t b) { return size_of(a) < size_of(b); });
+		break;
+	case copy_files_options::order::LARGEST_FIRST:
+		std::stable_sort(result.begin(), result.end(), [&](std::size_t a, std::size_t b) { return size_of(a) > size_of(b); });
+		break;
+	case copy_files_options::order::INODE:
+	case copy_files_options::order::PHYSICAL:
+		// Unknown positions go last
+		std::stable_sort(result.begin(), result.end(), [&](std::size_t a, std::size_t b) {
+			return positions[a].has_value() && (!positions[b].has_value() || positions[a].value() < positions[b].value());
+		});
+		break;
+	}
+	return result;
+}
+
+class batch final
+{
+	const std::function<copy_worker_access()>&                        make_access_;
+	const std::vector<copy_job>&                                      jobs_;
+	const copy_files_options&                                         opts_;
+	const std::function<void(const copy_files_progress&)>&            on_progress_;
+	const std::function<void(std::size_t, const copy_files_status&)>& on_done_;
+	std::shared_ptr<i_interruptor>                                    interruptor_;
+	std::vector<std::size_t>                                          order_;
+	std::vector<copy_files_status>                                    statuses_;
+	std::vector<std::uint64_t>                                        in_progress_; // bytes copied of the current job, per worker
+	std::mutex                                                        mutex_;
+	std::size_t                                                       next_; // in order_
+	std::size_t                                                       files_done_;
+	std::uint64_t                                                     bytes_done_; // of the finished jobs
+	std::uint64_t                                                     bytes_total_;
+	std::exception_ptr                                                access_error_;
+	std::optional<copy_worker_access>                                 spare_access_; // made for locating the source files
+
+	std::optional<std::size_t> take()
+	{
+		auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+		if (this->next_ < this->order_.size())
+		{
+			return this->order_[this->next_++];
+		}
+		return std::nullopt;
+	}
+
+	std::optional<copy_worker_access> take_spare_access()
+	{
+		auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+		return std::exchange(this->spare_access_, std::nullopt);
+	}
+
+	// Must be called with the mutex locked
+	void report()
+	{
+		if (this->on_progress_)
+		{
+			auto bytes = this->bytes_done_;
+			for (const auto n : this->in_progress_)
+			{
+				bytes += n;
+			}
+			this->on_progress_(copy_files_progress{ this->files_done_, this->jobs_.size(), bytes, this->bytes_total_ });
+		}
+	}
+
+	void progress(std::size_t worker, std::uint64_t bytes_copied)
+	{
+		auto lock                  = std::lock_guard<std::mutex>{ this->mutex_ };
+		this->in_progress_[worker] = bytes_copied;
+		this->report();
+	}
+
+	void done(std::size_t worker, std::size_t job, copy_files_status status)
+	{
+		auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+		this->bytes_done_ += status.result ? status.result->size : this->in_progress_[worker];
+		this->in_progress_[worker] = 0u;
+		++this->files_done_;
+		this->statuses_[job] = std::move(status);
+		if (this->on_done_)
+		{
+			this->on_done_(job, this->statuses_[job]);
+		}
+		this->report();
+	}
+
+	void work(std::size_t worker)
+	{
+		auto access = copy_worker_access{};
+		try
+		{
+			auto spare = this->take_spare_access();
+			access     = spare ? std::move(spare.value()) : this->make_access_();
+		}
+		catch (...)
+		{
+			fslog(err, "copy worker {} could not get access", worker);
+			auto lock           = std::lock_guard<std::mutex>{ this->mutex_ };
+			this->access_error_ = std::current_exception();
+			return;
+		}
+
+		auto copied = std::vector<std::size_t>{}; // jobs of this worker that are not durable yet
+		while (const auto job = this->take())
+		{
+			auto status = copy_files_status{};
+			try
+			{
+				this->interruptor_->throw_if_interrupted();
+				const auto& j           = this->jobs_[job.value()];
+				auto&&      on_progress = [&](std::uint64_t bytes_copied) { this->progress(worker, bytes_copied); };
+				status.result           = copy_file(*access.source, j.source, *access.dest, j.dest, this->opts_.copy, on_progress);
+			}
+			catch (...)
+			{
+				status.error = std::current_exception();
+			}
+			if (status.result && !status.result->skipped)
+			{
+				copied.push_back(job.value());
+			}
+			this->done(worker, job.value(), std::move(status));
+		}
+
+		if (this->opts_.copy.durability == copy_options::durability_mode::BATCH)
+		{
+			this->sync(*access.dest, copied);
+		}
+	}
+
+	// Flushes the file systems the copied files were written to, once each
+	void sync(i_access& dest_access, const std::vector<std::size_t>& copied)
+	{
+		auto dirs = std::set<fspath>{};
+		for (const auto job : copied)
+		{
+			const auto dir = this->statuses_[job].result->dest_path.parent_path();
+			dirs.insert(dir.empty() ? fspath{ "." } : dir);
+		}
+		try
+		{
+			for (const auto& dir : dirs)
+			{
+				if (!dest_access.sync_fs(dir))
+				{
+					fslog(debug, "cannot flush the file system of {}", dir);
+				}
+			}
+		}
+		catch (...)
+		{
+			fslog(err, "could not flush the copied files to stable storage");
+			auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+			for (const auto job : copied)
+			{
+				this->statuses_[job].result.reset();
+				this->statuses_[job].error = std::current_exception();
+			}
+		}
+	}
+
+public:
+	explicit batch(const std::function<copy_worker_access()>&                        make_access,
+	               const std::vector<copy_job>&                                      jobs,
+	               const copy_files_options&                                         opts,
+	               const std::function<void(const copy_files_progress&)>&            on_progress,
+	               const std::function<void(std::size_t, const copy_files_status&)>& on_done)
+	    : make_access_{ make_access }
+	    , jobs_{ jobs }
+	    , opts_{ opts }
+	    , on_progress_{ on_progress }
+	    , on_done_{ on_done }
+	    , interruptor_{ opts.copy.interruptor ? opts.copy.interruptor : std::make_shared<noop_interruptor>() }
+	    , order_{}
+	    , statuses_(jobs.size())
+	    , in_progress_(std::max(std::min(opts.workers, jobs.size()), std::size_t{ 1u }))
+	    , mutex_{}
+	    , next_{}
+	    , files_done_{}
+	    , bytes_done_{}
+	    , bytes_total_{}
+	    , access_error_{}
+	    , spare_access_{}
+	{
+		for (const auto& job : jobs)
+		{
+			this->bytes_total_ += job.size.value_or(0u);
+		}
+	}
+
+	std::vector<copy_files_status> run()
+	{
+		auto positions = std::vector<std::optional<std::uint64_t>>{};
+		if (needs_positions(this->opts_.schedule) && !this->jobs_.empty())
+		{
+			try
+			{
+				this->spare_access_ = this->make_access_();
+				positions = locate(*this->spare_access_->source, this->jobs_, this->opts_.schedule, *this->interruptor_);
+			}
+			catch (const std::exception& e)
+			{
+				// The jobs are copied in the given order, or fail when the workers cannot get an access either
+				fslog(warn, "could not locate the source files: {}", e.what());
+				positions.assign(this->jobs_.size(), std::nullopt);
+			}
+		}
+		this->order_ = schedule(this->jobs_, this->opts_.schedule, positions);
+
+		auto threads = std::vector<std::thread>{};
+		for (auto worker = std::size_t{}; worker < this->in_progress_.size(); ++worker)
+		{
+			threads.emplace_back([this, worker] { this->work(worker); });
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		// Left over when no worker got an access
+		for (auto job = this->take(); job; job = this->take())
+		{
+			this->statuses_[job.value()].error = this->access_error_;
+			if (this->on_done_)
+			{
+				this->on_done_(job.value(), this->statuses_[job.value()]);
+			}
+		}
+
+		return std::move(this->statuses_);
+	}
+};
+
+} // namespace
+
+std::vector<copy_files_status> copy_files(const std::function<copy_worker_access()>&                 make_access,
+                                          const std::vector<copy_job>&                               jobs,
+                                          const copy_files_options&                                  opts,
+                                          std::function<void(const copy_files_progress&)>            on_progress,
+                                          std::function<void(std::size_t, const copy_files_status&)> on_done)
+{
+	return batch{ make_access, jobs, opts, on_progress, on_done }.run();
+}
+
+} // namespace flexfs
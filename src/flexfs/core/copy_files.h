@@ -0,0 +1,88 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/i_access.h"
+#include "flexfs/core/source.h"
+#include "flexfs/core/destination.h"
+#include "flexfs/core/copy_options.h"
+#include "flexfs/core/operations.h"
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace flexfs {
+
+struct FLEXFS_EXPORT copy_job
+{
+	flexfs::source               source;
+	flexfs::destination          dest;
+	std::optional<std::uint64_t> size; // of the source file if known, e.g. from a directory listing
+};
+
+// The accesses used by one worker. A remote access cannot be used from two threads at the same time, so
+// each worker gets its own session.
+struct FLEXFS_EXPORT copy_worker_access
+{
+	std::shared_ptr<i_access> source;
+	std::shared_ptr<i_access> dest;
+};
+
+struct FLEXFS_EXPORT copy_files_options
+{
+	enum class order
+	{
+		AS_GIVEN,
+		SMALLEST_FIRST, // many small files complete early, files of unknown size go first
+		LARGEST_FIRST,  // the long transfers do not end up last on a single worker
+		INODE,          // by inode number of the source file, which saves seeks when reading from rotational disks
+		PHYSICAL        // by disk position of the data of the source file (FIEMAP), by inode where that is not known
+	};
+
+	std::size_t  workers  = 4u; // number of concurrent copies
+	order        schedule = order::AS_GIVEN;
+	copy_options copy; // for each file. Its pool and rate limiter, if any, are shared by the workers
+};
+
+struct FLEXFS_EXPORT copy_files_progress
+{
+	std::size_t   files_done;  // succeeded or failed
+	std::size_t   files_total;
+	std::uint64_t bytes_done;  // by all workers, including the files in progress
+	std::uint64_t bytes_total; // sum of the known job sizes
+};
+
+struct FLEXFS_EXPORT copy_files_status
+{
+	std::optional<copy_result> result; // if the copy succeeded
+	std::exception_ptr         error;  // if it failed
+};
+
+/// Copies a batch of files on a pool of worker threads.
+/// Every worker calls make_access once, on its own thread. When that throws, the worker does not take part
+/// and the jobs nobody could take fail with that error.
+/// The INODE and PHYSICAL orders locate the source files before the copies start, with an access that
+/// make_access makes on the calling thread and that is handed to a worker afterwards. Files that cannot be
+/// located go last. Use a single worker to read the files strictly in that order.
+/// A failed copy does not stop the others. The workers stop taking jobs when copy.interruptor is
+/// interrupted, the remaining jobs fail with interrupted_exception.
+/// With the BATCH durability mode, each worker flushes the destination file systems after its last job, so
+/// on_done can report a copy before it is durable. When that flush fails, the jobs of that worker fail.
+/// @return The status of each job, in the order of jobs.
+FLEXFS_EXPORT std::vector<copy_files_status> copy_files(const std::function<copy_worker_access()>&                 make_access,
+                                                        const std::vector<copy_job>&                               jobs,
+                                                        const copy_files_options&                                  opts,
+                                                        std::function<void(const copy_files_progress&)>            on_progress = nullptr,
+                                                        std::function<void(std::size_t, const copy_files_status&)> on_done = nullptr);
+
+} // namespace flexfs
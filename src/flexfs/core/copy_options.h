@@ -0,0 +1,155 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/buffer_pool.h"
+#include "flexfs/core/digest.h"
+#include "flexfs/core/i_interruptor.h"
+#include "flexfs/core/rate_limiter.h"
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace flexfs {
+
+struct FLEXFS_EXPORT copy_options
+{
+	enum class sparse_mode
+	{
+		NEVER,  // Copy every byte.
+		AUTO,   // Skip the holes of the source file, the destination file gets the same holes.
+		ALWAYS  // Like AUTO, and also turn runs of zero bytes into holes in the destination file.
+	};
+
+	enum class durability_mode
+	{
+		NONE,     // Leave the writeback to the operating system, a crash can lose the last copies.
+		PER_FILE, // Flush each destination file to stable storage before the copy completes.
+		BATCH     // Start the writeback of each local destination file, flush the file systems once at the end.
+	};
+
+	enum class compression_mode
+	{
+		NONE,
+		GZIP // the destination file is in gzip format
+	};
+
+	enum class skip_mode
+	{
+		NEVER,      // Always copy.
+		SIZE_MTIME, // Skip when the destination file has the size and modification time of the source file.
+		CHECKSUM    // Skip when the destination file has the size and digest of the source file.
+	};
+
+	// Bypass the page cache (O_DIRECT) for local source and destination files.
+	// Transfers are done with aligned buffers, unaligned tails fall back to buffered I/O.
+	// Has no effect on remote files, nor on platforms without O_DIRECT.
+	bool direct_io = false;
+
+	// Hole detection on the source file requires SEEK_DATA/SEEK_HOLE support, i.e. a local file on a file
+	// system that supports it. Holes in the destination file are created by seeking over them, which also
+	// works for SFTP uploads to servers that write at the requested offsets (e.g. OpenSSH).
+	sparse_mode sparse = sparse_mode::NEVER;
+
+	// Reserve the disk space for the destination file up front (fallocate), which avoids fragmentation and
+	// reports a full disk before anything is copied. The file keeps the size of the data written so far, space
+	// reserved beyond it is released when the copy completes or fails.
+	// Only done for local destinations on file systems that support it, and not combined with sparse copying.
+	bool preallocate = false;
+
+	// Size of the transfer buffers. 0 selects the size from the kind of files (local or remote) and the size
+	// of the source file, the amount read at once then adapts to the measured throughput. Any other value
+	// rules out the copy by the server or the kernel, see copy_file.
+	std::size_t buffer_size = 0;
+
+	// Number of transfer buffers. With more than one buffer, the source file is read on a separate thread
+	// while the destination file is written. 0 selects the number automatically.
+	// Sparse copies and copies within the same remote session use a single buffer.
+	std::size_t buffer_count = 1;
+
+	// Pool to take the transfer buffers from, instead of allocating them for this copy. Overrides buffer_size.
+	// When the pool has fewer buffers available than buffer_count, the copy continues with fewer buffers.
+	std::shared_ptr<buffer_pool> pool;
+
+	// Digests to compute over the source data while it is copied, returned in copy_result::digests.
+	std::vector<digest_algorithm> digests;
+
+	// Compare the digests of the destination file after the copy to those of the source data. Throws on a
+	// mismatch. The destination access computes them with i_access::checksum where it can, the file is read
+	// back otherwise. When no digests are requested, SHA-256 is used for a remote destination and CRC32C for
+	// a local one.
+	bool verify = false;
+
+	// Write to <dest>.part and continue an earlier, interrupted copy of the same source file instead of
+	// starting over. The source size and modification time are kept in <dest>.part.info, the partial file
+	// is continued at its current size if they still match. It is renamed to the destination path when the
+	// copy completes, and left in place when the copy fails. Unless the conflict policy is OVERWRITE, the
+	// policy is applied again at the rename, in case the destination path was taken in the meantime.
+	// Preallocation is not done in this mode, since the size of the partial file is the progress made.
+	bool resume = false;
+
+	// Before continuing a partial file, compare its last resume_verify_size bytes to the source file, and
+	// start over if they differ. Guards against a tail that did not make it to disk. 0 disables the check.
+	std::uint64_t resume_verify_size = 65536u;
+
+	// When the destination file already exists, update it in place instead of rewriting it: block signatures
+	// of the existing file are computed, the source file is scanned for those blocks with a rolling checksum,
+	// and only the ranges that are not found at the same offset are written, with positional writes.
+	// Worth it for remote destinations with a previous version that changed in a few places. The existing
+	// file is read once, the source file is read once and then again for the ranges that are written. Blocks
+	// found at another offset are written too, so when less than half of the file would be kept (e.g. after
+	// an insertion near the start) the file is copied as a whole instead. An interrupted update leaves a mix
+	// of both versions. Ignored in resume mode and for sparse copies.
+	bool delta = false;
+
+	// Make the destination file a hard link to the source file instead of copying the data, when both are on
+	// the same local file system or on the same server (hardlink@openssh.com). The two names then share the
+	// data and the attributes, changes through one show through the other. The data is copied when a link
+	// cannot be made. Under the OVERWRITE policy, an existing destination file is replaced by making the link
+	// as <dest>.link and renaming it to the destination path. Ignored in resume mode.
+	bool hard_link = false;
+
+	// Leave an existing destination file alone when it matches the source file, which makes reruns of a copy
+	// cheap. Modification times are compared to the second, and only match when the earlier copy preserved it.
+	// The digests are computed with i_access::checksum where possible. The destination file that is checked is
+	// the one the OVERWRITE policy would replace, also under the other conflict policies.
+	skip_mode skip_unchanged = skip_mode::NEVER;
+
+	// Give the destination file the modification time and the permissions of the source file when the copy
+	// completes, or when an unchanged destination file is skipped. A hard link shares them with the source.
+	bool preserve_mtime = false;
+	bool preserve_mode  = false;
+
+	// When the data of the destination files is on stable storage. PER_FILE uses fdatasync locally and the
+	// fsync@openssh.com extension remotely, and waits for each file, which is slow for many small files.
+	// BATCH lets the disk write many files at once: copy_file only starts the writeback (sync_file_range),
+	// and copy_files flushes the file systems of the destination files (syncfs) after its last copy. Until
+	// then, a completed copy is not durable. Remote files are flushed one by one in both modes, since SFTP
+	// cannot flush a file system. When the server does not support it, nothing is flushed.
+	durability_mode durability = durability_mode::NONE;
+
+	// Compress the data into the destination file, which is then named as the destination says, e.g. with a
+	// ".gz" suffix. The compression runs on a separate thread, the source file is read meanwhile. Progress and
+	// rate limiting count the source data, copy_result::size is the compressed size. The sparse, resume, delta,
+	// hard_link, skip_unchanged and verify options do not apply, and move_file does not compress.
+	// For remote destinations, SSH compression (sftp::options::compression) is an alternative that leaves the
+	// destination file as it is.
+	compression_mode compression       = compression_mode::NONE;
+	int              compression_level = 6; // 1 (fastest) to 9 (smallest)
+
+	// Bucket to take the written bytes from. Share one between copies to cap their combined throughput, or
+	// give each copy its own bucket with a shared parent. Holes skipped in sparse copies are not counted.
+	std::shared_ptr<rate_limiter> rate_limit;
+
+	// Interrupts the waits for the rate limiter, with interrupted_exception.
+	std::shared_ptr<i_interruptor> interruptor;
+};
+
+} // namespace flexfs
@@ -0,0 +1,27 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/cpu_features.h"
+
+namespace flexfs {
+
+const cpu_features& cpu_features::get()
+{
+	static const auto features = [] {
+		auto result = cpu_features{};
+#if FLEXFS_X86_DISPATCH
+		__builtin_cpu_init();
+		result.sse42 = __builtin_cpu_supports("sse4.2");
+		result.avx2  = __builtin_cpu_supports("avx2");
+		result.sha   = __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#endif
+		return result;
+	}();
+	return features;
+}
+
+} // namespace flexfs
@@ -0,0 +1,32 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+// Run time dispatch to x86-64 extensions is done with GCC/Clang target attributes.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FLEXFS_X86_DISPATCH 1
+#define FLEXFS_TARGET(features) __attribute__((target(features)))
+#else
+#define FLEXFS_X86_DISPATCH 0
+#define FLEXFS_TARGET(features)
+#endif
+
+namespace flexfs {
+
+// CPU extensions that are used when available. A default constructed object has none of them, which
+// selects the portable implementations.
+struct cpu_features
+{
+	bool sse42 = false;
+	bool avx2  = false;
+	bool sha   = false; // SHA-NI, used together with SSE4.1
+
+	static const cpu_features& get(); // of the CPU we're running on
+};
+
+} // namespace flexfs
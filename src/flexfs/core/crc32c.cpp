@@ -0,0 +1,123 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/crc32c.h"
+#include <array>
+#include <cstring>
+
+#if FLEXFS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace flexfs {
+
+namespace {
+
+constexpr auto polynomial = std::uint32_t{ 0x82f63b78u }; // reflected
+
+using crc_tables = std::array<std::array<std::uint32_t, 256>, 8>;
+
+constexpr crc_tables make_tables()
+{
+	auto tables = crc_tables{};
+	for (auto i = std::uint32_t{}; i < 256u; ++i)
+	{
+		auto crc = i;
+		for (auto bit = 0; bit < 8; ++bit)
+		{
+			crc = (crc >> 1) ^ (polynomial & (0u - (crc & 1u)));
+		}
+		tables[0][i] = crc;
+	}
+	for (auto i = std::size_t{}; i < 256u; ++i)
+	{
+		for (auto t = std::size_t{ 1u }; t < 8u; ++t)
+		{
+			tables[t][i] = (tables[t - 1][i] >> 8) ^ tables[0][tables[t - 1][i] & 0xffu];
+		}
+	}
+	return tables;
+}
+
+constexpr auto tables = make_tables();
+
+std::uint32_t update_portable(std::uint32_t crc, const std::uint8_t* p, std::size_t size)
+{
+	while (size >= 8u)
+	{
+		auto lo = std::uint32_t{};
+		auto hi = std::uint32_t{};
+		std::memcpy(&lo, p, 4u);
+		std::memcpy(&hi, p + 4, 4u);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		lo = __builtin_bswap32(lo);
+		hi = __builtin_bswap32(hi);
+#endif
+		lo ^= crc;
+		crc = tables[7][lo & 0xffu] ^ tables[6][(lo >> 8) & 0xffu] ^ tables[5][(lo >> 16) & 0xffu] ^ tables[4][lo >> 24] //
+		      ^ tables[3][hi & 0xffu] ^ tables[2][(hi >> 8) & 0xffu] ^ tables[1][(hi >> 16) & 0xffu] ^ tables[0][hi >> 24];
+		p += 8;
+		size -= 8u;
+	}
+	while (size--)
+	{
+		crc = (crc >> 8) ^ tables[0][(crc ^ *p++) & 0xffu];
+	}
+	return crc;
+}
+
+#if FLEXFS_X86_DISPATCH
+FLEXFS_TARGET("sse4.2") std::uint32_t update_sse42(std::uint32_t crc, const std::uint8_t* p, std::size_t size)
+{
+	auto crc64 = std::uint64_t{ crc };
+	while (size >= 8u)
+	{
+		auto word = std::uint64_t{};
+		std::memcpy(&word, p, 8u);
+		crc64 = _mm_crc32_u64(crc64, word);
+		p += 8;
+		size -= 8u;
+	}
+	crc = static_cast<std::uint32_t>(crc64);
+	while (size--)
+	{
+		crc = _mm_crc32_u8(crc, *p++);
+	}
+	return crc;
+}
+#endif
+
+} // namespace
+
+crc32c_digester::crc32c_digester(const cpu_features& cpu)
+    : hw_{ cpu.sse42 }
+    , crc_{ 0xffffffffu }
+{
+}
+
+void crc32c_digester::update(const void* data, std::size_t size)
+{
+	const auto p = static_cast<const std::uint8_t*>(data);
+#if FLEXFS_X86_DISPATCH
+	if (this->hw_)
+	{
+		this->crc_ = update_sse42(this->crc_, p, size);
+		return;
+	}
+#endif
+	this->crc_ = update_portable(this->crc_, p, size);
+}
+
+digest crc32c_digester::value() const
+{
+	const auto crc = ~this->crc_;
+	return digest{ digest_algorithm::CRC32C,
+		           { static_cast<std::uint8_t>(crc >> 24), static_cast<std::uint8_t>(crc >> 16), static_cast<std::uint8_t>(crc >> 8),
+		             static_cast<std::uint8_t>(crc) } };
+}
+
+} // namespace flexfs
@@ -0,0 +1,28 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/digest.h"
+#include "flexfs/core/cpu_features.h"
+
+namespace flexfs {
+
+// CRC32C with the SSE4.2 crc32 instruction, or slice-by-8 tables.
+class crc32c_digester final : public i_digester
+{
+	bool          hw_;
+	std::uint32_t crc_;
+
+public:
+	explicit crc32c_digester(const cpu_features& cpu = cpu_features::get());
+
+	void   update(const void* data, std::size_t size) override;
+	digest value() const override;
+};
+
+} // namespace flexfs
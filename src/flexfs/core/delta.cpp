@@ -0,0 +1,291 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/delta.h"
+#include "flexfs/core/rolling_checksum.h"
+#include "flexfs/core/xxh3.h"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+namespace flexfs {
+
+namespace {
+
+constexpr auto min_block_size = std::size_t{ 1024u };
+constexpr auto max_block_size = std::size_t{ 131072u };
+
+// The new file is scanned through a buffer of this many blocks
+constexpr auto buffer_blocks = std::size_t{ 16u };
+
+std::uint64_t strong_checksum(const char* data, std::size_t size)
+{
+	auto digester = xxh3_digester{};
+	digester.update(data, size);
+	auto result = std::uint64_t{};
+	for (const auto byte : digester.value().value)
+	{
+		result = (result << 8) | byte;
+	}
+	return result;
+}
+
+std::size_t read_full(i_file& file, char* buf, std::size_t count)
+{
+	auto total = std::size_t{};
+	while (total < count)
+	{
+		const auto nread = file.read(buf + total, count - total);
+		if (nread == 0)
+		{
+			break;
+		}
+		total += nread;
+	}
+	return total;
+}
+
+// Finds the blocks of a signature by checksum
+class block_index final
+{
+	const delta_signature&                              signature_;
+	std::bitset<65536>                                  tags_; // of the weak checksums, to reject most misses quickly
+	std::unordered_multimap<std::uint32_t, std::size_t> blocks_;
+
+	static std::size_t tag(std::uint32_t weak)
+	{
+		return (weak ^ (weak >> 16)) & 0xffffu;
+	}
+
+public:
+	explicit block_index(const delta_signature& signature)
+	    : signature_{ signature }
+	    , tags_{}
+	    , blocks_{}
+	{
+		for (auto i = std::size_t{}; i < signature.blocks.size(); ++i)
+		{
+			this->tags_.set(tag(signature.blocks[i].weak));
+			this->blocks_.emplace(signature.blocks[i].weak, i);
+		}
+	}
+
+	// Returns the index of a block with the contents of data, preferring the block at preferred
+	std::optional<std::size_t> find(std::uint32_t weak, const char* data, std::size_t size, std::size_t preferred) const
+	{
+		if (!this->tags_.test(tag(weak)))
+		{
+			return std::nullopt;
+		}
+
+		auto       strong = std::optional<std::uint64_t>{};
+		auto       result = std::optional<std::size_t>{};
+		const auto range  = this->blocks_.equal_range(weak);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			const auto i = it->second;
+			if (this->block_length(i) != size)
+			{
+				continue;
+			}
+			if (!strong)
+			{
+				strong = strong_checksum(data, size);
+			}
+			if (this->signature_.blocks[i].strong == strong.value())
+			{
+				if (i == preferred)
+				{
+					return i;
+				}
+				result = result ? result : i;
+			}
+		}
+		return result;
+	}
+
+	std::size_t block_length(std::size_t i) const
+	{
+		const auto offset = static_cast<std::uint64_t>(i) * this->signature_.block_size;
+		return static_cast<std::size_t>(std::min<std::uint64_t>(this->signature_.block_size, this->signature_.file_size - offset));
+	}
+};
+
+// Merges adjacent copies before passing them on, and keeps track of the offset in the new file
+class op_writer final
+{
+	const std::function<void(const delta_op&)>& on_op_;
+	std::optional<delta_op>                     copy_;
+	std::uint64_t                               target_;
+
+public:
+	explicit op_writer(const std::function<void(const delta_op&)>& on_op)
+	    : on_op_{ on_op }
+	    , copy_{}
+	    , target_{}
+	{
+	}
+
+	void copy(std::uint64_t offset, const char* data, std::size_t length)
+	{
+		if (this->copy_ && this->copy_->offset + this->copy_->length == offset && this->copy_->data + this->copy_->length == data)
+		{
+			this->copy_->length += length;
+		}
+		else
+		{
+			this->flush();
+			this->copy_ = delta_op{ delta_op::kind::COPY, offset, this->target_, length, data };
+		}
+		this->target_ += length;
+	}
+
+	void literal(const char* data, std::size_t length)
+	{
+		if (length)
+		{
+			this->flush();
+			this->on_op_(delta_op{ delta_op::kind::LITERAL, 0u, this->target_, length, data });
+			this->target_ += length;
+		}
+	}
+
+	// Must be called before the data of a pending copy is moved
+	void flush()
+	{
+		if (this->copy_)
+		{
+			this->on_op_(this->copy_.value());
+			this->copy_.reset();
+		}
+	}
+};
+
+} // namespace
+
+std::size_t delta_signature::block_size_for(std::uint64_t file_size)
+{
+	// About the square root, rounded up to a multiple of 64
+	const auto root = static_cast<std::size_t>(std::sqrt(static_cast<double>(file_size)));
+	return std::clamp((root + 63u) & ~std::size_t{ 63u }, min_block_size, max_block_size);
+}
+
+delta_signature delta_signature::compute(i_file& file, std::size_t block_size)
+{
+	auto result = delta_signature{ block_size, 0u, {} };
+	auto buf    = std::vector<char>(block_size);
+	for (auto nread = read_full(file, buf.data(), block_size); nread; nread = read_full(file, buf.data(), block_size))
+	{
+		result.blocks.push_back(block{ rolling_checksum{ buf.data(), nread }.value(), strong_checksum(buf.data(), nread) });
+		result.file_size += nread;
+		if (nread < block_size)
+		{
+			break;
+		}
+	}
+	return result;
+}
+
+void compute_delta(i_file&                                              new_file,
+                   const delta_signature&                               old_signature,
+                   const std::function<void(const delta_op&)>&          on_op,
+                   const std::function<void(const char*, std::size_t)>& on_data)
+{
+	const auto block_size = old_signature.block_size;
+	const auto index      = block_index{ old_signature };
+	auto       ops        = op_writer{ on_op };
+	auto       buf        = std::vector<char>(block_size * buffer_blocks);
+
+	auto begin  = std::size_t{}; // start of the pending literal data in buf
+	auto pos    = std::size_t{}; // start of the window in buf
+	auto end    = std::size_t{}; // end of the data in buf
+	auto offset = std::uint64_t{}; // of buf[0] in the new file
+	auto eof    = false;
+	auto sum    = std::optional<rolling_checksum>{};
+
+	// Makes room for more data and reads it. Returns false if there is no more data.
+	auto&& fill = [&] {
+		if (eof)
+		{
+			return false;
+		}
+		ops.literal(buf.data() + begin, pos - begin);
+		ops.flush();
+		std::memmove(buf.data(), buf.data() + pos, end - pos);
+		offset += pos;
+		end -= pos;
+		begin = pos = 0u;
+
+		const auto want  = buf.size() - end;
+		const auto nread = read_full(new_file, buf.data() + end, want);
+		if (on_data && nread)
+		{
+			on_data(buf.data() + end, nread);
+		}
+		end += nread;
+		eof = nread < want;
+		return nread > 0u;
+	};
+
+	for (;;)
+	{
+		if (end - pos < block_size)
+		{
+			fill();
+			if (end - pos < block_size)
+			{
+				break;
+			}
+		}
+
+		if (!sum)
+		{
+			sum.emplace(buf.data() + pos, block_size);
+		}
+
+		const auto preferred = static_cast<std::size_t>((offset + pos) / block_size);
+		if (const auto i = index.find(sum->value(), buf.data() + pos, block_size, preferred))
+		{
+			ops.literal(buf.data() + begin, pos - begin);
+			ops.copy(static_cast<std::uint64_t>(i.value()) * block_size, buf.data() + pos, block_size);
+			pos += block_size;
+			begin = pos;
+			sum.reset();
+			continue;
+		}
+
+		if (pos + block_size == end && !fill())
+		{
+			break;
+		}
+		sum->roll(static_cast<std::uint8_t>(buf[pos]), static_cast<std::uint8_t>(buf[pos + block_size]));
+		++pos;
+	}
+
+	// What is left did not match, but may end with the short last block of the old file
+	const auto last = old_signature.blocks.empty() ? std::size_t{} : index.block_length(old_signature.blocks.size() - 1u);
+	if (last && end - pos >= last)
+	{
+		const auto at        = end - last;
+		const auto preferred = static_cast<std::size_t>((offset + at) / block_size);
+		const auto weak      = rolling_checksum{ buf.data() + at, last }.value();
+		if (const auto i = index.find(weak, buf.data() + at, last, preferred))
+		{
+			ops.literal(buf.data() + begin, at - begin);
+			ops.copy(static_cast<std::uint64_t>(i.value()) * block_size, buf.data() + at, last);
+			begin = end;
+		}
+	}
+	ops.literal(buf.data() + begin, end - begin);
+	ops.flush();
+}
+
+} // namespace flexfs
@@ -0,0 +1,66 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/i_file.h"
+#include <functional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace flexfs {
+
+/// @brief Block signatures of a file, as in the rsync algorithm.
+/// Each block has a weak rolling checksum, to find candidate matches at any offset of another file, and a
+/// strong XXH3 checksum to confirm them.
+struct FLEXFS_EXPORT delta_signature
+{
+	struct block
+	{
+		std::uint32_t weak;
+		std::uint64_t strong;
+	};
+
+	std::size_t        block_size;
+	std::uint64_t      file_size;
+	std::vector<block> blocks; // the last one is shorter if file_size is not a multiple of block_size
+
+	/// Reads file from its current position to the end.
+	static delta_signature compute(i_file& file, std::size_t block_size);
+
+	/// Block size for a file of the given size, about its square root.
+	static std::size_t block_size_for(std::uint64_t file_size);
+};
+
+/// @brief A range of a new file, described relative to an old one.
+struct FLEXFS_EXPORT delta_op
+{
+	enum class kind
+	{
+		COPY,   // the range equals length bytes at offset in the old file
+		LITERAL // the range is not in the old file
+	};
+
+	kind          what;
+	std::uint64_t offset; // in the old file, for COPY
+	std::uint64_t target; // in the new file
+	std::uint64_t length;
+	const char*   data; // the contents of the range, only valid during the callback
+};
+
+/// Reads the new file from its current position to the end, and describes it as consecutive ranges that
+/// are either found in the old file with the given signature, or literal data. Adjacent copies are merged
+/// as long as their data is contiguous in the scan buffer.
+/// on_data receives all data read from the new file, in order.
+FLEXFS_EXPORT void compute_delta(i_file&                                              new_file,
+                                 const delta_signature&                               old_signature,
+                                 const std::function<void(const delta_op&)>&          on_op,
+                                 const std::function<void(const char*, std::size_t)>& on_data = nullptr);
+
+} // namespace flexfs
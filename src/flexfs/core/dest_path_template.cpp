@@ -0,0 +1,141 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/dest_path_template.h"
+#include "flexfs/core/exceptions.h"
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+#include <ctime>
+#include <iterator>
+#include <string_view>
+
+namespace flexfs {
+
+namespace {
+
+// Conversions for which strftime gives the same result as fmt, regardless of the locale
+constexpr auto strftime_conversions = std::string_view{ "YmdHMSFTjy%" };
+
+bool is_plain_strftime(std::string_view spec)
+{
+	if (spec.empty() || spec.front() != '%')
+	{
+		return false; // fill, align or width
+	}
+	for (auto i = std::size_t{}; i < spec.size(); ++i)
+	{
+		if (spec[i] == '%' && (++i == spec.size() || strftime_conversions.find(spec[i]) == std::string_view::npos))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+dest_path_template::dest_path_template(const std::string& pattern)
+    : pattern_{ pattern }
+    , segments_{}
+{
+	auto&& literal = [this]() -> std::string& {
+		if (this->segments_.empty() || this->segments_.back().what != segment::kind::LITERAL)
+		{
+			this->segments_.push_back(segment{ segment::kind::LITERAL, {} });
+		}
+		return this->segments_.back().text;
+	};
+
+	auto&& invalid = [&pattern](const char* what) {
+		FLEXFS_THROW(invalid_argument_exception{}
+		             << error_mesg{ fmt::format("invalid destination path template '{}': {}", pattern, what) });
+	};
+
+	const auto text = std::string_view{ pattern };
+	for (auto pos = std::size_t{}; pos < text.size();)
+	{
+		const auto c = text[pos];
+		if ((c == '{' || c == '}') && pos + 1u < text.size() && text[pos + 1u] == c)
+		{
+			literal() += c;
+			pos += 2u;
+		}
+		else if (c == '{')
+		{
+			const auto end = text.find('}', pos);
+			if (end == std::string_view::npos)
+			{
+				invalid("unterminated placeholder");
+			}
+			const auto field = text.substr(pos, end + 1u - pos);
+			const auto colon = field.find(':');
+			if (field.substr(1u, (colon == std::string_view::npos ? field.size() - 1u : colon) - 1u).find_first_not_of('0') !=
+			    std::string_view::npos)
+			{
+				invalid("placeholders cannot have an argument id other than 0");
+			}
+			const auto spec = colon == std::string_view::npos ? std::string_view{} : field.substr(colon + 1u, field.size() - colon - 2u);
+			if (is_plain_strftime(spec))
+			{
+				this->segments_.push_back(segment{ segment::kind::STRFTIME, std::string{ spec } });
+			}
+			else
+			{
+				this->segments_.push_back(segment{ segment::kind::FMT, std::string{ field } });
+			}
+			pos = end + 1u;
+		}
+		else if (c == '}')
+		{
+			invalid("unmatched '}'");
+		}
+		else
+		{
+			const auto end = text.find_first_of("{}", pos);
+			literal() += text.substr(pos, end - pos);
+			pos = end == std::string_view::npos ? text.size() : end;
+		}
+	}
+}
+
+const std::string& dest_path_template::pattern() const
+{
+	return this->pattern_;
+}
+
+void dest_path_template::render(std::chrono::system_clock::time_point time, bool local, std::string& out) const
+{
+	out.clear();
+	const auto tm = local ? fmt::localtime(time) : fmt::gmtime(time);
+	for (const auto& seg : this->segments_)
+	{
+		switch (seg.what)
+		{
+		case segment::kind::LITERAL:
+			out += seg.text;
+			break;
+		case segment::kind::STRFTIME:
+		{
+			char       buf[256];
+			const auto n = std::strftime(buf, sizeof(buf), seg.text.c_str(), &tm);
+			if (n)
+			{
+				out.append(buf, n);
+				break;
+			}
+			// Too long for buf
+			fmt::format_to(std::back_inserter(out), fmt::runtime("{:" + seg.text + "}"), tm);
+			break;
+		}
+		case segment::kind::FMT:
+			fmt::format_to(std::back_inserter(out), fmt::runtime(seg.text), tm);
+			break;
+		}
+	}
+}
+
+} // namespace flexfs
@@ -0,0 +1,51 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace flexfs {
+
+/// @brief A destination path with time placeholders, such as "backup/{:%Y-%m-%d}/", parsed once.
+/// The placeholders use the fmt chrono syntax, see https://fmt.dev/latest/syntax.html#chrono-specs.
+/// Plain strftime specifiers are rendered without going through fmt again, anything else is passed to fmt
+/// one placeholder at a time.
+class FLEXFS_EXPORT dest_path_template final
+{
+public:
+	/// Throws invalid_argument_exception on unbalanced braces or a placeholder with an argument id.
+	explicit dest_path_template(const std::string& pattern);
+
+	const std::string& pattern() const;
+
+	/// Renders the path for the given time, as local time or UTC, into out. out is cleared first, so that the
+	/// same string can be passed for every file and keeps its capacity.
+	void render(std::chrono::system_clock::time_point time, bool local, std::string& out) const;
+
+private:
+	struct segment
+	{
+		enum class kind
+		{
+			LITERAL,  // text is copied
+			STRFTIME, // text is a strftime format
+			FMT       // text is a replacement field for fmt
+		};
+
+		kind        what;
+		std::string text;
+	};
+
+	std::string          pattern_;
+	std::vector<segment> segments_;
+};
+
+} // namespace flexfs
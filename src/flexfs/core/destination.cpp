@@ -17,6 +17,7 @@ destination::destination(const fspath&                        path,
     , expand_time_placeholders{ expand_time_placeholders }
     , create_parents{ create_parents }
     , on_name_conflict{ on_name_conflict }
+    , path_template{ expand_time_placeholders ? std::make_shared<dest_path_template>(path.string()) : nullptr }
 {
 }
 
@@ -9,6 +9,8 @@
 
 #include "flexfs/core/api.h"
 #include "flexfs/core/fspath.h"
+#include "flexfs/core/dest_path_template.h"
+#include <memory>
 #include <optional>
 
 namespace flexfs {
@@ -40,6 +42,11 @@ public:
 	                                                        // --
 	conflict_policy on_name_conflict;                       // How to handle an existing destination file.
 
+	// `path` parsed once by the constructor when time placeholders are expanded, so that it is not parsed again
+	// for every file. make_dest_path does not use it if `path` was changed since.
+	std::shared_ptr<const dest_path_template> path_template;
+
+	// Throws invalid_argument_exception if time placeholders are expanded and `path` is not a valid template.
 	destination(const fspath&                        path,
 	            const std::optional<time_expansion>& expand_time_placeholders,
 	            bool                                 create_parents,
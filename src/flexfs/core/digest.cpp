@@ -0,0 +1,48 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/digest.h"
+#include "flexfs/core/crc32c.h"
+#include "flexfs/core/xxh3.h"
+#include "flexfs/core/sha256.h"
+#include "flexfs/core/exceptions.h"
+
+namespace flexfs {
+
+std::string digest::to_string() const
+{
+	static constexpr char digits[] = "0123456789abcdef";
+
+	auto result = std::string{};
+	result.reserve(this->value.size() * 2u);
+	for (const auto byte : this->value)
+	{
+		result.push_back(digits[byte >> 4]);
+		result.push_back(digits[byte & 0xfu]);
+	}
+	return result;
+}
+
+i_digester::~i_digester() noexcept
+{
+}
+
+std::unique_ptr<i_digester> make_digester(digest_algorithm algorithm)
+{
+	switch (algorithm)
+	{
+	case digest_algorithm::CRC32C:
+		return std::make_unique<crc32c_digester>();
+	case digest_algorithm::XXH3_64:
+		return std::make_unique<xxh3_digester>();
+	case digest_algorithm::SHA256:
+		return std::make_unique<sha256_digester>();
+	}
+	FLEXFS_THROW(invalid_argument_exception{} << error_mesg{ "invalid digest algorithm" });
+}
+
+} // namespace flexfs
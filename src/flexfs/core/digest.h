@@ -0,0 +1,51 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace flexfs {
+
+enum class digest_algorithm
+{
+	CRC32C,  // CRC-32/ISCSI (Castagnoli)
+	XXH3_64, // 64 bit XXH3, seed 0
+	SHA256
+};
+
+struct FLEXFS_EXPORT digest
+{
+	digest_algorithm          algorithm;
+	std::vector<std::uint8_t> value; // big endian for the integer digests, as commonly printed
+
+	std::string to_string() const; // lower case hex
+
+	bool operator==(const digest&) const = default;
+};
+
+/// @brief Incremental digest computation.
+/// The implementations use the CPU extensions available at run time (SSE4.2, AVX2, SHA-NI on x86-64).
+class FLEXFS_EXPORT i_digester
+{
+public:
+	virtual ~i_digester() noexcept;
+
+	virtual void update(const void* data, std::size_t size) = 0;
+
+	/// Returns the digest of the data passed so far, more data may be added afterwards.
+	virtual digest value() const = 0;
+};
+
+FLEXFS_EXPORT std::unique_ptr<i_digester> make_digester(digest_algorithm algorithm);
+
+} // namespace flexfs
@@ -0,0 +1,84 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/file_digests.h"
+#include "flexfs/core/i_file.h"
+#include "flexfs/core/exceptions.h"
+#include <fmt/format.h>
+#include <memory>
+#include <optional>
+#include <system_error>
+
+namespace flexfs {
+
+std::vector<digest> file_digests(i_access&                            access,
+                                 const fspath&                        path,
+                                 int                                  flags,
+                                 const std::vector<digest_algorithm>& algorithms,
+                                 buffer_pool&                         pool)
+{
+	auto result    = access.checksums(path, algorithms);
+	auto digesters = std::vector<std::unique_ptr<i_digester>>{};
+	for (auto i = std::size_t{}; i < algorithms.size(); ++i)
+	{
+		if (!result[i])
+		{
+			digesters.push_back(make_digester(algorithms[i]));
+		}
+	}
+
+	if (!digesters.empty())
+	{
+		auto       file = access.open(path, flags, 0);
+		const auto buf  = pool.acquire();
+		for (auto nread = file->read(buf.data(), buf.size()); nread; nread = file->read(buf.data(), buf.size()))
+		{
+			for (const auto& digester : digesters)
+			{
+				digester->update(buf.data(), nread);
+			}
+		}
+
+		auto it = digesters.begin();
+		for (auto& d : result)
+		{
+			if (!d)
+			{
+				d = (*it++)->value();
+			}
+		}
+	}
+
+	auto digests = std::vector<digest>{};
+	for (auto& d : result)
+	{
+		digests.push_back(std::move(d.value()));
+	}
+	return digests;
+}
+
+void verify_digests(i_access& access, const fspath& path, int flags, const std::vector<digest>& expected, buffer_pool& pool)
+{
+	auto algorithms = std::vector<digest_algorithm>{};
+	for (const auto& d : expected)
+	{
+		algorithms.push_back(d.algorithm);
+	}
+
+	const auto actual = file_digests(access, path, flags, algorithms, pool);
+	for (auto i = std::size_t{}; i < expected.size(); ++i)
+	{
+		if (actual[i] != expected[i])
+		{
+			FLEXFS_THROW(exception(std::make_error_code(std::errc::io_error),
+			                       fmt::format("digest mismatch, expected {}, got {}", expected[i].to_string(), actual[i].to_string()))
+			             << error_opname{ "verify" } << error_path{ path });
+		}
+	}
+}
+
+} // namespace flexfs
@@ -0,0 +1,30 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/i_access.h"
+#include "flexfs/core/fspath.h"
+#include "flexfs/core/digest.h"
+#include "flexfs/core/buffer_pool.h"
+#include <vector>
+
+namespace flexfs {
+
+// Digests of the file at path, in the order of algorithms. The access computes what it can without
+// transferring the file (i_access::checksums), the file is opened with flags and read for the rest.
+FLEXFS_LOCAL std::vector<digest> file_digests(i_access&                            access,
+                                              const fspath&                        path,
+                                              int                                  flags,
+                                              const std::vector<digest_algorithm>& algorithms,
+                                              buffer_pool&                         pool);
+
+// Compares the digests of the file at path to expected. Throws on a mismatch.
+FLEXFS_LOCAL void verify_digests(i_access& access, const fspath& path, int flags, const std::vector<digest>& expected, buffer_pool& pool);
+
+} // namespace flexfs
@@ -0,0 +1,300 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/gzip_writer.h"
+#include "flexfs/core/exceptions.h"
+#include "flexfs/core/logging.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <zlib.h>
+
+namespace flexfs {
+
+namespace {
+
+constexpr auto chunk_size      = std::size_t{ 262144u }; // handed over to the compression thread at once
+constexpr auto queue_depth     = std::size_t{ 4u };      // chunks the compression thread can fall behind
+constexpr auto out_buffer_size = std::size_t{ 262144u };
+
+constexpr auto gzip_window_bits = 15 + 16; // 32K window, gzip header and trailer
+constexpr auto memory_level     = 8;       // the zlib default
+
+void write_all(i_file& out, const char* ptr, std::size_t count)
+{
+	while (count)
+	{
+		const auto written = out.write(ptr, count);
+		ptr += written;
+		count -= written;
+	}
+}
+
+} // namespace
+
+class gzip_writer::deflater final
+{
+	z_stream          stream_;
+	std::vector<char> buf_;
+	std::uint64_t     size_; // of the compressed data written
+
+public:
+	explicit deflater(int level)
+	    : stream_{}
+	    , buf_(out_buffer_size)
+	    , size_{}
+	{
+		const auto rc = deflateInit2(&this->stream_, level, Z_DEFLATED, gzip_window_bits, memory_level, Z_DEFAULT_STRATEGY);
+		if (rc != Z_OK)
+		{
+			FLEXFS_THROW(exception{ zError(rc) } << error_opname{ "deflateInit2" });
+		}
+	}
+
+	~deflater() noexcept
+	{
+		deflateEnd(&this->stream_);
+	}
+
+	deflater(const deflater&)            = delete;
+	deflater& operator=(const deflater&) = delete;
+
+	std::uint64_t size() const
+	{
+		return this->size_;
+	}
+
+	// Compresses count bytes at data into out. With finish, the data still buffered by zlib and the trailer
+	// are written as well.
+	void compress(const char* data, std::size_t count, bool finish, i_file& out)
+	{
+		static_assert(chunk_size <= std::numeric_limits<uInt>::max() && out_buffer_size <= std::numeric_limits<uInt>::max());
+
+		this->stream_.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+		this->stream_.avail_in = static_cast<uInt>(count);
+		for (;;)
+		{
+			this->stream_.next_out  = reinterpret_cast<Bytef*>(this->buf_.data());
+			this->stream_.avail_out = static_cast<uInt>(this->buf_.size());
+
+			const auto rc = deflate(&this->stream_, finish ? Z_FINISH : Z_NO_FLUSH);
+			if (rc == Z_STREAM_ERROR)
+			{
+				FLEXFS_THROW(exception{ zError(rc) } << error_opname{ "deflate" });
+			}
+
+			const auto have = this->buf_.size() - this->stream_.avail_out;
+			write_all(out, this->buf_.data(), have);
+			this->size_ += have;
+
+			if (finish ? rc == Z_STREAM_END : this->stream_.avail_out != 0u)
+			{
+				break;
+			}
+		}
+	}
+};
+
+gzip_writer::gzip_writer(std::unique_ptr<i_file> out, int level, bool threaded)
+    : out_{ std::move(out) }
+    , deflater_{ std::make_unique<deflater>(level) }
+    , pending_{}
+    , in_size_{}
+    , finished_{}
+    , threaded_{ threaded }
+    , mutex_{}
+    , cv_{}
+    , queue_{}
+    , free_{}
+    , closing_{}
+    , error_{}
+    , thread_{}
+{
+	this->pending_.reserve(chunk_size);
+	if (threaded)
+	{
+		this->thread_ = std::thread{ [this] { this->run(); } };
+	}
+}
+
+gzip_writer::~gzip_writer() noexcept
+{
+	if (this->thread_.joinable())
+	{
+		{
+			// Abandoned, the data still queued is not needed
+			auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+			this->queue_.clear();
+			this->closing_ = true;
+		}
+		this->cv_.notify_all();
+		this->thread_.join();
+	}
+}
+
+void gzip_writer::run()
+{
+	for (;;)
+	{
+		auto chunk = std::vector<char>{};
+		{
+			auto lock = std::unique_lock<std::mutex>{ this->mutex_ };
+			this->cv_.wait(lock, [this] { return this->closing_ || !this->queue_.empty(); });
+			if (this->queue_.empty())
+			{
+				break;
+			}
+			chunk = std::move(this->queue_.front());
+			this->queue_.pop_front();
+		}
+
+		try
+		{
+			this->deflater_->compress(chunk.data(), chunk.size(), false, *this->out_);
+		}
+		catch (...)
+		{
+			auto lock    = std::lock_guard<std::mutex>{ this->mutex_ };
+			this->error_ = std::current_exception();
+			this->queue_.clear();
+		}
+
+		{
+			auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+			chunk.clear();
+			this->free_.push_back(std::move(chunk));
+		}
+		this->cv_.notify_all();
+	}
+}
+
+void gzip_writer::hand_over()
+{
+	if (!this->threaded_)
+	{
+		this->deflater_->compress(this->pending_.data(), this->pending_.size(), false, *this->out_);
+		this->pending_.clear();
+		return;
+	}
+
+	auto lock = std::unique_lock<std::mutex>{ this->mutex_ };
+	this->cv_.wait(lock, [this] { return this->error_ || this->queue_.size() < queue_depth; });
+	if (this->error_)
+	{
+		std::rethrow_exception(this->error_);
+	}
+	this->queue_.push_back(std::move(this->pending_));
+	if (this->free_.empty())
+	{
+		this->pending_ = std::vector<char>{};
+		this->pending_.reserve(chunk_size);
+	}
+	else
+	{
+		this->pending_ = std::move(this->free_.back());
+		this->free_.pop_back();
+	}
+	lock.unlock();
+	this->cv_.notify_all();
+}
+
+std::uint64_t gzip_writer::finish()
+{
+	if (!this->finished_)
+	{
+		if (!this->pending_.empty())
+		{
+			this->hand_over();
+		}
+		if (this->thread_.joinable())
+		{
+			{
+				auto lock      = std::lock_guard<std::mutex>{ this->mutex_ };
+				this->closing_ = true;
+			}
+			this->cv_.notify_all();
+			this->thread_.join();
+			if (this->error_)
+			{
+				std::rethrow_exception(this->error_);
+			}
+		}
+		this->deflater_->compress(nullptr, 0u, true, *this->out_);
+		this->finished_ = true;
+		fslog(debug, "compressed {} bytes to {}", this->in_size_, this->deflater_->size());
+	}
+	return this->deflater_->size();
+}
+
+std::size_t gzip_writer::read(void* /*buf*/, std::size_t /*count*/)
+{
+	FLEXFS_THROW(system_exception{ std::error_code(EBADF, std::system_category()) } << error_opname{ "read" });
+}
+
+std::size_t gzip_writer::write(const void* buf, std::size_t count)
+{
+	if (this->finished_)
+	{
+		FLEXFS_THROW(system_exception{ std::error_code(EBADF, std::system_category()) } << error_opname{ "write" });
+	}
+	auto ptr = static_cast<const char*>(buf);
+	for (auto remaining = count; remaining;)
+	{
+		const auto n = std::min(remaining, chunk_size - this->pending_.size());
+		this->pending_.insert(this->pending_.end(), ptr, ptr + n);
+		ptr += n;
+		remaining -= n;
+		if (this->pending_.size() == chunk_size)
+		{
+			this->hand_over();
+		}
+	}
+	this->in_size_ += count;
+	return count;
+}
+
+std::uint64_t gzip_writer::seek(std::uint64_t offset)
+{
+	if (offset != this->in_size_)
+	{
+		FLEXFS_THROW(system_exception{ std::error_code(ESPIPE, std::system_category()) } << error_opname{ "seek" });
+	}
+	return offset;
+}
+
+void gzip_writer::truncate(std::uint64_t /*size*/)
+{
+	FLEXFS_THROW(system_exception{ std::error_code(ESPIPE, std::system_category()) } << error_opname{ "truncate" });
+}
+
+std::optional<std::uint64_t> gzip_writer::seek_data(std::uint64_t offset)
+{
+	return offset;
+}
+
+std::uint64_t gzip_writer::seek_hole(std::uint64_t /*offset*/)
+{
+	return std::numeric_limits<std::uint64_t>::max();
+}
+
+bool gzip_writer::allocate(std::uint64_t /*size*/)
+{
+	return false;
+}
+
+bool gzip_writer::copy_from(i_file& /*source*/, std::uint64_t /*offset*/, std::uint64_t /*count*/, std::uint64_t /*dest_offset*/)
+{
+	return false;
+}
+
+bool gzip_writer::sync(bool wait)
+{
+	this->finish();
+	return this->out_->sync(wait);
+}
+
+} // namespace flexfs
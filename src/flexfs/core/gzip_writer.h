@@ -0,0 +1,73 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/i_file.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace flexfs {
+
+/// @brief Write-only file that gzip compresses the data written to it into another file.
+/// With @a threaded, the data is handed over in chunks to a separate thread that compresses it and writes
+/// it to the other file, so that the writer only waits when that thread falls behind. The other file must
+/// then not be used by the calling thread until finish() returns, e.g. when it shares a remote session.
+/// Only sequential writes are possible. finish() must be called to complete the file, a file that is
+/// destroyed before is left without the gzip trailer.
+class FLEXFS_LOCAL gzip_writer final : public i_file
+{
+	class deflater;
+
+	std::unique_ptr<i_file>        out_;
+	std::unique_ptr<deflater>      deflater_;
+	std::vector<char>              pending_; // filled by write, handed over when full
+	std::uint64_t                  in_size_;
+	bool                           finished_;
+	bool                           threaded_;
+	std::mutex                     mutex_;
+	std::condition_variable        cv_;
+	std::deque<std::vector<char>>  queue_; // handed over, to be compressed
+	std::vector<std::vector<char>> free_;  // compressed, to be filled again
+	bool                           closing_;
+	std::exception_ptr             error_; // of the compression thread
+	std::thread                    thread_;
+
+	void hand_over();
+	void run();
+
+public:
+	explicit gzip_writer(std::unique_ptr<i_file> out, int level, bool threaded);
+	~gzip_writer() noexcept override;
+
+	gzip_writer(const gzip_writer&)            = delete;
+	gzip_writer& operator=(const gzip_writer&) = delete;
+
+	/// Compresses the rest of the data and writes the gzip trailer. Returns the size of the compressed file.
+	std::uint64_t finish();
+
+	std::size_t read(void* buf, std::size_t count) override; // always throws, the file is write-only
+	std::size_t write(const void* buf, std::size_t count) override;
+
+	std::uint64_t                seek(std::uint64_t offset) override;   // throws unless offset is the current offset
+	void                         truncate(std::uint64_t size) override; // always throws
+	std::optional<std::uint64_t> seek_data(std::uint64_t offset) override;
+	std::uint64_t                seek_hole(std::uint64_t offset) override;
+	bool                         allocate(std::uint64_t size) override; // the compressed size is not known, returns false
+	bool copy_from(i_file& source, std::uint64_t offset, std::uint64_t count, std::uint64_t dest_offset) override; // returns false
+	bool sync(bool wait) override; // finishes the file first
+};
+
+} // namespace flexfs
@@ -13,4 +13,14 @@ i_access::~i_access() noexcept
 {
 }
 
+std::vector<std::optional<digest>> i_access::checksums(const fspath& path, const std::vector<digest_algorithm>& algorithms)
+{
+	auto result = std::vector<std::optional<digest>>{};
+	for (const auto algorithm : algorithms)
+	{
+		result.push_back(this->checksum(path, algorithm));
+	}
+	return result;
+}
+
 } // namespace flexfs
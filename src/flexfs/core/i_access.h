@@ -9,11 +9,14 @@
 
 #include "flexfs/core/api.h"
 #include "flexfs/core/fspath.h"
+#include "flexfs/core/digest.h"
 #include <boost/system/api_config.hpp>
+#include <chrono>
 #include <vector>
 #include <memory>
 #include <string>
 #include <optional>
+#include <cstdint>
 #include <fcntl.h>
 #ifdef BOOST_WINDOWS_API
 #include <io.h>
@@ -33,6 +36,9 @@
 #ifdef BOOST_POSIX_API
 #define O_BINARY 0 // does not exist in POSIX
 #endif
+#ifndef O_DIRECT
+#define O_DIRECT 0 // not supported on this platform
+#endif
 
 namespace flexfs {
 
@@ -44,6 +50,12 @@ class i_watcher;
 class FLEXFS_EXPORT i_access
 {
 public:
+	enum class position_kind
+	{
+		INODE, // the inode number, which file systems tend to allocate near the data
+		EXTENT // the physical offset of the first data extent (FIEMAP)
+	};
+
 	virtual ~i_access() noexcept;
 
 	virtual bool                      is_remote() const            = 0;
@@ -58,12 +70,45 @@ public:
 	virtual void                    rename(const fspath& oldpath, const fspath& newpath) = 0;
 	virtual std::unique_ptr<i_file> open(const fspath& path, int flags, mode_t mode)     = 0;
 
+	/// @brief Atomic variants of open and rename that never replace an existing file.
+	/// try_create opens a new file, adding O_CREAT | O_EXCL to @a flags. Returns nullptr if @a path exists.
+	/// try_rename returns false if @a newpath exists.
+	/// try_link makes @a newpath a hard link to @a oldpath, and returns false if @a newpath exists. Throws if the
+	/// link cannot be made, e.g. across file systems or when the server does not support hard links.
+	virtual std::unique_ptr<i_file> try_create(const fspath& path, int flags, mode_t mode)   = 0;
+	virtual bool                    try_rename(const fspath& oldpath, const fspath& newpath) = 0;
+	virtual bool                    try_link(const fspath& oldpath, const fspath& newpath)   = 0;
+
 	/// @brief Create a directory watcher.
 	/// The caller must provide a file descriptor @a cancelfd that the implementation can
 	/// monitor (through select, poll, ...) for read events, e.g. the read end of a pipe.
 	/// The caller can then cancel the watcher by making the file descriptor readable, e.g.
 	/// by writing to the write end of the pipe.
 	virtual std::shared_ptr<i_watcher> create_watcher(const fspath& dir, int cancelfd) = 0;
+
+	/// @brief Computes the digest of the file at @a path on the side where it is stored, so that for a remote
+	/// file only the digest is transferred.
+	/// Returns std::nullopt if the algorithm is not available there. The caller must then read the file.
+	virtual std::optional<digest> checksum(const fspath& path, digest_algorithm algorithm) = 0;
+
+	/// @brief Like checksum, for several algorithms, in the order of @a algorithms. An access that reads the
+	/// file to compute the digests reads it once for all of them. The default calls checksum for each one.
+	virtual std::vector<std::optional<digest>> checksums(const fspath& path, const std::vector<digest_algorithm>& algorithms);
+
+	/// @brief Sets the permission bits of the file at @a path to @a perms and its modification time to @a mtime,
+	/// the ones that are given. The access time is set to the current time along with the modification time.
+	virtual void set_metadata(const fspath&                                        path,
+	                          std::optional<mode_t>                                perms,
+	                          std::optional<std::chrono::system_clock::time_point> mtime) = 0;
+
+	/// @brief Flushes the data of all files on the file system that holds @a path to stable storage, like syncfs.
+	/// Returns false if this is not supported.
+	virtual bool sync_fs(const fspath& path) = 0;
+
+	/// @brief Returns where the file at @a path is stored on its device, as a number to sort by. Reading many
+	/// files in that order saves the seeks between them on rotational disks.
+	/// Returns std::nullopt if it is not known, e.g. for remote files, or for a file without data extents.
+	virtual std::optional<std::uint64_t> disk_position(const fspath& path, position_kind kind) = 0;
 };
 
 } // namespace flexfs
@@ -8,7 +8,9 @@
 #pragma once
 
 #include "flexfs/core/api.h"
+#include <optional>
 #include <cstddef>
+#include <cstdint>
 
 namespace flexfs {
 
@@ -17,8 +19,36 @@ class FLEXFS_EXPORT i_file
 public:
 	virtual ~i_file() noexcept;
 
-	virtual std::size_t read(void* buf, std::size_t count)        = 0;
-	virtual std::size_t write(const void* buf, std::size_t count) = 0;
+	virtual std::size_t   read(void* buf, std::size_t count)        = 0;
+	virtual std::size_t   write(const void* buf, std::size_t count) = 0;
+	virtual std::uint64_t seek(std::uint64_t offset)                = 0; // absolute, returns the new offset
+	virtual void          truncate(std::uint64_t size)              = 0;
+
+	/// @brief Sparse file support.
+	/// seek_data returns the offset of the first data at or after @a offset, or std::nullopt if there is
+	/// no more data. seek_hole returns the offset of the first hole at or after @a offset, where the end of
+	/// the file counts as a hole.
+	/// Implementations that cannot detect holes treat the whole file as data: seek_data returns @a offset
+	/// and seek_hole returns the maximum value of std::uint64_t.
+	/// The file offset is unspecified after these calls, use seek() before reading.
+	virtual std::optional<std::uint64_t> seek_data(std::uint64_t offset) = 0;
+	virtual std::uint64_t                seek_hole(std::uint64_t offset) = 0;
+
+	/// @brief Reserves disk space for the first @a size bytes of the file, without changing the size of the
+	/// file. Throws when the space is not available.
+	/// Returns false, without changing the file, if preallocation is not supported.
+	virtual bool allocate(std::uint64_t size) = 0;
+
+	/// @brief Copies @a count bytes at @a offset of @a source to @a dest_offset of this file, without passing
+	/// the data through this process, e.g. with a server side copy. Fewer bytes are copied if the source file
+	/// ends first. The file offsets of both files are not changed.
+	/// Returns false, without changing the file, if this is not supported for the pair of files.
+	virtual bool copy_from(i_file& source, std::uint64_t offset, std::uint64_t count, std::uint64_t dest_offset) = 0;
+
+	/// @brief Flushes the data written to the file to stable storage, like fdatasync. With @a wait false, only
+	/// starts writing it back, so that a later sync of the file system (i_access::sync_fs) has less to do.
+	/// Returns false if this is not supported.
+	virtual bool sync(bool wait) = 0;
 };
 
 } // namespace flexfs
@@ -3,9 +3,15 @@
 #include "flexfs/core/formatters.h"
 #include "flexfs/core/exceptions.h"
 #include "flexfs/core/attributes.h"
+#include "flexfs/core/direntry.h"
 #include <fmt/format.h>
-#include <fmt/chrono.h>
+#include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
 
 namespace flexfs {
 
@@ -17,9 +23,99 @@ bool path_ends_with_path_separator(const fspath& path)
 	return separators.find(path.string().back()) != separators.npos;
 }
 
+fspath autorename_path(const fspath& path, std::uint64_t i)
+{
+	return path.parent_path() / fmt::format("{}~{}{}", path.filename().stem().string(), i, path.filename().extension().string());
+}
+
+// Returns N if name is <stem>~N<extension> of path, 0 otherwise
+std::uint64_t autorename_index(std::string_view name, const fspath& path)
+{
+	const auto stem      = path.filename().stem().string() + "~";
+	const auto extension = path.filename().extension().string();
+	if (name.size() <= stem.size() + extension.size() || !name.starts_with(stem) || !name.ends_with(extension))
+	{
+		return 0u;
+	}
+	const auto digits    = name.substr(stem.size(), name.size() - stem.size() - extension.size());
+	auto       result    = std::uint64_t{};
+	const auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), result);
+	return ec == std::errc{} && end == digits.data() + digits.size() && digits.front() != '0' ? result : 0u;
+}
+
+// The N after the highest one taken in the directory of path, from a single listing
+std::uint64_t next_autorename_index_listed(i_access& access, const fspath& path)
+{
+	auto result = std::uint64_t{ 1u };
+	for (const auto& entry : access.ls(path.parent_path()))
+	{
+		result = std::max(result, autorename_index(entry.name, path) + 1u);
+	}
+	return result;
+}
+
+// A free N, found with a number of exists() calls logarithmic in the number of names taken, assuming they
+// are mostly consecutive. First doubles N until it is free, then narrows down between the last two.
+std::uint64_t next_autorename_index_probed(i_access& access, const fspath& path)
+{
+	auto taken = std::uint64_t{};
+	auto free  = std::uint64_t{ 1u };
+	while (access.exists(autorename_path(path, free)))
+	{
+		taken = free;
+		free *= 2u;
+	}
+	while (free - taken > 1u)
+	{
+		const auto mid = taken + (free - taken) / 2u;
+		(access.exists(autorename_path(path, mid)) ? taken : free) = mid;
+	}
+	return free;
+}
+
+fspath resolve_name_conflict(i_access&                                 access,
+                             const fspath&                             path,
+                             bool                                      exists,
+                             destination::conflict_policy              policy,
+                             const std::function<bool(const fspath&)>& create)
+{
+	switch (policy)
+	{
+	case destination::conflict_policy::OVERWRITE:
+		break;
+	case destination::conflict_policy::AUTORENAME:
+		if (exists || (create && !create(path)))
+		{
+			// Listing a large remote directory takes more round trips than probing it
+			auto i = access.is_remote() ? next_autorename_index_probed(access, path) : next_autorename_index_listed(access, path);
+			if (create)
+			{
+				// Only taken if another process got there first
+				while (!create(autorename_path(path, i)))
+				{
+					++i;
+				}
+			}
+			return autorename_path(path, i);
+		}
+		break;
+	case destination::conflict_policy::FAIL:
+		if (exists || (create && !create(path)))
+		{
+			FLEXFS_THROW(system_exception{ std::error_code(EEXIST, std::system_category()) } << error_path{ path });
+		}
+		break;
+	}
+	return path;
+}
+
 } // namespace
 
-fspath make_dest_path(i_access& source_access, const source& source, i_access& dest_access, const destination& dest)
+fspath make_dest_path(i_access&                                 source_access,
+                      const source&                             source,
+                      i_access&                                 dest_access,
+                      const destination&                        dest,
+                      const std::function<bool(const fspath&)>& create)
 {
 	auto new_path = dest.path;
 	if (new_path.empty())
@@ -29,12 +125,16 @@ fspath make_dest_path(i_access& source_access, const source& source, i_access& d
 
 	if (dest.expand_time_placeholders)
 	{
-		const auto mtime = source_access.stat(source.current_path).mtime;
+		const auto mtime = source.mtime ? source.mtime : source_access.stat(source.current_path).mtime;
 		if (mtime)
 		{
-			const auto tm = dest.expand_time_placeholders.value() == destination::time_expansion::LOCAL ? fmt::localtime(mtime.value())
-			                                                                                            : fmt::gmtime(mtime.value());
-			new_path      = fmt::format(fmt::runtime(new_path.string()), tm);
+			const auto compiled = dest.path_template && dest.path_template->pattern() == dest.path.string()
+			                          ? dest.path_template
+			                          : std::make_shared<dest_path_template>(dest.path.string());
+
+			thread_local auto buf = std::string{};
+			compiled->render(mtime.value(), dest.expand_time_placeholders.value() == destination::time_expansion::LOCAL, buf);
+			new_path = buf;
 		}
 		else
 		{
@@ -45,30 +145,10 @@ fspath make_dest_path(i_access& source_access, const source& source, i_access& d
 		}
 	}
 
-	auto attr = dest_access.try_stat(new_path);
+	auto exists = false; // new_path is known to exist and is not a directory
+	auto attr   = dest_access.try_stat(new_path);
 	if (attr)
 	{
-		auto&& resolve_name_conflict = [&]() {
-			switch (dest.on_name_conflict)
-			{
-			case destination::conflict_policy::OVERWRITE:
-				break;
-			case destination::conflict_policy::AUTORENAME:
-			{
-				auto       i    = 0;
-				const auto orig = new_path;
-				do
-				{
-					new_path = orig.parent_path() /
-					           fmt::format("{}~{}{}", orig.filename().stem().string(), ++i, orig.filename().extension().string());
-				} while (dest_access.exists(new_path));
-				break;
-			}
-			case destination::conflict_policy::FAIL:
-				FLEXFS_THROW(system_exception{ std::error_code(EEXIST, std::system_category()) } << error_path{ new_path });
-			}
-		};
-
 		// new_path exists.
 		if (attr->is_dir())
 		{
@@ -84,7 +164,7 @@ fspath make_dest_path(i_access& source_access, const source& source, i_access& d
 				else
 				{
 					// new_path exists and is not a dir
-					resolve_name_conflict();
+					exists = true;
 				}
 			}
 		}
@@ -96,7 +176,7 @@ fspath make_dest_path(i_access& source_access, const source& source, i_access& d
 		else
 		{
 			// new_path exists, it is not a directory and does not end with a path separator.
-			resolve_name_conflict();
+			exists = true;
 		}
 	}
 	else
@@ -107,7 +187,7 @@ fspath make_dest_path(i_access& source_access, const source& source, i_access& d
 			new_path /= source.orig_path.filename();
 		}
 
-		if (new_path.has_parent_path())
+		if (new_path.has_parent_path() && !dest_access.exists(new_path.parent_path()))
 		{
 			const auto parent = new_path.parent_path();
 			if (dest.create_parents)
@@ -120,7 +200,8 @@ fspath make_dest_path(i_access& source_access, const source& source, i_access& d
 			}
 		}
 	}
-	return new_path;
+
+	return resolve_name_conflict(dest_access, new_path, exists, dest.on_name_conflict, create);
 }
 
 } // namespace flexfs
@@ -12,9 +12,20 @@
 #include "flexfs/core/fspath.h"
 #include "flexfs/core/source.h"
 #include "flexfs/core/destination.h"
+#include <functional>
 
 namespace flexfs {
 
-FLEXFS_LOCAL fspath make_dest_path(i_access& source_access, const source& source, i_access& dest_access, const destination& dest);
+// Resolves the path that source is copied or moved to and applies the conflict policy of dest.
+// Without create, the policy is applied to what the destination looks like now, which is racy. With create,
+// the AUTORENAME and FAIL policies are applied atomically: create must make the file at the path it is passed
+// without replacing anything, and return false if that path exists. AUTORENAME then tries the next name.
+// AUTORENAME uses name~N.ext, with N above the highest one found in a single listing of the directory, or for
+// a remote destination a free N found by probing in a logarithmic number of exists() calls.
+FLEXFS_LOCAL fspath make_dest_path(i_access&                                 source_access,
+                                   const source&                             source,
+                                   i_access&                                 dest_access,
+                                   const destination&                        dest,
+                                   const std::function<bool(const fspath&)>& create = nullptr);
 
 } // namespace flexfs
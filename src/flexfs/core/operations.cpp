@@ -7,62 +7,1307 @@
 
 #include "flexfs/core/operations.h"
 #include "flexfs/core/make_dest_path.h"
+#include "flexfs/core/file_digests.h"
+#include "flexfs/core/gzip_writer.h"
+#include "flexfs/core/partial_file.h"
+#include "flexfs/core/delta.h"
 #include "flexfs/core/attributes.h"
 #include "flexfs/core/i_file.h"
-#include <array>
+#include "flexfs/core/logging.h"
+#include "flexfs/core/formatters.h"
+#include "flexfs/core/buffer_pool.h"
+#include "flexfs/core/exceptions.h"
+#include "flexfs/core/noop_interruptor.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <cassert>
 
 namespace flexfs {
 
+namespace {
+
+using digester_list = std::vector<std::unique_ptr<i_digester>>;
+
+// Buffer sizes selected when copy_options::buffer_size is 0.
+// Local files benefit from large transfers. Reads and writes on SFTP files are capped at the maximum SFTP
+// packet length by most servers anyway.
+constexpr auto local_buffer_size  = std::size_t{ 1048576u };
+constexpr auto remote_buffer_size = std::size_t{ 262144u };
+
+// Buffer count selected when copy_options::buffer_count is 0.
+constexpr auto auto_buffer_count = std::size_t{ 2u };
+
+// Automatically sized transfers start at min_chunk_size and adapt to the measured throughput, such that
+// transferring one chunk takes about target_chunk_duration.
+constexpr auto min_chunk_size        = std::size_t{ 65536u };
+constexpr auto target_chunk_duration = std::chrono::milliseconds{ 50 };
+
+// Granularity of zero run detection in sparse_mode::ALWAYS.
+constexpr auto sparse_block_size = std::size_t{ 4096u };
+
+// Size of the parts of a copy by the server or the kernel, between which progress is reported and
+// interruption is checked.
+constexpr auto offload_chunk_size = std::uint64_t{ 67108864u };
+
+int open_flags(const i_access& access, int flags, const copy_options& opts)
+{
+	if (opts.direct_io && !access.is_remote())
+	{
+		flags |= O_DIRECT;
+	}
+	return flags;
+}
+
+bool is_zero(const char* ptr, std::size_t count)
+{
+	return count == 0 || (ptr[0] == 0 && std::memcmp(ptr, ptr + 1, count - 1) == 0);
+}
+
+digester_list make_digesters(const std::vector<digest_algorithm>& algorithms)
+{
+	auto result = digester_list{};
+	for (const auto algorithm : algorithms)
+	{
+		result.push_back(make_digester(algorithm));
+	}
+	return result;
+}
+
+void update_digesters(digester_list& digesters, const void* data, std::size_t size)
+{
+	for (const auto& digester : digesters)
+	{
+		digester->update(data, size);
+	}
+}
+
+// Holes read as zeros
+void update_digesters_zeros(digester_list& digesters, std::uint64_t count)
+{
+	static constexpr char zeros[sparse_block_size]{};
+	while (count && !digesters.empty())
+	{
+		const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(count, sizeof(zeros)));
+		update_digesters(digesters, zeros, n);
+		count -= n;
+	}
+}
+
+std::vector<digest> digest_values(const digester_list& digesters)
+{
+	auto result = std::vector<digest>{};
+	for (const auto& digester : digesters)
+	{
+		result.push_back(digester->value());
+	}
+	return result;
+}
+
+std::shared_ptr<buffer_pool> make_buffer_pool(const i_access&     source_access,
+                                              const i_access&     dest_access,
+                                              const attributes&   source_attr,
+                                              const copy_options& opts,
+                                              std::size_t         buffer_count)
+{
+	if (opts.pool)
+	{
+		return opts.pool;
+	}
+	auto buffer_size = opts.buffer_size;
+	if (buffer_size == 0u)
+	{
+		buffer_size = source_access.is_remote() || dest_access.is_remote() ? remote_buffer_size : local_buffer_size;
+		if (source_attr.size)
+		{
+			// No need for a large buffer to copy a small file
+			buffer_size = static_cast<std::size_t>(std::min<std::uint64_t>(buffer_size, source_attr.size.value()));
+		}
+	}
+	return std::make_shared<buffer_pool>(buffer_size, buffer_count);
+}
+
+// Takes up to count buffers from the pool. Waits for the first one, but not for the others, so that copies
+// that share a pool cannot deadlock.
+std::vector<buffer_pool::lease> acquire_buffers(buffer_pool& pool, std::size_t count)
+{
+	auto result = std::vector<buffer_pool::lease>{};
+	result.push_back(pool.acquire());
+	while (result.size() < count)
+	{
+		auto buf = pool.try_acquire();
+		if (!buf)
+		{
+			break;
+		}
+		result.push_back(std::move(buf));
+	}
+	return result;
+}
+
+// Reads a file on a separate thread into a queue of buffers.
+class read_ahead final
+{
+public:
+	struct chunk
+	{
+		buffer_pool::lease buf;
+		std::size_t        size; // 0 at the end of the file
+	};
+
+private:
+	i_file&                         in_;
+	std::mutex                      mutex_;
+	std::condition_variable         cv_;
+	std::vector<buffer_pool::lease> empty_;
+	std::deque<chunk>               full_;
+	bool                            eof_;
+	bool                            stop_;
+	std::exception_ptr              error_;
+	std::thread                     thread_;
+
+	void run()
+	{
+		try
+		{
+			for (;;)
+			{
+				auto buf = buffer_pool::lease{};
+				{
+					auto lock = std::unique_lock<std::mutex>{ this->mutex_ };
+					this->cv_.wait(lock, [this] { return this->stop_ || !this->empty_.empty(); });
+					if (this->stop_)
+					{
+						return;
+					}
+					buf = std::move(this->empty_.back());
+					this->empty_.pop_back();
+				}
+				const auto nread = this->in_.read(buf.data(), buf.size());
+				{
+					auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+					if (nread)
+					{
+						this->full_.push_back(chunk{ std::move(buf), nread });
+					}
+					else
+					{
+						this->eof_ = true;
+					}
+				}
+				this->cv_.notify_all();
+				if (nread == 0)
+				{
+					return;
+				}
+			}
+		}
+		catch (...)
+		{
+			{
+				auto lock    = std::lock_guard<std::mutex>{ this->mutex_ };
+				this->error_ = std::current_exception();
+			}
+			this->cv_.notify_all();
+		}
+	}
+
+public:
+	explicit read_ahead(i_file& in, std::vector<buffer_pool::lease> buffers)
+	    : in_{ in }
+	    , mutex_{}
+	    , cv_{}
+	    , empty_{ std::move(buffers) }
+	    , full_{}
+	    , eof_{}
+	    , stop_{}
+	    , error_{}
+	    , thread_{ [this] { this->run(); } }
+	{
+	}
+
+	~read_ahead() noexcept
+	{
+		{
+			auto lock   = std::lock_guard<std::mutex>{ this->mutex_ };
+			this->stop_ = true;
+		}
+		this->cv_.notify_all();
+		this->thread_.join();
+	}
+
+	read_ahead(const read_ahead&)            = delete;
+	read_ahead& operator=(const read_ahead&) = delete;
+
+	// Waits for the next chunk. Rethrows a read error once all chunks read before the error are consumed.
+	chunk next()
+	{
+		auto lock = std::unique_lock<std::mutex>{ this->mutex_ };
+		this->cv_.wait(lock, [this] { return !this->full_.empty() || this->eof_ || this->error_; });
+		if (!this->full_.empty())
+		{
+			auto result = std::move(this->full_.front());
+			this->full_.pop_front();
+			return result;
+		}
+		else if (this->error_)
+		{
+			std::rethrow_exception(this->error_);
+		}
+		return chunk{ buffer_pool::lease{}, 0u };
+	}
+
+	// Hands a consumed buffer back to the reader.
+	void recycle(buffer_pool::lease buf)
+	{
+		{
+			auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+			this->empty_.push_back(std::move(buf));
+		}
+		this->cv_.notify_all();
+	}
+};
+
+// Moves the data from one file to another.
+// Keeps track of the logical offset in the files, so that holes can be skipped on both ends.
+class transfer final
+{
+	i_file&                                                in_;
+	i_file&                                                out_;
+	buffer_pool::lease                                     buf_;
+	std::size_t                                            chunk_size_; // current read size
+	bool                                                   adaptive_;   // adapt chunk_size_ to the throughput
+	bool                                                   skip_zeros_;
+	rate_limiter*                                          limiter_;
+	i_interruptor&                                         interruptor_;
+	const std::function<void(std::uint64_t bytes_copied)>& on_progress_;
+	std::uint64_t                                          offset_;     // logical offset in both files
+	std::uint64_t                                          out_offset_; // file offset of out_
+	std::uint64_t                                          out_size_;   // size of out_ as far as written
+	std::optional<std::uint64_t>                           allocated_;  // size of out_ as preallocated
+	digester_list                                          digesters_;  // of the source data
+
+	void write_all(const char* ptr, std::size_t count)
+	{
+		if (this->out_offset_ != this->offset_)
+		{
+			this->out_offset_ = this->out_.seek(this->offset_);
+		}
+		if (this->limiter_)
+		{
+			this->limiter_->acquire(count, this->interruptor_);
+		}
+		for (auto writecount = count; writecount;)
+		{
+			const auto written = this->out_.write(ptr, writecount);
+			assert(written <= writecount);
+			writecount -= written;
+			ptr += written;
+			this->offset_ += written;
+			this->out_offset_ = this->offset_;
+			this->out_size_   = std::max(this->out_size_, this->offset_);
+			this->progress();
+		}
+	}
+
+	// Writes the zero runs of at least sparse_block_size as holes.
+	void write_sparse(const char* ptr, std::size_t count)
+	{
+		auto&& block_length = [&](std::size_t pos) { return std::min(sparse_block_size, count - pos); };
+
+		for (auto pos = std::size_t{}; pos < count;)
+		{
+			const auto zero = is_zero(ptr + pos, block_length(pos));
+			auto       end  = pos + block_length(pos);
+			while (end < count && is_zero(ptr + end, block_length(end)) == zero)
+			{
+				end += block_length(end);
+			}
+			if (zero)
+			{
+				this->offset_ += end - pos;
+				this->progress();
+			}
+			else
+			{
+				this->write_all(ptr + pos, end - pos);
+			}
+			pos = end;
+		}
+	}
+
+	// Grows or shrinks the chunk size such that a chunk takes about target_chunk_duration.
+	void tune(std::size_t count, std::chrono::steady_clock::duration elapsed)
+	{
+		if (elapsed < target_chunk_duration / 2 && count == this->chunk_size_)
+		{
+			this->chunk_size_ = std::min(this->chunk_size_ * 2u, this->buf_.size());
+		}
+		else if (elapsed > target_chunk_duration * 2)
+		{
+			this->chunk_size_ = std::max(this->chunk_size_ / 2u, std::min(min_chunk_size, this->buf_.size()));
+		}
+	}
+
+	void progress()
+	{
+		if (this->on_progress_)
+		{
+			this->on_progress_(this->offset_);
+		}
+	}
+
+public:
+	explicit transfer(i_file&                                                in,
+	                  i_file&                                                out,
+	                  buffer_pool::lease                                     buf,
+	                  bool                                                   adaptive,
+	                  bool                                                   skip_zeros,
+	                  digester_list                                          digesters,
+	                  rate_limiter*                                          limiter,
+	                  i_interruptor&                                         interruptor,
+	                  const std::function<void(std::uint64_t bytes_copied)>& on_progress)
+	    : in_{ in }
+	    , out_{ out }
+	    , buf_{ std::move(buf) }
+	    , chunk_size_{ adaptive ? std::min(min_chunk_size, buf_.size()) : buf_.size() }
+	    , adaptive_{ adaptive }
+	    , skip_zeros_{ skip_zeros }
+	    , limiter_{ limiter }
+	    , interruptor_{ interruptor }
+	    , on_progress_{ on_progress }
+	    , offset_{}
+	    , out_offset_{}
+	    , out_size_{}
+	    , allocated_{}
+	    , digesters_{ std::move(digesters) }
+	{
+	}
+
+	std::uint64_t offset() const
+	{
+		return this->offset_;
+	}
+
+	// Continues at offset, the destination file already holds the data before it.
+	void resume(std::uint64_t offset)
+	{
+		this->offset_     = this->in_.seek(offset);
+		this->out_offset_ = this->out_.seek(offset);
+		this->out_size_   = offset;
+		this->progress();
+	}
+
+	// Size of the destination file
+	std::uint64_t size() const
+	{
+		return this->out_size_;
+	}
+
+	std::vector<digest> digests() const
+	{
+		return digest_values(this->digesters_);
+	}
+
+	// Positions the source file at offset, the destination file follows on the next write.
+	// The source file is positioned also when offset is the current offset, because seek_data and seek_hole
+	// may have moved the file offset.
+	void seek(std::uint64_t offset)
+	{
+		const auto previous = this->offset_;
+		this->offset_       = this->in_.seek(offset);
+		if (this->offset_ != previous)
+		{
+			update_digesters_zeros(this->digesters_, this->offset_ - previous);
+			this->progress();
+		}
+	}
+
+	// Copies up to count bytes, or until the end of the source file.
+	// Returns the number of bytes copied, which is less than count only at the end of the source file.
+	std::uint64_t copy(std::uint64_t count = std::numeric_limits<std::uint64_t>::max())
+	{
+		auto total = std::uint64_t{};
+		while (total < count)
+		{
+			const auto start     = std::chrono::steady_clock::now();
+			const auto readcount = static_cast<std::size_t>(std::min<std::uint64_t>(this->chunk_size_, count - total));
+			const auto nread     = this->in_.read(this->buf_.data(), readcount);
+			assert(nread <= readcount);
+			if (nread == 0)
+			{
+				break;
+			}
+			update_digesters(this->digesters_, this->buf_.data(), nread);
+			if (this->skip_zeros_)
+			{
+				this->write_sparse(this->buf_.data(), nread);
+			}
+			else
+			{
+				this->write_all(this->buf_.data(), nread);
+			}
+			total += nread;
+			if (this->adaptive_)
+			{
+				this->tune(readcount, std::chrono::steady_clock::now() - start);
+			}
+		}
+		return total;
+	}
+
+	// Copies the chunks produced by reader until the end of the source file.
+	void copy(read_ahead& reader)
+	{
+		for (auto chunk = reader.next(); chunk.size; chunk = reader.next())
+		{
+			update_digesters(this->digesters_, chunk.buf.data(), chunk.size);
+			this->write_all(chunk.buf.data(), chunk.size);
+			reader.recycle(std::move(chunk.buf));
+		}
+	}
+
+	// Preallocates the destination file. The file must be empty and written sequentially afterwards.
+	void allocate(std::uint64_t size)
+	{
+		if (size && this->out_.allocate(size))
+		{
+			this->allocated_ = size;
+		}
+	}
+
+	// Releases the space preallocated beyond the size that was actually written.
+	void release()
+	{
+		if (this->allocated_ && this->allocated_.value() != this->out_size_)
+		{
+			this->out_.truncate(this->out_size_);
+		}
+		this->allocated_.reset();
+	}
+
+	// Sets the size of the destination file if it ends with a hole.
+	void finish(std::uint64_t size)
+	{
+		size = std::max(size, this->offset_);
+		update_digesters_zeros(this->digesters_, size - this->offset_);
+		if (size > this->out_size_)
+		{
+			this->out_.truncate(size);
+			this->out_size_ = size;
+		}
+	}
+};
+
+// Reads count bytes, fewer only at the end of the file.
+std::size_t read_full(i_file& file, char* buf, std::size_t count)
+{
+	auto total = std::size_t{};
+	while (total < count)
+	{
+		const auto nread = file.read(buf + total, count - total);
+		if (nread == 0)
+		{
+			break;
+		}
+		total += nread;
+	}
+	return total;
+}
+
+// Compares the count bytes before offset in both files.
+bool tail_matches(i_file& in, i_file& part, std::uint64_t offset, std::uint64_t count)
+{
+	auto expected = std::vector<char>(static_cast<std::size_t>(std::min<std::uint64_t>(count, min_chunk_size)));
+	auto actual   = std::vector<char>(expected.size());
+	in.seek(offset - count);
+	part.seek(offset - count);
+	while (count)
+	{
+		const auto n = static_cast<std::size_t>(std::min<std::uint64_t>(count, expected.size()));
+		if (read_full(in, expected.data(), n) != n || read_full(part, actual.data(), n) != n ||
+		    std::memcmp(expected.data(), actual.data(), n) != 0)
+		{
+			return false;
+		}
+		count -= n;
+	}
+	return true;
+}
+
+// Returns the offset at which the partial file of dest_path can be continued, 0 to start over.
+std::uint64_t resume_offset(i_file&             in,
+                            i_access&           dest_access,
+                            const fspath&       dest_path,
+                            const attributes&   source_attr,
+                            const copy_options& opts)
+{
+	const auto expected  = partial_info::of(source_attr);
+	const auto part_path = partial_path(dest_path);
+	const auto part_attr = dest_access.try_stat(part_path);
+	if (!expected || !part_attr || !part_attr->size || read_partial_info(dest_access, partial_info_path(dest_path)) != expected)
+	{
+		return 0u;
+	}
+
+	const auto offset = std::min<std::uint64_t>(part_attr->size.value(), expected->size);
+	const auto count  = std::min(offset, opts.resume_verify_size);
+	if (count)
+	{
+		auto part = dest_access.open(part_path, O_RDONLY | O_BINARY, 0);
+		if (!tail_matches(in, *part, offset, count))
+		{
+			fslog(info, "{} does not match the source file, starting over", part_path);
+			return 0u;
+		}
+	}
+
+	fslog(debug, "continuing {} at offset {}", part_path, offset);
+	return offset;
+}
+
+// Feeds the first count bytes of file to the digesters.
+void digest_prefix(digester_list& digesters, i_file& file, std::uint64_t count, buffer_pool& pool)
+{
+	const auto buf = pool.acquire();
+	file.seek(0u);
+	while (count)
+	{
+		const auto nread = file.read(buf.data(), static_cast<std::size_t>(std::min<std::uint64_t>(count, buf.size())));
+		if (nread == 0)
+		{
+			break;
+		}
+		update_digesters(digesters, buf.data(), nread);
+		count -= nread;
+	}
+}
+
+// Returns the size of the regular file at path, or 0 if there is none.
+std::uint64_t previous_size(i_access& access, const fspath& path)
+{
+	const auto attr = access.try_stat(path);
+	return attr && attr->is_reg() ? attr->size.value_or(0u) : 0u;
+}
+
+// Updates out, the previous version of the destination file, to the source file. The source file is scanned
+// first, then the ranges that are not found at the same offset in the previous version are read from it again
+// and written. Data that moved, e.g. after an insertion near the start, is written like new data. When less
+// than half of the file would be kept, nothing is written: out is emptied, in is positioned at its start and
+// false is returned, so that the file is copied as a whole instead.
+bool update_in_place(i_file&                                                in,
+                     i_access&                                              dest_access,
+                     const fspath&                                          dest_path,
+                     std::uint64_t                                          old_size,
+                     i_file&                                                out,
+                     const std::vector<digest_algorithm>&                   algorithms,
+                     buffer_pool&                                           pool,
+                     rate_limiter*                                          limiter,
+                     i_interruptor&                                         interruptor,
+                     const std::function<void(std::uint64_t bytes_copied)>& on_progress,
+                     copy_result&                                           result)
+{
+	const auto signature = delta_signature::compute(*dest_access.open(dest_path, O_RDONLY | O_BINARY, 0),
+	                                                delta_signature::block_size_for(old_size));
+
+	struct range
+	{
+		std::uint64_t offset;
+		std::uint64_t length;
+	};
+	auto changed   = std::vector<range>{};
+	auto reused    = std::uint64_t{};
+	auto size      = std::uint64_t{};
+	auto digesters = make_digesters(algorithms);
+
+	auto&& on_op = [&](const delta_op& op) {
+		if (op.what == delta_op::kind::COPY && op.offset == op.target)
+		{
+			reused += op.length;
+		}
+		else if (!changed.empty() && changed.back().offset + changed.back().length == op.target)
+		{
+			changed.back().length += op.length;
+		}
+		else
+		{
+			changed.push_back(range{ op.target, op.length });
+		}
+		size = op.target + op.length;
+		if (on_progress)
+		{
+			on_progress(size);
+		}
+	};
+	auto&& on_data = [&](const char* data, std::size_t count) { update_digesters(digesters, data, count); };
+
+	compute_delta(in, signature, on_op, on_data);
+
+	if (reused < size / 2u)
+	{
+		fslog(debug, "{} of {} bytes of {} are kept, copying the whole file", reused, size, dest_path);
+		in.seek(0u);
+		out.truncate(0u);
+		return false;
+	}
+
+	auto buffers = acquire_buffers(pool, 1u);
+	auto buf     = buffers.front().data();
+	for (const auto& r : changed)
+	{
+		in.seek(r.offset);
+		out.seek(r.offset);
+		for (auto pos = std::uint64_t{}; pos < r.length;)
+		{
+			interruptor.throw_if_interrupted();
+			const auto count = static_cast<std::size_t>(std::min<std::uint64_t>(buffers.front().size(), r.length - pos));
+			const auto nread = read_full(in, buf, count);
+			if (limiter)
+			{
+				limiter->acquire(nread, interruptor);
+			}
+			for (auto written = std::size_t{}; written < nread;)
+			{
+				written += out.write(buf + written, nread - written);
+			}
+			pos += nread;
+			if (nread < count)
+			{
+				// The source file shrank since it was scanned
+				break;
+			}
+		}
+	}
+
+	if (size < signature.file_size)
+	{
+		out.truncate(size);
+	}
+	result.size    = size;
+	result.reused  = reused;
+	result.digests = digest_values(digesters);
+	return true;
+}
+
+// Flushes the data written to out to stable storage as opts.durability asks.
+void sync_data(i_file& out, const i_access& dest_access, const fspath& path, copy_options::durability_mode durability)
+{
+	switch (durability)
+	{
+	case copy_options::durability_mode::NONE:
+		break;
+	case copy_options::durability_mode::BATCH:
+		if (!dest_access.is_remote())
+		{
+			// The file system is flushed at the end of the batch
+			out.sync(false);
+			break;
+		}
+		[[fallthrough]];
+	case copy_options::durability_mode::PER_FILE:
+		if (!out.sync(true))
+		{
+			fslog(debug, "cannot flush {} to stable storage", path);
+		}
+		break;
+	}
+}
+
+// Modification times are compared to the second, SFTP version 3 has no finer resolution.
+bool same_mtime(const attributes& a, const attributes& b)
+{
+	return a.mtime && b.mtime &&
+	       std::chrono::floor<std::chrono::seconds>(a.mtime.value()) == std::chrono::floor<std::chrono::seconds>(b.mtime.value());
+}
+
+// Gives the destination file the metadata of the source file that opts asks to preserve, unless it has it.
+void preserve_metadata(i_access&                        dest_access,
+                       const fspath&                    path,
+                       const attributes&                source_attr,
+                       const std::optional<attributes>& dest_attr,
+                       const copy_options&              opts)
+{
+	auto perms = std::optional<mode_t>{};
+	if (opts.preserve_mode && (!dest_attr || (dest_attr->get_mode() & 07777) != (source_attr.get_mode() & 07777)))
+	{
+		perms = source_attr.get_mode() & 07777;
+	}
+	auto mtime = std::optional<std::chrono::system_clock::time_point>{};
+	if (opts.preserve_mtime && source_attr.mtime && (!dest_attr || !same_mtime(source_attr, dest_attr.value())))
+	{
+		mtime = source_attr.mtime;
+	}
+	if (perms || mtime)
+	{
+		dest_access.set_metadata(path, perms, mtime);
+	}
+}
+
+// Returns the existing destination file if it matches the source file as opts.skip_unchanged asks.
+std::optional<copy_result> find_unchanged(i_access&           source_access,
+                                          const source&       source,
+                                          i_access&           dest_access,
+                                          const destination&  dest,
+                                          const copy_options& opts)
+{
+	const auto source_attr = source_access.stat(source.current_path);
+
+	auto stated  = source;
+	stated.mtime = source.mtime ? source.mtime : source_attr.mtime;
+
+	// The file that would be replaced, whatever the conflict policy
+	auto overwrite             = dest;
+	overwrite.on_name_conflict = destination::conflict_policy::OVERWRITE;
+
+	const auto path      = make_dest_path(source_access, stated, dest_access, overwrite);
+	const auto dest_attr = dest_access.try_stat(path);
+	if (!dest_attr || !dest_attr->is_reg() || !source_attr.size || dest_attr->size != source_attr.size)
+	{
+		return std::nullopt;
+	}
+
+	const auto pool = make_buffer_pool(source_access, dest_access, source_attr, opts, 1u);
+	switch (opts.skip_unchanged)
+	{
+	case copy_options::skip_mode::NEVER:
+		return std::nullopt;
+	case copy_options::skip_mode::SIZE_MTIME:
+		if (!same_mtime(source_attr, dest_attr.value()))
+		{
+			return std::nullopt;
+		}
+		break;
+	case copy_options::skip_mode::CHECKSUM:
+	{
+		// Computed on the server where possible
+		const auto remote     = source_access.is_remote() || dest_access.is_remote();
+		const auto algorithms = std::vector<digest_algorithm>{ remote ? digest_algorithm::SHA256 : digest_algorithm::XXH3_64 };
+		const auto source_digests =
+		    file_digests(source_access, source.current_path, open_flags(source_access, O_RDONLY | O_BINARY, opts), algorithms, *pool);
+		if (file_digests(dest_access, path, open_flags(dest_access, O_RDONLY | O_BINARY, opts), algorithms, *pool) != source_digests)
+		{
+			return std::nullopt;
+		}
+		break;
+	}
+	}
+
+	fslog(debug, "{} is unchanged, not copying {}", path, source.current_path);
+	auto result = copy_result{ path, dest_attr->size.value(), {}, 0u, 0u, true, false };
+	if (!opts.digests.empty())
+	{
+		result.digests =
+		    file_digests(source_access, source.current_path, open_flags(source_access, O_RDONLY | O_BINARY, opts), opts.digests, *pool);
+	}
+	preserve_metadata(dest_access, path, source_attr, dest_attr, opts);
+	return result;
+}
+
+bool is_cross_device(const exception& e)
+{
+	const auto ec = boost::get_error_info<error_code>(e);
+	return ec && *ec == std::errc::cross_device_link;
+}
+
+// Copies count bytes at offset of in to the same offset of out with i_file::copy_from, in parts of
+// offload_chunk_size. Returns false if copy_from does not support the pair of files, then nothing is copied.
+bool offload_copy(i_file&                                                in,
+                  i_file&                                                out,
+                  std::uint64_t                                          offset,
+                  std::uint64_t                                          count,
+                  i_interruptor&                                         interruptor,
+                  const std::function<void(std::uint64_t bytes_copied)>& on_progress)
+{
+	const auto end = offset + count;
+	for (auto pos = offset; pos < end;)
+	{
+		interruptor.throw_if_interrupted();
+		const auto chunk = std::min(end - pos, offload_chunk_size);
+		if (!out.copy_from(in, pos, chunk, pos))
+		{
+			if (pos == offset)
+			{
+				return false;
+			}
+			FLEXFS_THROW(should_not_happen_exception{} << error_mesg{ "copy_from stopped being supported" });
+		}
+		pos += chunk;
+		if (on_progress)
+		{
+			on_progress(pos);
+		}
+	}
+	return true;
+}
+
+// Renames oldpath to newpath, replacing newpath if it exists. rename replaces it at once where it can (locally,
+// and with posix-rename on SFTP). Where it cannot, newpath is removed first, and only if it exists.
+void replace_file(i_access& access, const fspath& oldpath, const fspath& newpath)
+{
+	try
+	{
+		access.rename(oldpath, newpath);
+	}
+	catch (const interrupted_exception&)
+	{
+		throw;
+	}
+	catch (const exception& e)
+	{
+		if (!access.exists(newpath))
+		{
+			throw;
+		}
+		fslog(debug, "cannot rename {} over {}, removing it first: {}", oldpath, newpath, e.what());
+		try
+		{
+			access.remove(newpath);
+		}
+		catch (const exception&)
+		{
+			// Removed meanwhile
+			if (access.exists(newpath))
+			{
+				throw;
+			}
+		}
+		access.rename(oldpath, newpath);
+	}
+}
+
+} // namespace
+
 void move_file(i_access& access, source& source, const destination& dest)
 {
-	const auto new_path = make_dest_path(access, source, access, dest);
-	access.rename(source.current_path, new_path);
+	// Unless the conflict policy allows replacing a file, make_dest_path does the rename
+	auto       renamed  = false;
+	const auto new_path = make_dest_path(access, source, access, dest, [&](const fspath& path) {
+		return renamed = access.try_rename(source.current_path, path);
+	});
+	if (!renamed)
+	{
+		access.rename(source.current_path, new_path);
+	}
 	source.current_path = new_path;
 }
 
+copy_result move_file(i_access&                                       source_access,
+                      source&                                         source,
+                      i_access&                                       dest_access,
+                      const destination&                              dest,
+                      const copy_options&                             opts,
+                      std::function<void(std::uint64_t bytes_copied)> on_progress)
+{
+	if (opts.compression != copy_options::compression_mode::NONE)
+	{
+		auto uncompressed        = opts;
+		uncompressed.compression = copy_options::compression_mode::NONE;
+		return move_file(source_access, source, dest_access, dest, uncompressed, on_progress);
+	}
+
+	// Two local accesses reach the same file systems
+	if (&source_access == &dest_access || (!source_access.is_remote() && !dest_access.is_remote()))
+	{
+		try
+		{
+			move_file(source_access, source, dest);
+			const auto size = source_access.stat(source.current_path).size.value_or(0u);
+			return copy_result{ source.current_path, size, {}, 0u, 0u, false, false };
+		}
+		catch (const exception& e)
+		{
+			if (!is_cross_device(e))
+			{
+				throw;
+			}
+			fslog(debug, "cannot rename {} to another file system, copying it", source.current_path);
+		}
+	}
+
+	// The source is only removed when the copy is known to be good. Without digests of the copied data,
+	// e.g. when the data did not pass through here, both files are hashed. A destination file that was found
+	// unchanged, or that is a link to the source file, is not.
+	auto result = copy_file(source_access, source, dest_access, dest, opts, on_progress);
+	if (!opts.verify && !result.skipped && !result.linked)
+	{
+		const auto remote = source_access.is_remote() || dest_access.is_remote();
+		const auto pool   = opts.pool ? opts.pool : std::make_shared<buffer_pool>(remote ? remote_buffer_size : local_buffer_size, 1u);
+
+		auto expected = result.digests;
+		if (expected.empty())
+		{
+			const auto algorithm = remote ? digest_algorithm::SHA256 : digest_algorithm::CRC32C;
+			const auto flags     = open_flags(source_access, O_RDONLY | O_BINARY, opts);
+			expected             = file_digests(source_access, source.current_path, flags, { algorithm }, *pool);
+		}
+		verify_digests(dest_access, result.dest_path, open_flags(dest_access, O_RDONLY | O_BINARY, opts), expected, *pool);
+	}
+
+	source_access.remove(source.current_path);
+	source.current_path = result.dest_path;
+	return result;
+}
+
 fspath copy_file(i_access&                                       source_access,
                  const source&                                   source,
                  i_access&                                       dest_access,
                  const destination&                              dest,
                  std::function<void(std::uint64_t bytes_copied)> on_progress)
 {
-	auto in = source_access.open(source.current_path, O_RDONLY | O_BINARY, 0);
+	return copy_file(source_access, source, dest_access, dest, copy_options{}, on_progress).dest_path;
+}
+
+copy_result copy_file(i_access&                                       source_access,
+                      const source&                                   source,
+                      i_access&                                       dest_access,
+                      const destination&                              dest,
+                      const copy_options&                             opts,
+                      std::function<void(std::uint64_t bytes_copied)> on_progress)
+{
+	if (opts.compression != copy_options::compression_mode::NONE &&
+	    (opts.sparse != copy_options::sparse_mode::NEVER || opts.resume || opts.delta || opts.hard_link ||
+	     opts.skip_unchanged != copy_options::skip_mode::NEVER || opts.verify))
+	{
+		// These work on the data as it is stored in the destination file
+		auto compressed           = opts;
+		compressed.sparse         = copy_options::sparse_mode::NEVER;
+		compressed.resume         = false;
+		compressed.delta          = false;
+		compressed.hard_link      = false;
+		compressed.skip_unchanged = copy_options::skip_mode::NEVER;
+		compressed.verify         = false;
+		return copy_file(source_access, source, dest_access, dest, compressed, on_progress);
+	}
+
+	if (opts.skip_unchanged != copy_options::skip_mode::NEVER)
+	{
+		if (auto result = find_unchanged(source_access, source, dest_access, dest, opts))
+		{
+			return std::move(result.value());
+		}
+	}
+
+	auto in = source_access.open(source.current_path, open_flags(source_access, O_RDONLY | O_BINARY, opts), 0);
+
+	const auto source_attr = source_access.stat(source.current_path);
+	const auto mode        = source_attr.get_mode() & ~S_IFMT;
 
-	const auto dest_path = make_dest_path(source_access, source, dest_access, dest);
+	// Spares make_dest_path a stat for the time placeholders of dest
+	auto stated  = source;
+	stated.mtime = source.mtime ? source.mtime : source_attr.mtime;
 
-	auto out =
-	    dest_access.open(dest_path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, source_access.stat(source.current_path).get_mode() & ~S_IFMT);
+	// A hard link needs both names on the same file system, which is only known once it is tried
+	const auto same_side = &source_access == &dest_access || (!source_access.is_remote() && !dest_access.is_remote());
 
-	std::array<char, 65536u> buf{};
-	std::uint64_t            bytes_copied{};
+	auto   link    = opts.hard_link && !opts.resume && same_side;
+	auto   linked  = false;
+	auto&& link_to = [&](const fspath& path) {
+		try
+		{
+			return linked = dest_access.try_link(source.current_path, path);
+		}
+		catch (const interrupted_exception&)
+		{
+			throw;
+		}
+		catch (const exception& e)
+		{
+			fslog(debug, "cannot link {} to {}, copying the data: {}", path, source.current_path, e.what());
+			link = false;
+			return false;
+		}
+	};
+
+	// Unless the conflict policy allows replacing a file, make_dest_path creates it. In resume mode, the
+	// partial file is renamed to a free name when it is complete.
+	auto   out    = std::unique_ptr<i_file>{};
+	auto&& create = [&](const fspath& path) {
+		if (link)
+		{
+			const auto created = link_to(path);
+			if (link)
+			{
+				return created;
+			}
+		}
+		out = dest_access.try_create(path, open_flags(dest_access, O_WRONLY | O_BINARY, opts), mode);
+		return out != nullptr;
+	};
+	const auto dest_path = opts.resume ? make_dest_path(source_access, stated, dest_access, dest)
+	                                   : make_dest_path(source_access, stated, dest_access, dest, create);
 
-	for (;;)
+	if (link && dest.on_name_conflict == destination::conflict_policy::OVERWRITE && !link_to(dest_path) && link)
 	{
-		const auto count = in->read(buf.data(), buf.size());
-		assert(count <= buf.size());
-		if (count == 0)
+		// A link does not replace a file. It is made under a temporary name and renamed over the destination
+		// file, which is then replaced at once, and kept when the link cannot be made.
+		const auto temp_path = fspath{ dest_path.string() + ".link" };
+		if (!link_to(temp_path) && link)
 		{
-			break;
+			// Left by an earlier copy that failed
+			dest_access.remove(temp_path);
+			link_to(temp_path);
+		}
+		if (linked)
+		{
+			try
+			{
+				dest_access.rename(temp_path, dest_path);
+			}
+			catch (const interrupted_exception&)
+			{
+				throw;
+			}
+			catch (const exception& e)
+			{
+				// e.g. a server without posix-rename, which does not replace files
+				fslog(debug, "cannot rename {} to {}, copying the data: {}", temp_path, dest_path, e.what());
+				linked = false;
+			}
+			// A rename between two names of the same file does nothing
+			if (dest_access.exists(temp_path))
+			{
+				dest_access.remove(temp_path);
+			}
+		}
+	}
+	if (linked)
+	{
+		const auto size   = source_attr.size.value_or(0u);
+		auto       result = copy_result{ dest_path, size, {}, 0u, 0u, false, true };
+		if (!opts.digests.empty())
+		{
+			const auto pool  = make_buffer_pool(source_access, dest_access, source_attr, opts, 1u);
+			const auto flags = open_flags(source_access, O_RDONLY | O_BINARY, opts);
+			result.digests   = file_digests(source_access, source.current_path, flags, opts.digests, *pool);
+		}
+		if (on_progress)
+		{
+			on_progress(size);
+		}
+		return result;
+	}
+
+	// In resume mode, the data goes to a partial file that is renamed when complete
+	const auto write_path = opts.resume ? partial_path(dest_path) : dest_path;
+	const auto resumed    = opts.resume ? resume_offset(*in, dest_access, dest_path, source_attr, opts) : std::uint64_t{};
+
+	// In delta mode, a previous version of the destination file is updated where it differs
+	const auto old_size = opts.delta && !out && !opts.resume && opts.sparse == copy_options::sparse_mode::NEVER
+	                          ? previous_size(dest_access, dest_path)
+	                          : std::uint64_t{};
+
+	if (!out)
+	{
+		out = dest_access.open(
+		    write_path,
+		    open_flags(dest_access, resumed || old_size ? O_WRONLY | O_BINARY : O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, opts),
+		    mode);
+	}
+
+	// The compression thread writes to the destination file, which it cannot do while this thread reads the
+	// source file through the same remote session
+	auto gzip = static_cast<gzip_writer*>(nullptr);
+	if (opts.compression == copy_options::compression_mode::GZIP)
+	{
+		const auto threaded = &source_access != &dest_access || !source_access.is_remote();
+		auto       writer   = std::make_unique<gzip_writer>(std::move(out), opts.compression_level, threaded);
+		gzip                = writer.get();
+		out                 = std::move(writer);
+	}
+
+	if (resumed)
+	{
+		// Drop anything beyond the source size
+		out->truncate(resumed);
+	}
+	else if (opts.resume)
+	{
+		if (const auto info = partial_info::of(source_attr))
+		{
+			write_partial_info(dest_access, partial_info_path(dest_path), info.value());
 		}
 		else
 		{
-			auto ptr = buf.data();
-			for (auto writecount = count; writecount;)
+			// Cannot be resumed
+			if (dest_access.exists(partial_info_path(dest_path)))
 			{
-				const auto written = out->write(ptr, writecount);
-				assert(written <= writecount);
-				writecount -= written;
-				ptr += written;
-				if (on_progress)
+				dest_access.remove(partial_info_path(dest_path));
+			}
+		}
+	}
+
+	// Reading ahead on a separate thread requires sequential reading. It is also not possible when both files
+	// are on the same remote session, which cannot be used from two threads at the same time.
+	auto buffer_count = opts.buffer_count ? opts.buffer_count : auto_buffer_count;
+	if (opts.sparse != copy_options::sparse_mode::NEVER || (&source_access == &dest_access && source_access.is_remote()))
+	{
+		buffer_count = 1u;
+	}
+
+	const auto pool = make_buffer_pool(source_access, dest_access, source_attr, opts, buffer_count);
+
+	auto algorithms = opts.digests;
+	if (opts.verify && algorithms.empty())
+	{
+		// A remote server can hash SHA-256 without sending the file back, CRC32C is cheapest to read back
+		algorithms.push_back(dest_access.is_remote() ? digest_algorithm::SHA256 : digest_algorithm::CRC32C);
+	}
+
+	auto digesters = make_digesters(algorithms);
+	if (resumed && !digesters.empty())
+	{
+		// The digests cover the whole file, read the data that was copied before from the local end
+		if (source_access.is_remote() && !dest_access.is_remote())
+		{
+			digest_prefix(digesters, *dest_access.open(write_path, O_RDONLY | O_BINARY, 0), resumed, *pool);
+		}
+		else
+		{
+			digest_prefix(digesters, *in, resumed, *pool);
+		}
+	}
+
+	auto result = copy_result{ dest_path, 0u, {}, resumed, 0u, false, false };
+
+	const auto interruptor = opts.interruptor ? opts.interruptor : std::make_shared<noop_interruptor>();
+
+	// Within one server or file system, the data does not have to pass through here if the server or the kernel
+	// can copy it. The digests do need the data, and the transfer options are only honoured by the transfer.
+	const auto source_size = source_attr.size.value_or(0u);
+	const auto offload     = !old_size && algorithms.empty() && opts.sparse == copy_options::sparse_mode::NEVER && !opts.rate_limit &&
+	                         !opts.direct_io && !opts.pool && opts.buffer_size == 0u && (!opts.preallocate || dest_access.is_remote());
+	if (offload && source_size > resumed && offload_copy(*in, *out, resumed, source_size - resumed, *interruptor, on_progress))
+	{
+		result.size = source_size;
+	}
+	else if (!old_size ||
+	         !update_in_place(
+	             *in, dest_access, dest_path, old_size, *out, algorithms, *pool, opts.rate_limit.get(), *interruptor, on_progress, result))
+	{
+		auto buffers = acquire_buffers(*pool, buffer_count);
+
+		const auto pipelined = buffers.size() > 1u;
+		const auto adaptive  = opts.buffer_size == 0u && !opts.pool;
+
+		auto xfer = transfer{ *in,
+			                  *out,
+			                  pipelined ? buffer_pool::lease{} : std::move(buffers.front()),
+			                  adaptive,
+			                  opts.sparse == copy_options::sparse_mode::ALWAYS,
+			                  std::move(digesters),
+			                  opts.rate_limit.get(),
+			                  *interruptor,
+			                  on_progress };
+
+		if (resumed)
+		{
+			xfer.resume(resumed);
+		}
+
+		if (opts.sparse == copy_options::sparse_mode::NEVER)
+		{
+			if (opts.preallocate && !opts.resume && !dest_access.is_remote())
+			{
+				xfer.allocate(source_attr.size.value_or(0u));
+			}
+			try
+			{
+				if (pipelined)
+				{
+					auto reader = read_ahead{ *in, std::move(buffers) };
+					xfer.copy(reader);
+				}
+				else
 				{
-					bytes_copied += written;
-					on_progress(bytes_copied);
+					xfer.copy();
 				}
 			}
+			catch (...)
+			{
+				try
+				{
+					xfer.release();
+				}
+				catch (const std::exception& e)
+				{
+					fslog(warn, "could not truncate {}: {}", dest_path, e.what());
+				}
+				throw;
+			}
+			xfer.release();
 		}
+		else
+		{
+			for (;;)
+			{
+				const auto data = in->seek_data(xfer.offset());
+				if (!data)
+				{
+					break;
+				}
+				const auto hole = in->seek_hole(data.value());
+				xfer.seek(data.value());
+				if (xfer.copy(hole - data.value()) < hole - data.value())
+				{
+					break;
+				}
+			}
+			xfer.finish(source_attr.size.value_or(0u));
+		}
+
+		result.size    = xfer.size();
+		result.digests = xfer.digests();
+	}
+
+	if (gzip)
+	{
+		result.size = gzip->finish();
+	}
+
+	// Before the partial file is renamed, so that the destination path never has incomplete data
+	sync_data(*out, dest_access, write_path, opts.durability);
+
+	if (opts.resume)
+	{
+		out.reset();
+		if (dest.on_name_conflict == destination::conflict_policy::OVERWRITE)
+		{
+			replace_file(dest_access, write_path, dest_path);
+		}
+		else
+		{
+			result.dest_path = make_dest_path(source_access, stated, dest_access, dest, [&](const fspath& path) {
+				return dest_access.try_rename(write_path, path);
+			});
+		}
+		if (dest_access.exists(partial_info_path(dest_path)))
+		{
+			dest_access.remove(partial_info_path(dest_path));
+		}
+	}
+
+	if (opts.verify)
+	{
+		out.reset();
+		verify_digests(dest_access, result.dest_path, open_flags(dest_access, O_RDONLY | O_BINARY, opts), result.digests, *pool);
+	}
+
+	if (opts.preserve_mtime || opts.preserve_mode)
+	{
+		// After the last write, which updates the modification time
+		out.reset();
+		preserve_metadata(dest_access, result.dest_path, source_attr, std::nullopt, opts);
 	}
 
-	return dest_path;
+	return result;
 }
 
 } // namespace flexfs
@@ -12,19 +12,59 @@
 #include "flexfs/core/fspath.h"
 #include "flexfs/core/source.h"
 #include "flexfs/core/destination.h"
+#include "flexfs/core/copy_options.h"
+#include "flexfs/core/digest.h"
 #include <functional>
+#include <vector>
 #include <cstddef>
+#include <cstdint>
 
 namespace flexfs {
 
 // TODO: add documentation
 FLEXFS_EXPORT void move_file(i_access& access, source& source, const destination& dest);
 
-// TODO: add documentation
+// Copies with the default copy_options, see below.
 FLEXFS_EXPORT fspath copy_file(i_access&                                       source_access,
                                const source&                                   source,
                                i_access&                                       dest_access,
                                const destination&                              dest,
                                std::function<void(std::uint64_t bytes_copied)> on_progress = nullptr);
 
+struct FLEXFS_EXPORT copy_result
+{
+	fspath              dest_path;
+	std::uint64_t       size;    // of the destination file
+	std::vector<digest> digests; // of the source data, as requested by copy_options::digests
+	std::uint64_t       resumed; // offset at which a partial file was continued, see copy_options::resume
+	std::uint64_t       reused;  // bytes of the previous destination file that were kept, see copy_options::delta
+	bool                skipped; // the destination file was left as it was, see copy_options::skip_unchanged
+	bool                linked;  // the destination file is a hard link to the source file, see copy_options::hard_link
+};
+
+// Copies the source file to the destination, as opts asks. on_progress receives the number of bytes of the
+// source file copied so far.
+// Copies between two files on the same server are done by the server when it supports that (the SFTP
+// copy-data extension), and copies between two local files by the kernel (copy_file_range). The data then
+// does not pass through here, and progress is reported after each part of 64 MiB instead of after each
+// buffer. This is only done when no digests are requested, the copy is not sparse or a delta update, and
+// rate_limit, direct_io, pool and buffer_size are left at their defaults, as is preallocate for local files.
+FLEXFS_EXPORT copy_result copy_file(i_access&                                       source_access,
+                                    const source&                                   source,
+                                    i_access&                                       dest_access,
+                                    const destination&                              dest,
+                                    const copy_options&                             opts,
+                                    std::function<void(std::uint64_t bytes_copied)> on_progress = nullptr);
+
+// Moves a file to another directory, file system or access. A rename is tried first when both accesses are
+// the same, or both are local. Otherwise, or when the rename fails with EXDEV, the file is copied with
+// copy_file, the copy is verified against the source data unless it was skipped or linked, and the source file
+// is removed. Updates source.current_path.
+FLEXFS_EXPORT copy_result move_file(i_access&                                       source_access,
+                                    source&                                         source,
+                                    i_access&                                       dest_access,
+                                    const destination&                              dest,
+                                    const copy_options&                             opts        = {},
+                                    std::function<void(std::uint64_t bytes_copied)> on_progress = nullptr);
+
 } // namespace flexfs
@@ -0,0 +1,90 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/partial_file.h"
+#include "flexfs/core/i_file.h"
+#include "flexfs/core/logging.h"
+#include "flexfs/core/formatters.h"
+#include <fmt/format.h>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cinttypes>
+
+namespace flexfs {
+
+namespace {
+
+// Format version 1, followed by the source size and modification time
+constexpr auto info_format = "flexfs-partial 1 %" SCNu64 " %" SCNd64;
+
+} // namespace
+
+std::optional<partial_info> partial_info::of(const attributes& source_attr)
+{
+	if (!source_attr.size || !source_attr.mtime)
+	{
+		return std::nullopt;
+	}
+	return partial_info{ static_cast<std::uint64_t>(source_attr.size.value()),
+		                 std::chrono::duration_cast<std::chrono::seconds>(source_attr.mtime->time_since_epoch()).count() };
+}
+
+fspath partial_path(const fspath& dest_path)
+{
+	auto result = dest_path;
+	result += ".part";
+	return result;
+}
+
+fspath partial_info_path(const fspath& dest_path)
+{
+	auto result = dest_path;
+	result += ".part.info";
+	return result;
+}
+
+std::optional<partial_info> read_partial_info(i_access& access, const fspath& path)
+{
+	if (!access.exists(path))
+	{
+		return std::nullopt;
+	}
+
+	auto file = access.open(path, O_RDONLY | O_BINARY, 0);
+	char buf[128]{};
+	auto size = std::size_t{};
+	while (size < sizeof(buf) - 1u)
+	{
+		const auto nread = file->read(buf + size, sizeof(buf) - 1u - size);
+		if (nread == 0)
+		{
+			break;
+		}
+		size += nread;
+	}
+
+	auto info = partial_info{};
+	if (std::sscanf(buf, info_format, &info.size, &info.mtime) != 2)
+	{
+		fslog(warn, "ignoring malformed partial file info {}", path);
+		return std::nullopt;
+	}
+	return info;
+}
+
+void write_partial_info(i_access& access, const fspath& path, const partial_info& info)
+{
+	const auto text = fmt::format("flexfs-partial 1 {} {}\n", info.size, info.mtime);
+	auto       file = access.open(path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+	for (auto ptr = text.data(), end = text.data() + text.size(); ptr < end;)
+	{
+		ptr += file->write(ptr, static_cast<std::size_t>(end - ptr));
+	}
+}
+
+} // namespace flexfs
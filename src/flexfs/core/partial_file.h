@@ -0,0 +1,39 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/i_access.h"
+#include "flexfs/core/attributes.h"
+#include "flexfs/core/fspath.h"
+#include <optional>
+#include <cstdint>
+
+namespace flexfs {
+
+// Identifies the source file of a partial destination file, so that a later copy can tell whether the
+// partial file can be continued.
+struct FLEXFS_LOCAL partial_info
+{
+	std::uint64_t size;  // of the source file
+	std::int64_t  mtime; // of the source file, in seconds since the epoch
+
+	bool operator==(const partial_info&) const = default;
+
+	// Returns nothing if the size or the modification time of the source file is not known.
+	static std::optional<partial_info> of(const attributes& source_attr);
+};
+
+FLEXFS_LOCAL fspath partial_path(const fspath& dest_path);      // the partial destination file
+FLEXFS_LOCAL fspath partial_info_path(const fspath& dest_path); // the partial_info next to it
+
+// Returns nothing if the file does not exist or cannot be parsed.
+FLEXFS_LOCAL std::optional<partial_info> read_partial_info(i_access& access, const fspath& path);
+FLEXFS_LOCAL void                        write_partial_info(i_access& access, const fspath& path, const partial_info& info);
+
+} // namespace flexfs
@@ -0,0 +1,91 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/rate_limiter.h"
+#include <algorithm>
+#include <thread>
+
+namespace flexfs {
+
+rate_limiter::rate_limiter(std::uint64_t bytes_per_second, std::uint64_t burst, std::shared_ptr<rate_limiter> parent)
+    : parent_{ std::move(parent) }
+    , mutex_{}
+    , rate_{ bytes_per_second }
+    , burst_{ burst ? burst : bytes_per_second }
+    , tokens_{ static_cast<double>(burst_) }
+    , last_{ clock::now() }
+{
+}
+
+std::uint64_t rate_limiter::rate() const
+{
+	auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+	return this->rate_;
+}
+
+std::uint64_t rate_limiter::burst() const
+{
+	auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+	return this->burst_;
+}
+
+const std::shared_ptr<rate_limiter>& rate_limiter::parent() const
+{
+	return this->parent_;
+}
+
+void rate_limiter::set_rate(std::uint64_t bytes_per_second, std::uint64_t burst)
+{
+	auto lock    = std::lock_guard<std::mutex>{ this->mutex_ };
+	this->rate_  = bytes_per_second;
+	this->burst_ = burst ? burst : bytes_per_second;
+	// A debt at the old rate is kept, a surplus cannot exceed the new bucket size
+	this->tokens_ = std::min(this->tokens_, static_cast<double>(this->burst_));
+}
+
+rate_limiter::clock::duration rate_limiter::reserve(std::uint64_t bytes, clock::time_point now)
+{
+	auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+	if (this->rate_ == 0u)
+	{
+		return clock::duration::zero();
+	}
+
+	const auto elapsed = std::chrono::duration<double>(std::max(now, this->last_) - this->last_).count();
+	this->tokens_      = std::min(this->tokens_ + elapsed * static_cast<double>(this->rate_), static_cast<double>(this->burst_));
+	this->last_        = std::max(now, this->last_);
+	this->tokens_ -= static_cast<double>(bytes);
+
+	if (this->tokens_ >= 0.0)
+	{
+		return clock::duration::zero();
+	}
+	return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(-this->tokens_ / static_cast<double>(this->rate_)));
+}
+
+void rate_limiter::acquire(std::uint64_t bytes, i_interruptor& interruptor)
+{
+	const auto now  = clock::now();
+	auto       wait = clock::duration::zero();
+	for (auto node = this; node; node = node->parent_.get())
+	{
+		wait = std::max(wait, node->reserve(bytes, now));
+	}
+
+	if (wait > clock::duration::zero())
+	{
+		const auto deadline = now + wait;
+		if (interruptor.wait_for_interruption(std::chrono::ceil<std::chrono::milliseconds>(wait)))
+		{
+			FLEXFS_THROW(interrupted_exception{});
+		}
+		// Not every interruptor actually waits
+		std::this_thread::sleep_until(deadline);
+	}
+}
+
+} // namespace flexfs
@@ -0,0 +1,59 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/i_interruptor.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+namespace flexfs {
+
+/// @brief Thread safe token bucket that caps the throughput of the copies sharing it.
+/// Buckets form a hierarchy, e.g. global -> host -> job: a transfer through a bucket is also limited by
+/// all of its parents. Tokens are refilled on use, there is no background thread.
+/// A transfer that exceeds the available tokens is not refused but paced, it waits until the tokens it
+/// borrowed would have been refilled. The parents must outlive their children.
+class FLEXFS_EXPORT rate_limiter final
+{
+	using clock = std::chrono::steady_clock;
+
+	std::shared_ptr<rate_limiter> parent_;
+	mutable std::mutex            mutex_;
+	std::uint64_t                 rate_;   // bytes per second, 0 is unlimited
+	std::uint64_t                 burst_;  // bucket size in bytes
+	double                        tokens_; // negative when borrowed
+	clock::time_point             last_;   // of the last refill
+
+	clock::duration reserve(std::uint64_t bytes, clock::time_point now);
+
+public:
+	/// @param bytes_per_second Sustained rate, 0 for no limit at this level.
+	/// @param burst Number of bytes that can be transferred at once after an idle period. 0 selects one
+	///              second worth of bytes.
+	/// @param parent Bucket that limits this one and its siblings together, if any.
+	explicit rate_limiter(std::uint64_t bytes_per_second, std::uint64_t burst = 0u, std::shared_ptr<rate_limiter> parent = nullptr);
+
+	rate_limiter(const rate_limiter&)            = delete;
+	rate_limiter& operator=(const rate_limiter&) = delete;
+
+	std::uint64_t                        rate() const;
+	std::uint64_t                        burst() const;
+	const std::shared_ptr<rate_limiter>& parent() const;
+
+	/// Changes the limit, e.g. on a schedule. Takes effect for the next acquire().
+	void set_rate(std::uint64_t bytes_per_second, std::uint64_t burst = 0u);
+
+	/// Takes bytes from this bucket and its parents, and waits as long as any of them is in debt.
+	/// Throws interrupted_exception if interrupted while waiting.
+	void acquire(std::uint64_t bytes, i_interruptor& interruptor);
+};
+
+} // namespace flexfs
@@ -0,0 +1,113 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/rolling_checksum.h"
+
+#if FLEXFS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace flexfs {
+
+namespace {
+
+// All sums are kept modulo 2^32, which is all that is needed for the 16 bit results.
+struct sums
+{
+	std::uint32_t a;
+	std::uint32_t b;
+};
+
+// b = sum of (size - i) * p[i] over the window
+void add_scalar(sums& s, const std::uint8_t* p, std::size_t begin, std::size_t end, std::uint32_t size)
+{
+	for (auto i = begin; i < end; ++i)
+	{
+		s.a += p[i];
+		s.b += (size - static_cast<std::uint32_t>(i)) * p[i];
+	}
+}
+
+#if FLEXFS_X86_DISPATCH
+FLEXFS_TARGET("avx2") std::uint64_t hsum_epi64(__m256i v)
+{
+	const auto lo = _mm256_castsi256_si128(v);
+	const auto hi = _mm256_extracti128_si256(v, 1);
+	const auto s  = _mm_add_epi64(lo, hi);
+	return static_cast<std::uint64_t>(_mm_cvtsi128_si64(s)) + static_cast<std::uint64_t>(_mm_extract_epi64(s, 1));
+}
+
+FLEXFS_TARGET("avx2") std::uint32_t hsum_epi32(__m256i v)
+{
+	const auto lo = _mm256_castsi256_si128(v);
+	const auto hi = _mm256_extracti128_si256(v, 1);
+	auto       s  = _mm_add_epi32(lo, hi);
+	s             = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+	s             = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+	return static_cast<std::uint32_t>(_mm_cvtsi128_si32(s));
+}
+
+// Per 32 byte chunk c at offset 32c: a gets the byte sum S(c), b gets (size - 32c) * S(c) - sum of j * p[32c + j].
+// The sum over c of c * S(c) follows from the running totals of the previous chunk sums, which add up to
+// the sum over c of (chunks - 1 - c) * S(c).
+FLEXFS_TARGET("avx2") std::size_t add_avx2(sums& s, const std::uint8_t* p, std::size_t size)
+{
+	const auto weights = _mm256_setr_epi8(
+	    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+	const auto ones  = _mm256_set1_epi16(1);
+	const auto zero  = _mm256_setzero_si256();
+	auto       v_sum = _mm256_setzero_si256(); // byte sums, 64 bit lanes
+	auto       v_pre = _mm256_setzero_si256(); // running totals of v_sum before each chunk
+	auto       v_w   = _mm256_setzero_si256(); // weighted sums, 32 bit lanes
+
+	const auto chunks = size / 32u;
+	if (chunks == 0u)
+	{
+		return 0u;
+	}
+	for (auto c = std::size_t{}; c < chunks; ++c)
+	{
+		const auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + c * 32u));
+		v_pre        = _mm256_add_epi64(v_pre, v_sum);
+		v_sum        = _mm256_add_epi64(v_sum, _mm256_sad_epu8(x, zero));
+		v_w          = _mm256_add_epi32(v_w, _mm256_madd_epi16(_mm256_maddubs_epi16(x, weights), ones));
+	}
+
+	const auto a   = static_cast<std::uint32_t>(hsum_epi64(v_sum));
+	const auto pre = static_cast<std::uint32_t>(hsum_epi64(v_pre));
+	const auto w   = hsum_epi32(v_w);
+	s.a += a;
+	const auto ca  = static_cast<std::uint32_t>(chunks - 1u) * a - pre; // sum of c * S(c)
+	s.b += static_cast<std::uint32_t>(size) * a - 32u * ca - w;
+	return chunks * 32u;
+}
+#endif
+
+} // namespace
+
+rolling_checksum::rolling_checksum(const void* data, std::size_t size, const cpu_features& cpu)
+    : a_{}
+    , b_{}
+    , size_{ static_cast<std::uint32_t>(size) }
+{
+	const auto p     = static_cast<const std::uint8_t*>(data);
+	auto       s     = sums{};
+	auto       begin = std::size_t{};
+#if FLEXFS_X86_DISPATCH
+	if (cpu.avx2)
+	{
+		begin = add_avx2(s, p, size);
+	}
+#else
+	(void)cpu;
+#endif
+	add_scalar(s, p, begin, size, this->size_);
+	this->a_ = s.a;
+	this->b_ = s.b;
+}
+
+} // namespace flexfs
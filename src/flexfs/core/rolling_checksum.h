@@ -0,0 +1,41 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/cpu_features.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace flexfs {
+
+// The weak checksum of the rsync algorithm, an Adler-32 variant that can be moved along a buffer one byte
+// at a time. a is the sum of the bytes, b the sum of a over the window, both modulo 2^16.
+// The initial sums are computed with AVX2 when available.
+class rolling_checksum final
+{
+	std::uint32_t a_;
+	std::uint32_t b_;
+	std::uint32_t size_;
+
+public:
+	explicit rolling_checksum(const void* data, std::size_t size, const cpu_features& cpu = cpu_features::get());
+
+	std::uint32_t value() const
+	{
+		return (this->a_ & 0xffffu) | (this->b_ << 16);
+	}
+
+	// Moves the window one byte ahead
+	void roll(std::uint8_t out, std::uint8_t in)
+	{
+		this->a_ += static_cast<std::uint32_t>(in) - out;
+		this->b_ += this->a_ - this->size_ * out;
+	}
+};
+
+} // namespace flexfs
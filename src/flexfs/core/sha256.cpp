@@ -0,0 +1,222 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/sha256.h"
+#include <algorithm>
+#include <cstring>
+
+#if FLEXFS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace flexfs {
+
+namespace {
+
+alignas(16) constexpr std::uint32_t k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5, //
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, //
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, //
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, //
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, //
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, //
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3, //
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2, //
+};
+
+std::uint32_t rotr(std::uint32_t v, int r)
+{
+	return (v >> r) | (v << (32 - r));
+}
+
+std::uint32_t read_be32(const std::uint8_t* p)
+{
+	return (std::uint32_t{ p[0] } << 24) | (std::uint32_t{ p[1] } << 16) | (std::uint32_t{ p[2] } << 8) | std::uint32_t{ p[3] };
+}
+
+void compress_portable(std::uint32_t* state, const std::uint8_t* blocks, std::size_t count)
+{
+	for (; count; --count, blocks += sha256_digester::block_size)
+	{
+		std::uint32_t w[64];
+		for (auto i = 0; i < 16; ++i)
+		{
+			w[i] = read_be32(blocks + 4 * i);
+		}
+		for (auto i = 16; i < 64; ++i)
+		{
+			const auto s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			const auto s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i]          = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		auto a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+		for (auto i = 0; i < 64; ++i)
+		{
+			const auto s1    = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+			const auto ch    = (e & f) ^ (~e & g);
+			const auto temp1 = h + s1 + ch + k[i] + w[i];
+			const auto s0    = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+			const auto maj   = (a & b) ^ (a & c) ^ (b & c);
+			const auto temp2 = s0 + maj;
+			h                = g;
+			g                = f;
+			f                = e;
+			e                = d + temp1;
+			d                = c;
+			c                = b;
+			b                = a;
+			a                = temp1 + temp2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+#if FLEXFS_X86_DISPATCH
+FLEXFS_TARGET("sha,sse4.1") void compress_sha(std::uint32_t* state, const std::uint8_t* blocks, std::size_t count)
+{
+	const auto mask = _mm_set_epi64x(0x0c0d0e0f08090a0bull, 0x0405060700010203ull);
+
+	// The SHA instructions work on the state as ABEF and CDGH
+	auto tmp    = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xb1);     // CDAB
+	auto state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1b); // EFGH
+	auto state0 = _mm_alignr_epi8(tmp, state1, 8);                                                       // ABEF
+	state1      = _mm_blend_epi16(state1, tmp, 0xf0);                                                    // CDGH
+
+	for (; count; --count, blocks += sha256_digester::block_size)
+	{
+		const auto abef_save = state0;
+		const auto cdgh_save = state1;
+
+		// Message schedule, 4 words per register, rotating through the 16 round groups
+		__m128i msg[4];
+		for (auto i = 0; i < 4; ++i)
+		{
+			msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * i)), mask);
+		}
+
+#pragma GCC unroll 16
+		for (auto g = 0; g < 16; ++g)
+		{
+			auto m = _mm_add_epi32(msg[g % 4], _mm_load_si128(reinterpret_cast<const __m128i*>(k + 4 * g)));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+			if (g >= 3 && g <= 14)
+			{
+				auto& next = msg[(g + 1) % 4];
+				next       = _mm_add_epi32(next, _mm_alignr_epi8(msg[g % 4], msg[(g + 3) % 4], 4));
+				next       = _mm_sha256msg2_epu32(next, msg[g % 4]);
+			}
+			m      = _mm_shuffle_epi32(m, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, m);
+			if (g >= 1 && g <= 12)
+			{
+				msg[(g + 3) % 4] = _mm_sha256msg1_epu32(msg[(g + 3) % 4], msg[g % 4]);
+			}
+		}
+
+		state0 = _mm_add_epi32(state0, abef_save);
+		state1 = _mm_add_epi32(state1, cdgh_save);
+	}
+
+	tmp    = _mm_shuffle_epi32(state0, 0x1b);    // FEBA
+	state1 = _mm_shuffle_epi32(state1, 0xb1);    // DCHG
+	state0 = _mm_blend_epi16(tmp, state1, 0xf0); // DCBA
+	state1 = _mm_alignr_epi8(state1, tmp, 8);    // ABEF
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+#endif
+
+} // namespace
+
+sha256_digester::sha256_digester(const cpu_features& cpu)
+    : sha_{ cpu.sha }
+    , state_{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+    , total_{}
+    , buffered_{}
+    , buffer_{}
+{
+}
+
+void sha256_digester::compress(std::uint32_t* state, const std::uint8_t* blocks, std::size_t count) const
+{
+#if FLEXFS_X86_DISPATCH
+	if (this->sha_)
+	{
+		compress_sha(state, blocks, count);
+		return;
+	}
+#endif
+	compress_portable(state, blocks, count);
+}
+
+void sha256_digester::update(const void* data, std::size_t size)
+{
+	auto input = static_cast<const std::uint8_t*>(data);
+	this->total_ += size;
+
+	if (this->buffered_)
+	{
+		const auto n = std::min(size, block_size - this->buffered_);
+		std::memcpy(this->buffer_ + this->buffered_, input, n);
+		this->buffered_ += n;
+		input += n;
+		size -= n;
+		if (this->buffered_ < block_size)
+		{
+			return;
+		}
+		this->compress(this->state_, this->buffer_, 1u);
+		this->buffered_ = 0u;
+	}
+
+	const auto count = size / block_size;
+	if (count)
+	{
+		this->compress(this->state_, input, count);
+		input += count * block_size;
+		size -= count * block_size;
+	}
+
+	std::memcpy(this->buffer_, input, size);
+	this->buffered_ = size;
+}
+
+digest sha256_digester::value() const
+{
+	std::uint32_t state[8];
+	std::memcpy(state, this->state_, sizeof(state));
+
+	// Padding: 0x80, zeros, and the message length in bits, big endian
+	std::uint8_t tail[2 * block_size]{};
+	std::memcpy(tail, this->buffer_, this->buffered_);
+	tail[this->buffered_] = 0x80;
+	const auto tail_size  = this->buffered_ + 9u <= block_size ? block_size : 2u * block_size;
+	const auto bits       = this->total_ * 8u;
+	for (auto i = 0; i < 8; ++i)
+	{
+		tail[tail_size - 1u - i] = static_cast<std::uint8_t>(bits >> (8 * i));
+	}
+	this->compress(state, tail, tail_size / block_size);
+
+	auto result = digest{ digest_algorithm::SHA256, std::vector<std::uint8_t>(32u) };
+	for (auto i = 0; i < 32; ++i)
+	{
+		result.value[i] = static_cast<std::uint8_t>(state[i / 4] >> (24 - 8 * (i % 4)));
+	}
+	return result;
+}
+
+} // namespace flexfs
@@ -0,0 +1,37 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/digest.h"
+#include "flexfs/core/cpu_features.h"
+
+namespace flexfs {
+
+// SHA-256 with the SHA-NI extension, or portable C++.
+class sha256_digester final : public i_digester
+{
+public:
+	static constexpr std::size_t block_size = 64u;
+
+private:
+	bool          sha_;
+	std::uint32_t state_[8];
+	std::uint64_t total_;
+	std::size_t   buffered_;
+	std::uint8_t  buffer_[block_size];
+
+	void compress(std::uint32_t* state, const std::uint8_t* blocks, std::size_t count) const;
+
+public:
+	explicit sha256_digester(const cpu_features& cpu = cpu_features::get());
+
+	void   update(const void* data, std::size_t size) override;
+	digest value() const override;
+};
+
+} // namespace flexfs
@@ -12,6 +12,14 @@ namespace flexfs {
 source::source(const fspath& path)
     : orig_path{ path }
     , current_path{ path }
+    , mtime{}
+{
+}
+
+source::source(const fspath& path, std::optional<std::chrono::system_clock::time_point> mtime)
+    : orig_path{ path }
+    , current_path{ path }
+    , mtime{ mtime }
 {
 }
 
@@ -9,16 +9,21 @@
 
 #include "flexfs/core/api.h"
 #include "flexfs/core/fspath.h"
+#include <chrono>
+#include <optional>
 
 namespace flexfs {
 
 class FLEXFS_EXPORT source
 {
 public:
-	fspath orig_path;
-	fspath current_path; // Differs from `orig_path` after moving the file (see operations.h)
+	fspath                                               orig_path;
+	fspath                                               current_path; // Differs from `orig_path` after moving the file (see operations.h)
+	std::optional<std::chrono::system_clock::time_point> mtime;        // If known, e.g. from a direntry, used to expand the time
+	                                                                   // placeholders of a destination instead of a stat.
 
 	explicit source(const fspath& path);
+	explicit source(const fspath& path, std::optional<std::chrono::system_clock::time_point> mtime);
 };
 
 } // namespace flexfs
@@ -0,0 +1,355 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/sync_tree.h"
+#include "flexfs/core/attributes.h"
+#include "flexfs/core/direntry.h"
+#include "flexfs/core/digest.h"
+#include "flexfs/core/i_file.h"
+#include "flexfs/core/noop_interruptor.h"
+#include "flexfs/core/logging.h"
+#include "flexfs/core/formatters.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace flexfs {
+
+namespace {
+
+constexpr auto checksum_buffer_size = std::size_t{ 262144u };
+
+digest file_digest(i_access& access, const fspath& path)
+{
+	if (auto result = access.checksum(path, digest_algorithm::XXH3_64))
+	{
+		return std::move(result.value());
+	}
+
+	auto file     = access.open(path, O_RDONLY | O_BINARY, 0);
+	auto digester = make_digester(digest_algorithm::XXH3_64);
+	auto buf      = std::vector<char>(checksum_buffer_size);
+	for (auto nread = file->read(buf.data(), buf.size()); nread; nread = file->read(buf.data(), buf.size()))
+	{
+		digester->update(buf.data(), nread);
+	}
+	return digester->value();
+}
+
+// A directory to compare
+struct dir_pair
+{
+	fspath              source;
+	fspath              dest;
+	std::optional<bool> dest_exists; // not known yet for the top directory
+};
+
+// Lists the source and destination trees on a number of worker threads, and makes the plan.
+class tree_walk final
+{
+	const std::function<copy_worker_access()>& make_access_;
+	const sync_options&                        opts_;
+	std::shared_ptr<i_interruptor>             interruptor_;
+	std::mutex                                 mutex_;
+	std::condition_variable                    cv_;
+	std::deque<dir_pair>                       queue_;
+	std::size_t                                busy_; // number of workers comparing a directory
+	bool                                       stop_;
+	std::exception_ptr                         error_;
+	std::vector<sync_action>                   plan_;
+	std::vector<copy_worker_access>            accesses_; // of the workers, reused for the copies
+
+	std::optional<sync_action::reason> compare_file(copy_worker_access& access,
+	                                                const fspath&       source_path,
+	                                                const fspath&       dest_path,
+	                                                const attributes&   source_attr,
+	                                                const attributes*   dest_attr)
+	{
+		if (!dest_attr)
+		{
+			return sync_action::reason::MISSING;
+		}
+		else if (source_attr.size != dest_attr->size)
+		{
+			return sync_action::reason::SIZE;
+		}
+		else if (this->opts_.checksum)
+		{
+			if (file_digest(*access.source, source_path) != file_digest(*access.dest, dest_path))
+			{
+				return sync_action::reason::CHECKSUM;
+			}
+		}
+		else if (!source_attr.mtime || !dest_attr->mtime)
+		{
+			return sync_action::reason::MTIME;
+		}
+		else if (this->opts_.copy.copy.preserve_mtime)
+		{
+			if (std::chrono::floor<std::chrono::seconds>(source_attr.mtime.value()) !=
+			    std::chrono::floor<std::chrono::seconds>(dest_attr->mtime.value()))
+			{
+				return sync_action::reason::MTIME;
+			}
+		}
+		else if (source_attr.mtime.value() > dest_attr->mtime.value())
+		{
+			// An earlier copy got the time it was made
+			return sync_action::reason::MTIME;
+		}
+		return std::nullopt;
+	}
+
+	void conflict(const fspath& source_path, const fspath& dest_path)
+	{
+		fslog(warn, "skipping {}, {} is another type of entry", source_path, dest_path);
+		auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+		this->plan_.push_back(sync_action{ sync_action::kind::CONFLICT, sync_action::reason::TYPE, source_path, dest_path, std::nullopt });
+	}
+
+	void make_dir(copy_worker_access& access, const fspath& source_path, const fspath& dest_path, sync_action::reason why, bool parents)
+	{
+		{
+			auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+			this->plan_.push_back(sync_action{ sync_action::kind::MKDIR, why, source_path, dest_path, std::nullopt });
+		}
+		if (!this->opts_.dry_run)
+		{
+			access.dest->mkdir(dest_path, parents);
+		}
+	}
+
+	// Returns the subdirectories to compare next
+	std::vector<dir_pair> compare_dir(copy_worker_access& access, dir_pair dir)
+	{
+		if (!dir.dest_exists)
+		{
+			dir.dest_exists = access.dest->exists(dir.dest);
+			if (!dir.dest_exists.value())
+			{
+				this->make_dir(access, dir.source, dir.dest, sync_action::reason::MISSING, true);
+			}
+		}
+
+		auto dest_entries = std::unordered_map<std::string, attributes>{};
+		if (dir.dest_exists.value())
+		{
+			for (auto& entry : access.dest->ls(dir.dest))
+			{
+				dest_entries.emplace(std::move(entry.name), std::move(entry.attr));
+			}
+		}
+
+		auto subdirs = std::vector<dir_pair>{};
+		auto copies  = std::vector<sync_action>{};
+		for (const auto& entry : access.source->ls(dir.source))
+		{
+			if (entry.name == "." || entry.name == "..")
+			{
+				continue;
+			}
+
+			const auto source_path = dir.source / entry.name;
+			const auto dest_path   = dir.dest / entry.name;
+			const auto it          = dest_entries.find(entry.name);
+			const auto dest_attr   = it == dest_entries.end() ? nullptr : &it->second;
+
+			if (entry.attr.is_dir())
+			{
+				if (!dest_attr)
+				{
+					this->make_dir(access, source_path, dest_path, sync_action::reason::MISSING, false);
+				}
+				else if (!dest_attr->is_dir())
+				{
+					this->conflict(source_path, dest_path);
+					continue;
+				}
+				subdirs.push_back(dir_pair{ source_path, dest_path, dest_attr != nullptr });
+			}
+			else if (entry.attr.is_reg())
+			{
+				if (dest_attr && !dest_attr->is_reg())
+				{
+					this->conflict(source_path, dest_path);
+					continue;
+				}
+				if (const auto why = this->compare_file(access, source_path, dest_path, entry.attr, dest_attr))
+				{
+					copies.push_back(sync_action{ sync_action::kind::COPY, why.value(), source_path, dest_path, entry.attr.size });
+				}
+			}
+			else
+			{
+				fslog(debug, "skipping {}, not a regular file or directory", source_path);
+			}
+		}
+
+		auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+		this->plan_.insert(this->plan_.end(), copies.begin(), copies.end());
+		return subdirs;
+	}
+
+	void fail()
+	{
+		auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+		if (!this->error_)
+		{
+			this->error_ = std::current_exception();
+		}
+		this->stop_ = true;
+	}
+
+	void work()
+	{
+		auto access = copy_worker_access{};
+		try
+		{
+			access = this->make_access_();
+		}
+		catch (...)
+		{
+			this->fail();
+			this->cv_.notify_all();
+			return;
+		}
+
+		for (;;)
+		{
+			auto dir = dir_pair{};
+			{
+				auto lock = std::unique_lock<std::mutex>{ this->mutex_ };
+				this->cv_.wait(lock, [this] { return this->stop_ || !this->queue_.empty() || this->busy_ == 0u; });
+				if (this->stop_ || this->queue_.empty())
+				{
+					break;
+				}
+				dir = std::move(this->queue_.front());
+				this->queue_.pop_front();
+				++this->busy_;
+			}
+
+			try
+			{
+				this->interruptor_->throw_if_interrupted();
+				auto subdirs = this->compare_dir(access, std::move(dir));
+				auto lock    = std::lock_guard<std::mutex>{ this->mutex_ };
+				std::move(subdirs.begin(), subdirs.end(), std::back_inserter(this->queue_));
+			}
+			catch (...)
+			{
+				this->fail();
+			}
+
+			{
+				auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+				--this->busy_;
+			}
+			this->cv_.notify_all();
+		}
+
+		auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+		this->accesses_.push_back(std::move(access));
+	}
+
+public:
+	explicit tree_walk(const std::function<copy_worker_access()>& make_access,
+	                   const fspath&                              source_dir,
+	                   const fspath&                              dest_dir,
+	                   const sync_options&                        opts)
+	    : make_access_{ make_access }
+	    , opts_{ opts }
+	    , interruptor_{ opts.copy.copy.interruptor ? opts.copy.copy.interruptor : std::make_shared<noop_interruptor>() }
+	    , mutex_{}
+	    , cv_{}
+	    , queue_{ dir_pair{ source_dir, dest_dir, std::nullopt } }
+	    , busy_{}
+	    , stop_{}
+	    , error_{}
+	    , plan_{}
+	    , accesses_{}
+	{
+	}
+
+	// Returns the plan, sorted by destination path
+	std::vector<sync_action> run()
+	{
+		auto threads = std::vector<std::thread>{};
+		for (auto worker = std::size_t{}; worker < std::max(this->opts_.copy.workers, std::size_t{ 1u }); ++worker)
+		{
+			threads.emplace_back([this] { this->work(); });
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		if (this->error_)
+		{
+			std::rethrow_exception(this->error_);
+		}
+
+		auto&& by_dest_path = [](const sync_action& a, const sync_action& b) { return a.dest_path < b.dest_path; };
+		std::sort(this->plan_.begin(), this->plan_.end(), by_dest_path);
+		return std::move(this->plan_);
+	}
+
+	// Hands out the accesses of the walk before making new ones
+	copy_worker_access make_access()
+	{
+		{
+			auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+			if (!this->accesses_.empty())
+			{
+				auto result = std::move(this->accesses_.back());
+				this->accesses_.pop_back();
+				return result;
+			}
+		}
+		return this->make_access_();
+	}
+};
+
+} // namespace
+
+sync_result sync_tree(const std::function<copy_worker_access()>&      make_access,
+                      const fspath&                                   source_dir,
+                      const fspath&                                   dest_dir,
+                      const sync_options&                             opts,
+                      std::function<void(const copy_files_progress&)> on_progress)
+{
+	auto walk   = tree_walk{ make_access, source_dir, dest_dir, opts };
+	auto result = sync_result{ walk.run(), {} };
+	if (opts.dry_run)
+	{
+		return result;
+	}
+
+	auto jobs = std::vector<copy_job>{};
+	for (const auto& action : result.plan)
+	{
+		if (action.what == sync_action::kind::COPY)
+		{
+			jobs.push_back(copy_job{ source{ action.source_path },
+			                         destination{ action.dest_path, std::nullopt, false, destination::conflict_policy::OVERWRITE },
+			                         action.size });
+		}
+	}
+
+	if (!jobs.empty())
+	{
+		result.copies = copy_files([&] { return walk.make_access(); }, jobs, opts.copy, on_progress);
+	}
+	return result;
+}
+
+} // namespace flexfs
@@ -0,0 +1,79 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/fspath.h"
+#include "flexfs/core/copy_files.h"
+#include <functional>
+#include <optional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace flexfs {
+
+struct FLEXFS_EXPORT sync_options
+{
+	// Compare the contents of files of equal size, instead of their modification times.
+	bool checksum = false;
+
+	// Only make the plan, change nothing.
+	bool dry_run = false;
+
+	// copy.workers is used for listing the directories as well. The conflict policy of the copies is OVERWRITE.
+	// With copy.copy.preserve_mtime, a destination file is out of date when its modification time differs from
+	// that of the source file, to the second. Without, the copies get the time they were made, and a destination
+	// file is only out of date when the source file is newer.
+	copy_files_options copy;
+};
+
+struct FLEXFS_EXPORT sync_action
+{
+	enum class kind
+	{
+		MKDIR,
+		COPY,
+		CONFLICT // the destination is left alone, and a directory is not descended into
+	};
+
+	enum class reason
+	{
+		MISSING,  // the destination does not exist
+		TYPE,     // the destination is another type of entry, e.g. a file where the source is a directory
+		SIZE,     // the sizes differ
+		MTIME,    // the modification times differ, see sync_options::copy
+		CHECKSUM, // the contents differ
+	};
+
+	kind                         what;
+	reason                       why;
+	fspath                       source_path;
+	fspath                       dest_path;
+	std::optional<std::uint64_t> size; // of the source file
+};
+
+struct FLEXFS_EXPORT sync_result
+{
+	std::vector<sync_action>       plan;   // sorted by destination path
+	std::vector<copy_files_status> copies; // of the COPY actions, in plan order. Empty in a dry run.
+};
+
+/// Makes the tree at dest_dir up to date with the tree at source_dir.
+/// Both trees are walked in parallel, with the accesses made by make_access (see copy_files). Missing
+/// directories are created as they are found, then the changed regular files are copied with copy_files.
+/// Other file types are skipped. Nothing is removed from the destination: where it has another type of entry
+/// than the source, e.g. a file for a directory, a CONFLICT action is planned and the entry is left alone.
+/// Throws when a directory cannot be listed. Failed copies are reported in sync_result::copies.
+FLEXFS_EXPORT sync_result sync_tree(const std::function<copy_worker_access()>&      make_access,
+                                    const fspath&                                   source_dir,
+                                    const fspath&                                   dest_dir,
+                                    const sync_options&                             opts,
+                                    std::function<void(const copy_files_progress&)> on_progress = nullptr);
+
+} // namespace flexfs
@@ -0,0 +1,346 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/tee_copy.h"
+#include "flexfs/core/make_dest_path.h"
+#include "flexfs/core/file_digests.h"
+#include "flexfs/core/attributes.h"
+#include "flexfs/core/i_file.h"
+#include "flexfs/core/buffer_pool.h"
+#include "flexfs/core/noop_interruptor.h"
+#include "flexfs/core/logging.h"
+#include "flexfs/core/formatters.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <cassert>
+
+namespace flexfs {
+
+namespace {
+
+// Buffer sizes selected when copy_options::buffer_size is 0, as for copy_file.
+constexpr auto local_buffer_size  = std::size_t{ 1048576u };
+constexpr auto remote_buffer_size = std::size_t{ 262144u };
+
+struct chunk
+{
+	buffer_pool::lease buf;
+	std::size_t        size;
+};
+
+class tee final
+{
+	// The queue and the status of one destination are guarded by the mutex of the tee
+	struct lane
+	{
+		i_access&                                access;
+		fspath                                   path;
+		std::unique_ptr<i_file>                  out;
+		std::deque<std::shared_ptr<const chunk>> queue;
+		bool                                     failed;
+		copy_files_status                        status;
+	};
+
+	i_access&                                            source_access_;
+	const source&                                        source_;
+	const tee_copy_options&                              opts_;
+	const std::function<void(std::uint64_t bytes_read)>& on_progress_;
+	std::shared_ptr<i_interruptor>                       interruptor_;
+	std::vector<lane>                                    lanes_;
+	std::mutex                                           mutex_;
+	std::condition_variable                              cv_;
+	bool                                                 eof_;
+	std::exception_ptr                                   read_error_;
+	std::vector<digest>                                  digests_; // of the source data, once eof_ is set
+
+	void fail(lane& l)
+	{
+		{
+			auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+			l.failed  = true;
+			l.status  = copy_files_status{ std::nullopt, std::current_exception() };
+			l.queue.clear();
+		}
+		this->cv_.notify_all();
+	}
+
+	// Opens the destination files, on the calling thread since make_dest_path may need the source access
+	void open(const std::vector<tee_destination>& dests, const source& stated, mode_t mode)
+	{
+		for (const auto& d : dests)
+		{
+			auto& l = this->lanes_.emplace_back(lane{ *d.access, fspath{}, nullptr, {}, false, {} });
+			try
+			{
+				auto&& create = [&](const fspath& path) {
+					l.out = l.access.try_create(path, O_WRONLY | O_BINARY, mode);
+					return l.out != nullptr;
+				};
+				l.path = make_dest_path(this->source_access_, stated, l.access, d.dest, create);
+				if (!l.out)
+				{
+					l.out = l.access.open(l.path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, mode);
+				}
+			}
+			catch (...)
+			{
+				fslog(warn, "could not create {} for {}", d.dest.path, this->source_.current_path);
+				this->fail(l);
+			}
+		}
+	}
+
+	void write(lane& l, std::shared_ptr<buffer_pool> pool)
+	{
+		try
+		{
+			auto size = std::uint64_t{};
+			for (;;)
+			{
+				auto c = std::shared_ptr<const chunk>{};
+				{
+					auto lock = std::unique_lock<std::mutex>{ this->mutex_ };
+					this->cv_.wait(lock, [&] { return !l.queue.empty() || this->eof_ || this->read_error_; });
+					if (this->read_error_)
+					{
+						std::rethrow_exception(this->read_error_);
+					}
+					else if (l.queue.empty())
+					{
+						break;
+					}
+					c = std::move(l.queue.front());
+					l.queue.pop_front();
+				}
+				this->cv_.notify_all();
+
+				if (this->opts_.copy.rate_limit)
+				{
+					this->opts_.copy.rate_limit->acquire(c->size, *this->interruptor_);
+				}
+				auto ptr = c->buf.data();
+				for (auto count = c->size; count;)
+				{
+					const auto written = l.out->write(ptr, count);
+					assert(written <= count);
+					count -= written;
+					ptr += written;
+				}
+				size += c->size;
+			}
+			l.out.reset();
+
+			auto result = copy_result{ l.path, size, {}, 0u, 0u, false, false };
+			{
+				auto lock      = std::lock_guard<std::mutex>{ this->mutex_ };
+				result.digests = this->digests_;
+			}
+			if (this->opts_.copy.verify)
+			{
+				auto expected = result.digests;
+				if (this->opts_.copy.digests.empty())
+				{
+					// The digests of the source are those of both default algorithms, keep the one for this access
+					const auto algorithm = l.access.is_remote() ? digest_algorithm::SHA256 : digest_algorithm::CRC32C;
+					auto&& other         = [&](const digest& d) { return d.algorithm != algorithm; };
+					expected.erase(std::remove_if(expected.begin(), expected.end(), other), expected.end());
+					result.digests = expected;
+				}
+				verify_digests(l.access, l.path, O_RDONLY | O_BINARY, expected, *pool);
+			}
+
+			auto lock       = std::lock_guard<std::mutex>{ this->mutex_ };
+			l.status.result = std::move(result);
+		}
+		catch (...)
+		{
+			fslog(warn, "copy of {} to {} failed", this->source_.current_path, l.path);
+			this->fail(l);
+		}
+	}
+
+	// Reads the source and queues the data to every lane that has not failed. Returns false when all failed.
+	bool read(i_file& in, buffer_pool& pool, std::vector<std::unique_ptr<i_digester>>& digesters)
+	{
+		auto total = std::uint64_t{};
+		for (;;)
+		{
+			this->interruptor_->throw_if_interrupted();
+			auto       buf   = pool.acquire();
+			const auto nread = in.read(buf.data(), buf.size());
+			if (nread == 0u)
+			{
+				return true;
+			}
+			for (const auto& digester : digesters)
+			{
+				digester->update(buf.data(), nread);
+			}
+
+			const auto c    = std::make_shared<const chunk>(chunk{ std::move(buf), nread });
+			auto       live = false;
+			{
+				auto&& ready = [&] {
+					return std::all_of(this->lanes_.begin(), this->lanes_.end(), [&](const lane& l) {
+						return l.failed || l.queue.size() < this->opts_.queue_depth;
+					});
+				};
+				auto lock = std::unique_lock<std::mutex>{ this->mutex_ };
+				this->cv_.wait(lock, ready);
+				for (auto& l : this->lanes_)
+				{
+					if (!l.failed)
+					{
+						l.queue.push_back(c);
+						live = true;
+					}
+				}
+			}
+			this->cv_.notify_all();
+			if (!live)
+			{
+				return false;
+			}
+
+			total += nread;
+			if (this->on_progress_)
+			{
+				this->on_progress_(total);
+			}
+		}
+	}
+
+public:
+	explicit tee(i_access&                                            source_access,
+	             const source&                                        source,
+	             const tee_copy_options&                              opts,
+	             const std::function<void(std::uint64_t bytes_read)>& on_progress)
+	    : source_access_{ source_access }
+	    , source_{ source }
+	    , opts_{ opts }
+	    , on_progress_{ on_progress }
+	    , interruptor_{ opts.copy.interruptor ? opts.copy.interruptor : std::make_shared<noop_interruptor>() }
+	    , lanes_{}
+	    , mutex_{}
+	    , cv_{}
+	    , eof_{}
+	    , read_error_{}
+	    , digests_{}
+	{
+	}
+
+	std::vector<copy_files_status> run(const std::vector<tee_destination>& dests)
+	{
+		// The lanes are referred to by the writer threads, they must not move
+		this->lanes_.reserve(dests.size());
+
+		auto       in          = this->source_access_.open(this->source_.current_path, O_RDONLY | O_BINARY, 0);
+		const auto source_attr = this->source_access_.stat(this->source_.current_path);
+
+		// Spares make_dest_path a stat for the time placeholders of the destinations
+		auto stated  = this->source_;
+		stated.mtime = this->source_.mtime ? this->source_.mtime : source_attr.mtime;
+		this->open(dests, stated, source_attr.get_mode() & ~S_IFMT);
+
+		const auto dest_remote = std::any_of(dests.begin(), dests.end(), [](const tee_destination& d) { return d.access->is_remote(); });
+		const auto remote      = this->source_access_.is_remote() || dest_remote;
+
+		// A buffer is shared by the lanes until the slowest one wrote it. A lane that is queue_depth buffers
+		// behind holds at most queue_depth + 1 of them, plus the one being read.
+		auto pool = this->opts_.copy.pool;
+		if (!pool)
+		{
+			auto buffer_size = this->opts_.copy.buffer_size;
+			if (buffer_size == 0u)
+			{
+				buffer_size = remote ? remote_buffer_size : local_buffer_size;
+				if (source_attr.size)
+				{
+					// No need for a large buffer to copy a small file
+					const auto size = std::max<std::uint64_t>(source_attr.size.value(), buffer_pool::alignment);
+					buffer_size     = static_cast<std::size_t>(std::min<std::uint64_t>(buffer_size, size));
+				}
+			}
+			pool = std::make_shared<buffer_pool>(buffer_size, this->opts_.queue_depth + 2u);
+		}
+
+		auto algorithms = this->opts_.copy.digests;
+		if (this->opts_.copy.verify && algorithms.empty())
+		{
+			// Each destination verifies with the default algorithm of copy_file for its access
+			algorithms.push_back(digest_algorithm::CRC32C);
+			if (dest_remote)
+			{
+				algorithms.push_back(digest_algorithm::SHA256);
+			}
+		}
+		auto digesters = std::vector<std::unique_ptr<i_digester>>{};
+		for (const auto algorithm : algorithms)
+		{
+			digesters.push_back(make_digester(algorithm));
+		}
+
+		auto threads = std::vector<std::thread>{};
+		for (auto& l : this->lanes_)
+		{
+			if (!l.failed)
+			{
+				threads.emplace_back([this, &l, pool] { this->write(l, pool); });
+			}
+		}
+
+		try
+		{
+			if (!threads.empty() && this->read(*in, *pool, digesters))
+			{
+				auto lock = std::lock_guard<std::mutex>{ this->mutex_ };
+				for (const auto& digester : digesters)
+				{
+					this->digests_.push_back(digester->value());
+				}
+			}
+			auto lock  = std::lock_guard<std::mutex>{ this->mutex_ };
+			this->eof_ = true;
+		}
+		catch (...)
+		{
+			fslog(warn, "read of {} failed", this->source_.current_path);
+			auto lock         = std::lock_guard<std::mutex>{ this->mutex_ };
+			this->read_error_ = std::current_exception();
+		}
+		this->cv_.notify_all();
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		auto result = std::vector<copy_files_status>{};
+		for (auto& l : this->lanes_)
+		{
+			result.push_back(std::move(l.status));
+		}
+		return result;
+	}
+};
+
+} // namespace
+
+std::vector<copy_files_status> tee_copy(i_access&                                     source_access,
+                                        const source&                                 source,
+                                        const std::vector<tee_destination>&           dests,
+                                        const tee_copy_options&                       opts,
+                                        std::function<void(std::uint64_t bytes_read)> on_progress)
+{
+	return tee{ source_access, source, opts, on_progress }.run(dests);
+}
+
+} // namespace flexfs
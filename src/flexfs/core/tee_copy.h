@@ -0,0 +1,55 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/i_access.h"
+#include "flexfs/core/source.h"
+#include "flexfs/core/destination.h"
+#include "flexfs/core/copy_options.h"
+#include "flexfs/core/copy_files.h"
+#include <functional>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace flexfs {
+
+// Each destination is written on a thread of its own. A remote access cannot be used from two threads at the
+// same time, so give each remote destination its own session, and do not use the source access for one.
+struct FLEXFS_EXPORT tee_destination
+{
+	std::shared_ptr<i_access> access;
+	flexfs::destination       dest;
+};
+
+struct FLEXFS_EXPORT tee_copy_options
+{
+	std::size_t queue_depth = 4u; // buffers a destination can fall behind before the source waits for it
+
+	// For each destination. The digests are computed once, over the source data. The rate limiter takes the
+	// bytes written to each destination. The sparse, resume, delta, hard_link, skip_unchanged, preserve,
+	// durability, compression and direct_io options and the server side copies do not apply.
+	copy_options copy;
+};
+
+/// Copies one file to several destinations, reading the source once.
+/// The source is read on the calling thread into buffers that are queued to every destination. The reader
+/// waits while a queue is full, so the slowest destination sets the pace and the memory use is bounded.
+/// A destination that fails is dropped and the others continue. A read error fails all destinations that are
+/// still being written, as does an interruption of copy.interruptor.
+/// on_progress is called on the calling thread with the number of bytes read from the source.
+/// @return The status of each destination, in the order of dests.
+FLEXFS_EXPORT std::vector<copy_files_status> tee_copy(i_access&                                     source_access,
+                                                      const source&                                 source,
+                                                      const std::vector<tee_destination>&           dests,
+                                                      const tee_copy_options&                       opts,
+                                                      std::function<void(std::uint64_t bytes_read)> on_progress = nullptr);
+
+} // namespace flexfs
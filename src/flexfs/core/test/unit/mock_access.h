@@ -30,8 +30,18 @@ public:
 	MOCK_METHOD(void, remove, (const fspath& path), (override));
 	MOCK_METHOD(void, mkdir, (const fspath& path, bool parents), (override));
 	MOCK_METHOD(void, rename, (const fspath& oldpath, const fspath& newpath), (override));
+	MOCK_METHOD(bool, try_rename, (const fspath& oldpath, const fspath& newpath), (override));
+	MOCK_METHOD(bool, try_link, (const fspath& oldpath, const fspath& newpath), (override));
 	MOCK_METHOD(std::unique_ptr<i_file>, open, (const fspath& path, int flags, mode_t mode), (override));
+	MOCK_METHOD(std::unique_ptr<i_file>, try_create, (const fspath& path, int flags, mode_t mode), (override));
 	MOCK_METHOD(std::shared_ptr<i_watcher>, create_watcher, (const fspath& dir, int cancelfd), (override));
+	MOCK_METHOD(std::optional<digest>, checksum, (const fspath& path, digest_algorithm algorithm), (override));
+	MOCK_METHOD(void,
+	            set_metadata,
+	            (const fspath& path, std::optional<mode_t> perms, std::optional<std::chrono::system_clock::time_point> mtime),
+	            (override));
+	MOCK_METHOD(bool, sync_fs, (const fspath& path), (override));
+	MOCK_METHOD(std::optional<std::uint64_t>, disk_position, (const fspath& path, position_kind kind), (override));
 };
 
 // This regex search and replace patterns can help to convert declarations into MOCK_METHOD macro calls
@@ -20,6 +20,13 @@ public:
 
 	MOCK_METHOD(std::size_t, read, (void* buf, std::size_t count), (override));
 	MOCK_METHOD(std::size_t, write, (const void* buf, std::size_t count), (override));
+	MOCK_METHOD(std::uint64_t, seek, (std::uint64_t offset), (override));
+	MOCK_METHOD(void, truncate, (std::uint64_t size), (override));
+	MOCK_METHOD(std::optional<std::uint64_t>, seek_data, (std::uint64_t offset), (override));
+	MOCK_METHOD(std::uint64_t, seek_hole, (std::uint64_t offset), (override));
+	MOCK_METHOD(bool, allocate, (std::uint64_t size), (override));
+	MOCK_METHOD(bool, copy_from, (i_file & source, std::uint64_t offset, std::uint64_t count, std::uint64_t dest_offset), (override));
+	MOCK_METHOD(bool, sync, (bool wait), (override));
 };
 
 // This regex search and replace patterns can help to convert declarations into MOCK_METHOD macro calls
@@ -0,0 +1,61 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/buffer_pool.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <cstdint>
+
+namespace flexfs {
+
+TEST(BufferPoolTests, test_buffer_size)
+{
+	auto pool = buffer_pool{ 5000u, 1u };
+	EXPECT_EQ(pool.buffer_size(), 8192u);
+	EXPECT_EQ(pool.max_buffers(), 1u);
+	const auto buf = pool.acquire();
+	ASSERT_TRUE(buf);
+	EXPECT_EQ(buf.size(), 8192u);
+	EXPECT_EQ(reinterpret_cast<std::uintptr_t>(buf.data()) % buffer_pool::alignment, 0u);
+}
+
+TEST(BufferPoolTests, test_try_acquire)
+{
+	auto pool = buffer_pool{ 4096u, 2u };
+	auto b1   = pool.try_acquire();
+	auto b2   = pool.try_acquire();
+	EXPECT_TRUE(b1);
+	EXPECT_TRUE(b2);
+	EXPECT_NE(b1.data(), b2.data());
+	auto b3 = pool.try_acquire();
+	EXPECT_FALSE(b3);
+	EXPECT_EQ(b3.size(), 0u);
+
+	// Released buffers are reused
+	const auto data = b1.data();
+	b1              = buffer_pool::lease{};
+	b3              = pool.try_acquire();
+	EXPECT_TRUE(b3);
+	EXPECT_EQ(b3.data(), data);
+}
+
+TEST(BufferPoolTests, test_acquire_waits)
+{
+	auto   pool          = buffer_pool{ 4096u, 1u };
+	auto   b1            = pool.acquire();
+	auto&& release_later = [&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+		b1 = buffer_pool::lease{};
+	};
+	auto t  = std::thread{ release_later };
+	auto b2 = pool.acquire();
+	t.join();
+	EXPECT_TRUE(b2);
+	EXPECT_FALSE(b1);
+}
+
+} // namespace flexfs
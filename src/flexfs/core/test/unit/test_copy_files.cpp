@@ -0,0 +1,232 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "mock_access.h"
+#include "mock_file.h"
+#include "flexfs/core/copy_files.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace flexfs {
+
+namespace {
+
+// An access on which every file can be copied, and is empty
+std::shared_ptr<nice_mock_access> make_access()
+{
+	auto access = std::make_shared<nice_mock_access>();
+	ON_CALL(*access, try_stat(testing::_)).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(*access, stat(testing::_)).WillByDefault([](const fspath&) {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	});
+	ON_CALL(*access, open(testing::_, testing::_, testing::_)).WillByDefault([](const fspath&, int, mode_t) {
+		return std::make_unique<nice_mock_file>();
+	});
+	ON_CALL(*access, try_create(testing::_, testing::_, testing::_)).WillByDefault([](const fspath&, int, mode_t) {
+		return std::make_unique<nice_mock_file>();
+	});
+	return access;
+}
+
+copy_job make_job(const std::string& name, std::optional<std::uint64_t> size)
+{
+	return copy_job{ source{ "src/" + name }, destination{ "dst/" + name, std::nullopt, true, destination::conflict_policy::FAIL }, size };
+}
+
+} // namespace
+
+TEST(CopyFilesTests, test_schedule)
+{
+	const auto jobs = std::vector<copy_job>{ make_job("a", 10u), make_job("b", std::nullopt), make_job("c", 30u), make_job("d", 20u) };
+
+	auto&& run = [&](copy_files_options::order order) {
+		auto opts     = copy_files_options{};
+		opts.workers  = 1u;
+		opts.schedule = order;
+		auto done     = std::vector<std::size_t>{};
+		copy_files([] { return copy_worker_access{ make_access(), make_access() }; },
+		           jobs,
+		           opts,
+		           nullptr,
+		           [&](std::size_t job, const copy_files_status&) { done.push_back(job); });
+		return done;
+	};
+
+	EXPECT_EQ(run(copy_files_options::order::AS_GIVEN), (std::vector<std::size_t>{ 0u, 1u, 2u, 3u }));
+	EXPECT_EQ(run(copy_files_options::order::SMALLEST_FIRST), (std::vector<std::size_t>{ 1u, 0u, 3u, 2u }));
+	EXPECT_EQ(run(copy_files_options::order::LARGEST_FIRST), (std::vector<std::size_t>{ 2u, 3u, 0u, 1u }));
+}
+
+TEST(CopyFilesTests, test_schedule_by_position)
+{
+	const auto jobs = std::vector<copy_job>{ make_job("a", 10u), make_job("b", 10u), make_job("c", 10u), make_job("d", 10u) };
+
+	auto&& run = [&](copy_files_options::order order, bool extents) {
+		auto opts     = copy_files_options{};
+		opts.workers  = 1u;
+		opts.schedule = order;
+
+		// Extents in reverse order of the inodes, none for "b". Without extents, "c" cannot be located at all.
+		auto source_access = make_access();
+		ON_CALL(*source_access, disk_position(testing::_, testing::_))
+		    .WillByDefault([extents](const fspath& path, i_access::position_kind kind) -> std::optional<std::uint64_t> {
+			    const auto name = path.filename().string();
+			    if (kind == i_access::position_kind::EXTENT)
+			    {
+				    if (!extents || name == "b")
+				    {
+					    return std::nullopt;
+				    }
+				    return 1000u - static_cast<std::uint64_t>(name[0]);
+			    }
+			    if (name == "c")
+			    {
+				    throw std::runtime_error{ "no such file" };
+			    }
+			    return static_cast<std::uint64_t>(name[0]);
+		    });
+
+		// The access used for locating is reused by the worker
+		auto accesses = 0;
+		auto done     = std::vector<std::size_t>{};
+		copy_files(
+		    [&] {
+			    ++accesses;
+			    return copy_worker_access{ source_access, make_access() };
+		    },
+		    jobs,
+		    opts,
+		    nullptr,
+		    [&](std::size_t job, const copy_files_status&) { done.push_back(job); });
+		EXPECT_EQ(accesses, 1);
+		return done;
+	};
+
+	EXPECT_EQ(run(copy_files_options::order::INODE, true), (std::vector<std::size_t>{ 0u, 1u, 3u, 2u }));
+	EXPECT_EQ(run(copy_files_options::order::PHYSICAL, true), (std::vector<std::size_t>{ 3u, 2u, 0u, 1u }));
+	EXPECT_EQ(run(copy_files_options::order::PHYSICAL, false), (std::vector<std::size_t>{ 0u, 1u, 3u, 2u }));
+}
+
+TEST(CopyFilesTests, test_workers)
+{
+	auto jobs = std::vector<copy_job>{};
+	for (auto i = 0; i < 20; ++i)
+	{
+		jobs.push_back(make_job(std::to_string(i), 100u));
+	}
+
+	auto opts    = copy_files_options{};
+	opts.workers = 3u;
+
+	auto accesses = std::atomic<int>{};
+	auto last     = copy_files_progress{};
+
+	const auto statuses = copy_files(
+	    [&] {
+		    ++accesses;
+		    return copy_worker_access{ make_access(), make_access() };
+	    },
+	    jobs,
+	    opts,
+	    [&](const copy_files_progress& progress) { last = progress; });
+
+	EXPECT_EQ(accesses, 3);
+	ASSERT_EQ(statuses.size(), jobs.size());
+	for (auto i = std::size_t{}; i < jobs.size(); ++i)
+	{
+		ASSERT_TRUE(statuses[i].result);
+		EXPECT_FALSE(statuses[i].error);
+		EXPECT_EQ(statuses[i].result->dest_path, jobs[i].dest.path);
+	}
+	EXPECT_EQ(last.files_done, 20u);
+	EXPECT_EQ(last.files_total, 20u);
+	EXPECT_EQ(last.bytes_total, 2000u);
+}
+
+TEST(CopyFilesTests, test_failed_job)
+{
+	const auto jobs = std::vector<copy_job>{ make_job("a", std::nullopt), make_job("b", std::nullopt), make_job("c", std::nullopt) };
+
+	auto&& make_worker_access = [&] {
+		auto source_access = make_access();
+		EXPECT_CALL(*source_access, open(testing::_, testing::_, testing::_)).Times(testing::AnyNumber());
+		EXPECT_CALL(*source_access, open(testing::Eq(jobs[1].source.current_path), testing::_, testing::_))
+		    .WillOnce(testing::Throw(std::runtime_error{ "no such file" }));
+		return copy_worker_access{ source_access, make_access() };
+	};
+
+	auto opts    = copy_files_options{};
+	opts.workers = 1u;
+
+	const auto statuses = copy_files(make_worker_access, jobs, opts);
+	ASSERT_EQ(statuses.size(), 3u);
+	EXPECT_TRUE(statuses[0].result);
+	EXPECT_FALSE(statuses[1].result);
+	EXPECT_TRUE(statuses[1].error);
+	EXPECT_TRUE(statuses[2].result);
+}
+
+TEST(CopyFilesTests, test_batch_durability)
+{
+	const auto jobs = std::vector<copy_job>{ make_job("a", std::nullopt), make_job("b", std::nullopt) };
+
+	auto opts            = copy_files_options{};
+	opts.workers         = 1u;
+	opts.copy.durability = copy_options::durability_mode::BATCH;
+
+	// One flush for the destination directory, after the last copy
+	auto done = std::size_t{};
+	auto dest = make_access();
+	EXPECT_CALL(*dest, sync_fs(testing::Eq(fspath{ "dst" }))).WillOnce([&](const fspath&) {
+		EXPECT_EQ(done, 2u);
+		return true;
+	});
+
+	auto statuses = copy_files([&] { return copy_worker_access{ make_access(), dest }; },
+	                           jobs,
+	                           opts,
+	                           nullptr,
+	                           [&](std::size_t, const copy_files_status&) { ++done; });
+	ASSERT_EQ(statuses.size(), 2u);
+	EXPECT_TRUE(statuses[0].result);
+	EXPECT_TRUE(statuses[1].result);
+
+	// The copies are not durable when the flush fails
+	dest = make_access();
+	ON_CALL(*dest, sync_fs(testing::_)).WillByDefault(testing::Throw(std::runtime_error{ "I/O error" }));
+
+	statuses = copy_files([&] { return copy_worker_access{ make_access(), dest }; }, jobs, opts);
+	ASSERT_EQ(statuses.size(), 2u);
+	for (const auto& status : statuses)
+	{
+		EXPECT_FALSE(status.result);
+		EXPECT_TRUE(status.error);
+	}
+}
+
+TEST(CopyFilesTests, test_no_access)
+{
+	const auto jobs = std::vector<copy_job>{ make_job("a", std::nullopt), make_job("b", std::nullopt) };
+
+	auto&& make_worker_access = []() -> copy_worker_access { throw std::runtime_error{ "cannot connect" }; };
+
+	const auto statuses = copy_files(make_worker_access, jobs, copy_files_options{});
+	ASSERT_EQ(statuses.size(), 2u);
+	for (const auto& status : statuses)
+	{
+		EXPECT_FALSE(status.result);
+		ASSERT_TRUE(status.error);
+		EXPECT_THROW(std::rethrow_exception(status.error), std::runtime_error);
+	}
+}
+
+} // namespace flexfs
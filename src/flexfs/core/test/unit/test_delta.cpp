@@ -0,0 +1,225 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/delta.h"
+#include "flexfs/core/rolling_checksum.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace flexfs {
+
+namespace {
+
+// Read-only file in memory that returns at most 1000 bytes per read
+class memory_file final : public i_file
+{
+	const std::string& data_;
+	std::size_t        pos_;
+
+public:
+	explicit memory_file(const std::string& data)
+	    : data_{ data }
+	    , pos_{}
+	{
+	}
+
+	std::size_t read(void* buf, std::size_t count) override
+	{
+		const auto n = std::min({ count, this->data_.size() - this->pos_, std::size_t{ 1000u } });
+		std::memcpy(buf, this->data_.data() + this->pos_, n);
+		this->pos_ += n;
+		return n;
+	}
+
+	std::size_t write(const void* /*buf*/, std::size_t /*count*/) override
+	{
+		return 0u;
+	}
+
+	std::uint64_t seek(std::uint64_t offset) override
+	{
+		this->pos_ = static_cast<std::size_t>(offset);
+		return offset;
+	}
+
+	void truncate(std::uint64_t /*size*/) override
+	{
+	}
+
+	std::optional<std::uint64_t> seek_data(std::uint64_t offset) override
+	{
+		return offset;
+	}
+
+	std::uint64_t seek_hole(std::uint64_t /*offset*/) override
+	{
+		return this->data_.size();
+	}
+
+	bool allocate(std::uint64_t /*size*/) override
+	{
+		return false;
+	}
+
+	bool copy_from(i_file& /*source*/, std::uint64_t /*offset*/, std::uint64_t /*count*/, std::uint64_t /*dest_offset*/) override
+	{
+		return false;
+	}
+
+	bool sync(bool /*wait*/) override
+	{
+		return true;
+	}
+};
+
+std::string make_random_data(std::size_t size, unsigned seed)
+{
+	auto engine = std::mt19937{ seed };
+	auto result = std::string(size, '\0');
+	std::generate(result.begin(), result.end(), [&] { return static_cast<char>(engine() & 0xffu); });
+	return result;
+}
+
+struct delta_result
+{
+	std::string   rebuilt;   // the new file, rebuilt from the old file and the operations
+	std::string   data;      // passed to on_data
+	std::uint64_t literal{}; // number of literal bytes
+};
+
+delta_result apply_delta(const std::string& old_data, const std::string& new_data, std::size_t block_size)
+{
+	auto old_file = memory_file{ old_data };
+	auto new_file = memory_file{ new_data };
+
+	const auto signature = delta_signature::compute(old_file, block_size);
+
+	auto result = delta_result{};
+	compute_delta(
+	    new_file,
+	    signature,
+	    [&](const delta_op& op) {
+		    EXPECT_EQ(op.target, result.rebuilt.size());
+		    if (op.what == delta_op::kind::COPY)
+		    {
+			    EXPECT_EQ(old_data.substr(op.offset, op.length), std::string(op.data, op.length));
+			    result.rebuilt.append(old_data, op.offset, op.length);
+		    }
+		    else
+		    {
+			    result.rebuilt.append(op.data, op.length);
+			    result.literal += op.length;
+		    }
+	    },
+	    [&](const char* data, std::size_t size) { result.data.append(data, size); });
+	return result;
+}
+
+} // namespace
+
+TEST(DeltaTests, test_rolling_checksum_avx2)
+{
+	const auto data = make_random_data(1000u, 1u);
+	for (const auto size : { 0u, 1u, 31u, 32u, 33u, 64u, 100u, 999u })
+	{
+		EXPECT_EQ(rolling_checksum(data.data(), size).value(), rolling_checksum(data.data(), size, cpu_features{}).value())
+		    << "size " << size;
+	}
+}
+
+TEST(DeltaTests, test_rolling_checksum_roll)
+{
+	const auto data = make_random_data(500u, 2u);
+	const auto size = std::size_t{ 100u };
+	auto       sum  = rolling_checksum{ data.data(), size };
+	for (auto pos = std::size_t{ 1u }; pos + size <= data.size(); ++pos)
+	{
+		sum.roll(static_cast<std::uint8_t>(data[pos - 1u]), static_cast<std::uint8_t>(data[pos + size - 1u]));
+		ASSERT_EQ(sum.value(), rolling_checksum(data.data() + pos, size).value()) << "offset " << pos;
+	}
+}
+
+TEST(DeltaTests, test_block_size_for)
+{
+	EXPECT_EQ(delta_signature::block_size_for(0u), 1024u);
+	EXPECT_EQ(delta_signature::block_size_for(100000000u), 10048u);
+	EXPECT_EQ(delta_signature::block_size_for(std::uint64_t{ 1u } << 40), 131072u);
+}
+
+TEST(DeltaTests, test_signature)
+{
+	const auto data      = make_random_data(2500u, 3u);
+	auto       file      = memory_file{ data };
+	const auto signature = delta_signature::compute(file, 1024u);
+	EXPECT_EQ(signature.block_size, 1024u);
+	EXPECT_EQ(signature.file_size, 2500u);
+	ASSERT_EQ(signature.blocks.size(), 3u);
+	EXPECT_EQ(signature.blocks[2].weak, rolling_checksum(data.data() + 2048u, 452u).value());
+}
+
+TEST(DeltaTests, test_compute_delta_unchanged)
+{
+	const auto data = make_random_data(50000u, 4u);
+
+	auto old_file  = memory_file{ data };
+	auto new_file  = memory_file{ data };
+	auto ops       = std::vector<delta_op>{};
+	auto signature = delta_signature::compute(old_file, 1024u);
+	compute_delta(new_file, signature, [&](const delta_op& op) { ops.push_back(op); });
+
+	// A single copy per scan buffer
+	ASSERT_FALSE(ops.empty());
+	for (const auto& op : ops)
+	{
+		EXPECT_EQ(op.what, delta_op::kind::COPY);
+		EXPECT_EQ(op.offset, op.target);
+	}
+	EXPECT_LE(ops.size(), 4u);
+}
+
+TEST(DeltaTests, test_compute_delta_changes)
+{
+	const auto old_data = make_random_data(100000u, 5u);
+
+	auto new_data = old_data;
+	new_data.replace(20000u, 10u, "0123456789"); // overwrite
+	new_data.insert(50000u, "inserted data");    // shift everything after it
+	new_data.erase(70000u, 3000u);               // remove
+	new_data.append(make_random_data(700u, 6u)); // append
+
+	const auto result = apply_delta(old_data, new_data, 1024u);
+	EXPECT_EQ(result.rebuilt, new_data);
+	EXPECT_EQ(result.data, new_data);
+
+	// Only the blocks around the changes and the appended data are literal
+	EXPECT_LT(result.literal, 6u * 1024u + 700u);
+}
+
+TEST(DeltaTests, test_compute_delta_short_files)
+{
+	const auto old_data = make_random_data(3000u, 7u);
+
+	EXPECT_EQ(apply_delta(old_data, std::string{}, 1024u).rebuilt, std::string{});
+	EXPECT_EQ(apply_delta(old_data, old_data.substr(0u, 100u), 1024u).rebuilt, old_data.substr(0u, 100u));
+	EXPECT_EQ(apply_delta(std::string{}, old_data, 1024u).rebuilt, old_data);
+
+	// The short last block is found at another offset, also behind an unmatched window
+	const auto moved  = "x" + old_data.substr(2048u);
+	const auto result = apply_delta(old_data, moved, 1024u);
+	EXPECT_EQ(result.rebuilt, moved);
+	EXPECT_EQ(result.literal, 1u);
+
+	auto changed = old_data;
+	changed[1500u] ^= 1;
+	EXPECT_EQ(apply_delta(old_data, changed, 1024u).literal, 1024u);
+}
+
+} // namespace flexfs
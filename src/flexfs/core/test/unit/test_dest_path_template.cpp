@@ -0,0 +1,72 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/dest_path_template.h"
+#include "flexfs/core/exceptions.h"
+#include <gtest/gtest.h>
+#include <fmt/format.h>
+#include <fmt/chrono.h>
+#include <chrono>
+#include <string>
+
+namespace flexfs {
+
+namespace {
+
+// 2023-04-05 06:07:08 UTC
+const auto test_time = std::chrono::system_clock::from_time_t(1680674828);
+
+std::string render(const std::string& pattern)
+{
+	auto result = std::string{};
+	dest_path_template{ pattern }.render(test_time, false, result);
+	return result;
+}
+
+} // namespace
+
+TEST(DestPathTemplateTests, test_literal)
+{
+	EXPECT_EQ(render(""), "");
+	EXPECT_EQ(render("/path/to/file.txt"), "/path/to/file.txt");
+	EXPECT_EQ(render("a{{b}}c"), "a{b}c");
+}
+
+TEST(DestPathTemplateTests, test_placeholders)
+{
+	EXPECT_EQ(render("/backup/{:%Y-%m-%d}/{:%H%M%S}_file"), "/backup/2023-04-05/060708_file");
+	EXPECT_EQ(render("{0:%F %T}"), "2023-04-05 06:07:08");
+	EXPECT_EQ(render("{:%j}{{{:%y}}}"), "095{23}");
+}
+
+TEST(DestPathTemplateTests, test_same_as_fmt)
+{
+	// Also placeholders that are not plain strftime
+	const auto tm = fmt::gmtime(test_time);
+	for (const auto pattern : { "x_{:%Y%m%d}_y", "{:%b %a}", "{:>12%H:%M}", "{}", "{:%e%%}" })
+	{
+		EXPECT_EQ(render(pattern), fmt::format(fmt::runtime(pattern), tm)) << pattern;
+	}
+}
+
+TEST(DestPathTemplateTests, test_reuses_buffer)
+{
+	const auto t   = dest_path_template{ "{:%Y}" };
+	auto       out = std::string{ "previous contents" };
+	t.render(test_time, false, out);
+	EXPECT_EQ(out, "2023");
+	EXPECT_EQ(t.pattern(), "{:%Y}");
+}
+
+TEST(DestPathTemplateTests, test_invalid)
+{
+	EXPECT_THROW(dest_path_template{ "{:%Y" }, invalid_argument_exception);
+	EXPECT_THROW(dest_path_template{ "%Y}" }, invalid_argument_exception);
+	EXPECT_THROW(dest_path_template{ "{1:%Y}" }, invalid_argument_exception);
+}
+
+} // namespace flexfs
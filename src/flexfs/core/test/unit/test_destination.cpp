@@ -18,6 +18,7 @@ TEST(DestinationTests, test_ctor)
 		EXPECT_EQ(x.expand_time_placeholders, std::nullopt);
 		EXPECT_FALSE(x.create_parents);
 		EXPECT_EQ(x.on_name_conflict, destination::conflict_policy::OVERWRITE);
+		EXPECT_EQ(x.path_template, nullptr);
 	}
 	{
 		auto x = destination{ "/foo/bar", destination::time_expansion::UTC, true, destination::conflict_policy::FAIL };
@@ -25,7 +26,15 @@ TEST(DestinationTests, test_ctor)
 		EXPECT_EQ(x.expand_time_placeholders, destination::time_expansion::UTC);
 		EXPECT_TRUE(x.create_parents);
 		EXPECT_EQ(x.on_name_conflict, destination::conflict_policy::FAIL);
+		ASSERT_NE(x.path_template, nullptr);
+		EXPECT_EQ(x.path_template->pattern(), "/foo/bar");
 	}
 }
 
+TEST(DestinationTests, test_ctor_invalid_template)
+{
+	EXPECT_ANY_THROW(destination("/foo/{:%Y", destination::time_expansion::UTC, false, destination::conflict_policy::FAIL));
+	EXPECT_NO_THROW(destination("/foo/{:%Y", std::nullopt, false, destination::conflict_policy::FAIL));
+}
+
 } // namespace flexfs
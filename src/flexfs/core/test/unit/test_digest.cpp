@@ -0,0 +1,117 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/digest.h"
+#include "flexfs/core/crc32c.h"
+#include "flexfs/core/xxh3.h"
+#include "flexfs/core/sha256.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace flexfs {
+
+namespace {
+
+// Bytes (i * 31 + 7) & 0xff
+std::vector<std::uint8_t> make_data(std::size_t size)
+{
+	auto result = std::vector<std::uint8_t>(size);
+	for (auto i = std::size_t{}; i < size; ++i)
+	{
+		result[i] = static_cast<std::uint8_t>(i * 31u + 7u);
+	}
+	return result;
+}
+
+struct test_vector
+{
+	std::size_t size;
+	const char* crc32c;
+	const char* xxh3;
+	const char* sha256;
+};
+
+const test_vector test_vectors[] = {
+	{ 0, "00000000", "2d06800538d394c2", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+	{ 3, "765a7c83", "15f7093b173d005c", "647674a296197442f518bcca323ec605dd8d098b2d4f22ee1fdcdd2bb753a189" },
+	{ 100, "e26c441c", "8c97158042fbf926", "c22e490daa445fb2fba44278c022df135310fd278cabca4ad7919eddcccd1dce" },
+	{ 200, "80c9feb7", "12fdb864685f344d", "44cae5223d431caed4a9e32271d6abf17c3f2f4abac45fcdb48a99fcc6072a09" },
+	{ 1000, "ff52ee97", "989765d0ea7a5ecd", "5097e7d587352f5097062ae679f37bda5802d9f875aba14c8cb4d1a188ada179" },
+	{ 5000, "2b79d61e", "559fff92c2b7f8ee", "1e92fd98f113aba0a78e0830ca06e2775912370feab112dfc57bf3258b810595" },
+};
+
+// Feeds the data in chunks of the given size
+template<class Digester>
+std::string compute(const cpu_features& cpu, const std::vector<std::uint8_t>& data, std::size_t chunk)
+{
+	auto d = Digester{ cpu };
+	for (auto pos = std::size_t{}; pos < data.size(); pos += chunk)
+	{
+		d.update(data.data() + pos, std::min(chunk, data.size() - pos));
+	}
+	return d.value().to_string();
+}
+
+template<class Digester>
+void check(const char* test_vector::*expected)
+{
+	for (const auto& cpu : { cpu_features{}, cpu_features::get() })
+	{
+		for (const auto& tv : test_vectors)
+		{
+			const auto data = make_data(tv.size);
+			for (const auto chunk : { std::size_t{ 1u }, std::size_t{ 63u }, std::size_t{ 256u }, std::size_t{ 100000u } })
+			{
+				EXPECT_EQ(compute<Digester>(cpu, data, chunk), tv.*expected) << "size " << tv.size << ", chunk " << chunk;
+			}
+		}
+	}
+}
+
+} // namespace
+
+TEST(DigestTests, test_crc32c)
+{
+	check<crc32c_digester>(&test_vector::crc32c);
+
+	auto d = crc32c_digester{};
+	d.update("123456789", 9);
+	EXPECT_EQ(d.value().to_string(), "e3069283");
+}
+
+TEST(DigestTests, test_xxh3)
+{
+	check<xxh3_digester>(&test_vector::xxh3);
+}
+
+TEST(DigestTests, test_sha256)
+{
+	check<sha256_digester>(&test_vector::sha256);
+
+	auto d = sha256_digester{};
+	d.update("abc", 3);
+	EXPECT_EQ(d.value().to_string(), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST(DigestTests, test_make_digester)
+{
+	for (const auto algorithm : { digest_algorithm::CRC32C, digest_algorithm::XXH3_64, digest_algorithm::SHA256 })
+	{
+		const auto d = make_digester(algorithm);
+		ASSERT_NE(d, nullptr);
+		d->update("abc", 3);
+		const auto value = d->value();
+		EXPECT_EQ(value.algorithm, algorithm);
+		// More data can be added after taking the value
+		d->update("def", 3);
+		EXPECT_NE(d->value(), value);
+	}
+}
+
+} // namespace flexfs
@@ -0,0 +1,125 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "mock_file.h"
+#include "flexfs/core/gzip_writer.h"
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+
+namespace flexfs {
+
+namespace {
+
+// A destination file that keeps the data written to it in data
+std::unique_ptr<nice_mock_file> make_file(std::string& data)
+{
+	auto file = std::make_unique<nice_mock_file>();
+	ON_CALL(*file, write(testing::_, testing::_)).WillByDefault([&data](const void* buf, std::size_t count) {
+		data.append(static_cast<const char*>(buf), count);
+		return count;
+	});
+	return file;
+}
+
+std::string gunzip(const std::string& data)
+{
+	auto stream = z_stream{};
+	EXPECT_EQ(inflateInit2(&stream, 15 + 16), Z_OK);
+	stream.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	stream.avail_in = static_cast<uInt>(data.size());
+
+	auto result = std::string{};
+	auto buf    = std::string(65536u, '\0');
+	auto rc     = Z_OK;
+	while (rc == Z_OK)
+	{
+		stream.next_out  = reinterpret_cast<Bytef*>(buf.data());
+		stream.avail_out = static_cast<uInt>(buf.size());
+		rc               = inflate(&stream, Z_NO_FLUSH);
+		result.append(buf.data(), buf.size() - stream.avail_out);
+	}
+	EXPECT_EQ(rc, Z_STREAM_END);
+	inflateEnd(&stream);
+	return result;
+}
+
+std::string make_text(std::size_t size)
+{
+	auto result = std::string{};
+	for (auto line = 0u; result.size() < size; ++line)
+	{
+		result += "line " + std::to_string(line) + " of some text that compresses well\n";
+	}
+	result.resize(size);
+	return result;
+}
+
+} // namespace
+
+TEST(GzipWriterTests, test_compress)
+{
+	const auto text = make_text(1000000u);
+
+	for (const auto threaded : { false, true })
+	{
+		auto compressed = std::string{};
+		auto writer     = gzip_writer{ make_file(compressed), 6, threaded };
+
+		// Writes of any size, across the chunks that are handed over
+		for (auto pos = std::size_t{}, n = std::size_t{ 1u }; pos < text.size(); pos += n, n = n * 3u + 1u)
+		{
+			n = std::min(n, text.size() - pos);
+			EXPECT_EQ(writer.write(text.data() + pos, n), n);
+		}
+		EXPECT_EQ(writer.seek(text.size()), text.size());
+		EXPECT_ANY_THROW(writer.seek(0u));
+
+		const auto size = writer.finish();
+		EXPECT_EQ(size, compressed.size());
+		EXPECT_LT(size, text.size() / 4u);
+		EXPECT_EQ(writer.finish(), size);
+		EXPECT_EQ(gunzip(compressed), text);
+		EXPECT_ANY_THROW(writer.write("x", 1u));
+	}
+}
+
+TEST(GzipWriterTests, test_empty)
+{
+	auto compressed = std::string{};
+	auto writer     = gzip_writer{ make_file(compressed), 9, true };
+	EXPECT_GT(writer.finish(), 0u);
+	EXPECT_EQ(gunzip(compressed), std::string{});
+}
+
+TEST(GzipWriterTests, test_write_error)
+{
+	auto file = std::make_unique<nice_mock_file>();
+	ON_CALL(*file, write(testing::_, testing::_)).WillByDefault(testing::Throw(std::runtime_error{ "disk full" }));
+
+	// The error of the compression thread comes out of a later write, or out of finish
+	auto   writer = gzip_writer{ std::move(file), 1, true };
+	auto&& run    = [&] {
+		const auto text = make_text(4000000u);
+		writer.write(text.data(), text.size());
+		writer.finish();
+	};
+	EXPECT_THROW(run(), std::runtime_error);
+}
+
+TEST(GzipWriterTests, test_abandon)
+{
+	// Destroyed without finish, the compression thread stops
+	auto       compressed = std::string{};
+	auto       writer     = std::make_unique<gzip_writer>(make_file(compressed), 6, true);
+	const auto text       = make_text(2000000u);
+	writer->write(text.data(), text.size());
+	EXPECT_NO_THROW(writer.reset());
+}
+
+} // namespace flexfs
@@ -7,11 +7,31 @@
 
 #include "mock_access.h"
 #include "flexfs/core/make_dest_path.h"
+#include "flexfs/core/direntry.h"
 #include <gtest/gtest.h>
 #include <fmt/format.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace flexfs {
 
+namespace {
+
+std::vector<direntry> make_direntries(const std::vector<std::string>& names)
+{
+	auto result = std::vector<direntry>{};
+	for (const auto& name : names)
+	{
+		auto e = direntry{};
+		e.name = name;
+		result.push_back(e);
+	}
+	return result;
+}
+
+} // namespace
+
 TEST(MakeDestPathTests, test_dest_path_empty)
 {
 	auto       access = nice_mock_access{};
@@ -50,6 +70,20 @@ TEST(MakeDestPathTests, test_expand_time_placeholders_with_mtime_with_placeholde
 	EXPECT_EQ(make_dest_path(source_access, src, dest_access, dst), "destination_1970-01-01");
 }
 
+TEST(MakeDestPathTests, test_expand_time_placeholders_with_known_mtime)
+{
+	auto       source_access = nice_mock_access{};
+	auto       dest_access   = nice_mock_access{};
+	const auto src           = source{ "source", std::chrono::system_clock::from_time_t(86400) };
+	auto       dst = destination{ "destination_{:%Y-%m-%d}", destination::time_expansion::UTC, false, destination::conflict_policy::FAIL };
+	EXPECT_CALL(source_access, stat(testing::_)).Times(0);
+	EXPECT_EQ(make_dest_path(source_access, src, dest_access, dst), "destination_1970-01-02");
+
+	// The template is compiled again if the path is changed
+	dst.path = "other_{:%d}";
+	EXPECT_EQ(make_dest_path(source_access, src, dest_access, dst), "other_02");
+}
+
 TEST(MakeDestPathTests, test_expand_time_placeholders_without_mtime)
 {
 	auto       source_access = nice_mock_access{};
@@ -204,12 +238,10 @@ TEST(MakeDestPathTests, test_conflict_policy_autorename_without_extension)
 	auto sq = testing::InSequence{};
 	// "/path/to/bar" exists and is a file
 	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(make_attributes_lambda(attributes::filetype::FILE)));
-	// "/path/to/bar~1" exists
-	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path() / "bar~1"))).WillOnce(testing::Return(true));
-	// "/path/to/bar~2" exists
-	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path() / "bar~2"))).WillOnce(testing::Return(true));
-	// "/path/to/bar~3" does not exist
-	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path() / "bar~3"))).WillOnce(testing::Return(false));
+	// "/path/to/bar~1" and "/path/to/bar~2" exist, among other names
+	EXPECT_CALL(dest_access, ls(testing::Eq(dst.path.parent_path())))
+	    .WillOnce(testing::Return(make_direntries({ "bar", "bar~2", "bar~x", "bar~1", "bar~02", "baz~7" })));
+	EXPECT_CALL(dest_access, exists(testing::_)).Times(0);
 	EXPECT_EQ(make_dest_path(source_access, src, dest_access, dst), dst.path.parent_path() / "bar~3");
 }
 
@@ -227,15 +259,35 @@ TEST(MakeDestPathTests, test_conflict_policy_autorename_with_extension)
 	auto sq = testing::InSequence{};
 	// "/path/to/bar.baz" exists and is a file
 	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(make_attributes_lambda(attributes::filetype::FILE)));
-	// "/path/to/bar~1.baz" exists
-	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path() / "bar~1.baz"))).WillOnce(testing::Return(true));
-	// "/path/to/bar~2.baz" exists
-	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path() / "bar~2.baz"))).WillOnce(testing::Return(true));
-	// "/path/to/bar~3.baz" does not exist
-	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path() / "bar~3.baz"))).WillOnce(testing::Return(false));
+	// "/path/to/bar~1.baz" and "/path/to/bar~2.baz" exist, among other names
+	EXPECT_CALL(dest_access, ls(testing::Eq(dst.path.parent_path())))
+	    .WillOnce(testing::Return(make_direntries({ "bar.baz", "bar~2.baz", "bar~x.baz", "bar~1.baz", "bar~02.baz", "baz~7.baz" })));
+	EXPECT_CALL(dest_access, exists(testing::_)).Times(0);
 	EXPECT_EQ(make_dest_path(source_access, src, dest_access, dst), dst.path.parent_path() / "bar~3.baz");
 }
 
+TEST(MakeDestPathTests, test_conflict_policy_autorename_remote)
+{
+	auto       source_access = nice_mock_access{};
+	auto       dest_access   = nice_mock_access{};
+	const auto src           = source{ "/foo/bar" };
+	const auto dst           = destination{ "/path/to/bar.baz", std::nullopt, false, destination::conflict_policy::AUTORENAME };
+	auto       attr          = attributes{};
+	attr.type                = attributes::filetype::FILE;
+	// "/path/to/bar.baz" and "/path/to/bar~1.baz" up to "/path/to/bar~5000.baz" exist
+	ON_CALL(dest_access, is_remote()).WillByDefault(testing::Return(true));
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(attr));
+	EXPECT_CALL(dest_access, ls(testing::_)).Times(0);
+	auto probes = 0;
+	EXPECT_CALL(dest_access, exists(testing::_)).WillRepeatedly([&](const fspath& path) {
+		++probes;
+		const auto name = path.filename().string();
+		return std::stoi(name.substr(4u, name.size() - 8u)) <= 5000;
+	});
+	EXPECT_EQ(make_dest_path(source_access, src, dest_access, dst), dst.path.parent_path() / "bar~5001.baz");
+	EXPECT_LE(probes, 30);
+}
+
 TEST(MakeDestPathTests, test_conflict_policy_fail)
 {
 	auto       source_access          = nice_mock_access{};
@@ -252,4 +304,72 @@ TEST(MakeDestPathTests, test_conflict_policy_fail)
 	EXPECT_ANY_THROW(make_dest_path(source_access, src, dest_access, dst));
 }
 
+TEST(MakeDestPathTests, test_conflict_policy_autorename_atomic)
+{
+	auto       source_access = nice_mock_access{};
+	auto       dest_access   = nice_mock_access{};
+	const auto src           = source{ "/foo/bar" };
+	const auto dst           = destination{ "/path/to/bar.baz", std::nullopt, false, destination::conflict_policy::AUTORENAME };
+	// "/path/to/bar.baz" does not exist when checked, but it and "/path/to/bar~1.baz" are created before we get to
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path()))).WillOnce(testing::Return(true));
+	auto created = std::vector<fspath>{};
+	auto create  = [&](const fspath& path) {
+        created.push_back(path);
+        return created.size() == 3u;
+	};
+	EXPECT_EQ(make_dest_path(source_access, src, dest_access, dst, create), dst.path.parent_path() / "bar~2.baz");
+	EXPECT_EQ(created, (std::vector<fspath>{ dst.path, dst.path.parent_path() / "bar~1.baz", dst.path.parent_path() / "bar~2.baz" }));
+}
+
+TEST(MakeDestPathTests, test_conflict_policy_fail_atomic)
+{
+	auto       source_access = nice_mock_access{};
+	auto       dest_access   = nice_mock_access{};
+	const auto src           = source{ "/foo/bar" };
+	const auto dst           = destination{ "/path/to/bar", std::nullopt, false, destination::conflict_policy::FAIL };
+	// "/path/to/bar" is created after it was checked
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path()))).WillOnce(testing::Return(true));
+	EXPECT_ANY_THROW(make_dest_path(source_access, src, dest_access, dst, [](const fspath&) { return false; }));
+}
+
+TEST(MakeDestPathTests, test_conflict_policy_overwrite_atomic)
+{
+	auto       source_access = nice_mock_access{};
+	auto       dest_access   = nice_mock_access{};
+	const auto src           = source{ "/foo/bar" };
+	const auto dst           = destination{ "/path/to/bar", std::nullopt, false, destination::conflict_policy::OVERWRITE };
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path()))).WillOnce(testing::Return(true));
+	// Nothing is created, the caller replaces the file
+	EXPECT_EQ(make_dest_path(source_access, src, dest_access, dst, [](const fspath&) -> bool { throw std::logic_error{ "unexpected" }; }),
+	          dst.path);
+}
+
+TEST(MakeDestPathTests, test_parent_exists)
+{
+	auto       source_access = nice_mock_access{};
+	auto       dest_access   = nice_mock_access{};
+	const auto src           = source{ "/foo/bar" };
+	const auto dst           = destination{ "/path/to/bar", std::nullopt, false, destination::conflict_policy::FAIL };
+	// "/path/to/bar" does not exist, "/path/to" does
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path()))).WillOnce(testing::Return(true));
+	EXPECT_CALL(dest_access, mkdir(testing::_, testing::_)).Times(0);
+	EXPECT_EQ(make_dest_path(source_access, src, dest_access, dst), dst.path);
+}
+
+TEST(MakeDestPathTests, test_parent_missing)
+{
+	auto       source_access = nice_mock_access{};
+	auto       dest_access   = nice_mock_access{};
+	const auto src           = source{ "/foo/bar" };
+	const auto dst           = destination{ "/path/to/bar", std::nullopt, false, destination::conflict_policy::FAIL };
+	// Neither "/path/to/bar" nor "/path/to" exist
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, exists(testing::Eq(dst.path.parent_path()))).WillOnce(testing::Return(false));
+	EXPECT_ANY_THROW(make_dest_path(source_access, src, dest_access, dst));
+}
+
 } // namespace flexfs
@@ -8,8 +8,14 @@
 #include "mock_access.h"
 #include "mock_file.h"
 #include "flexfs/core/operations.h"
+#include "flexfs/core/exceptions.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace flexfs {
 
@@ -21,10 +27,151 @@ TEST(OperationsTests, test_move_file)
 	// "destination" does not exist
 	// This expected call is done by make_dest_path
 	EXPECT_CALL(access, try_stat(testing::Eq(dst.path))).Times(1).WillOnce(testing::Return(std::nullopt));
+	// The FAIL policy does not allow replacing it
+	EXPECT_CALL(access, try_rename(testing::Eq(src.current_path), testing::Eq(dst.path))).Times(1).WillOnce(testing::Return(true));
+	EXPECT_CALL(access, rename(testing::_, testing::_)).Times(0);
+	move_file(access, src, dst);
+	EXPECT_EQ(src.orig_path, fspath{ "source" });
+	EXPECT_EQ(src.current_path, fspath{ "destination" });
+}
+
+TEST(OperationsTests, test_move_file_autorename_collision)
+{
+	auto       access = nice_mock_access{};
+	auto       src    = source{ "source" };
+	const auto dst    = destination{ "destination", std::nullopt, false, destination::conflict_policy::AUTORENAME };
+	auto       sq     = testing::InSequence{};
+	// "destination" does not exist yet, but is created before the rename
+	EXPECT_CALL(access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(access, try_rename(testing::Eq(src.current_path), testing::Eq(dst.path))).WillOnce(testing::Return(false));
+	EXPECT_CALL(access, try_rename(testing::Eq(src.current_path), testing::Eq(fspath{ "destination~1" }))).WillOnce(testing::Return(true));
+	move_file(access, src, dst);
+	EXPECT_EQ(src.current_path, fspath{ "destination~1" });
+}
+
+TEST(OperationsTests, test_move_file_overwrite)
+{
+	auto       access = nice_mock_access{};
+	auto       src    = source{ "source" };
+	const auto dst    = destination{ "destination", std::nullopt, false, destination::conflict_policy::OVERWRITE };
+	EXPECT_CALL(access, try_rename(testing::_, testing::_)).Times(0);
 	EXPECT_CALL(access, rename(testing::Eq(src.current_path), testing::Eq(dst.path))).Times(1);
 	move_file(access, src, dst);
+	EXPECT_EQ(src.current_path, fspath{ "destination" });
+}
+
+TEST(OperationsTests, test_move_file_cross_device)
+{
+	auto       access = nice_mock_access{};
+	auto       src    = source{ "source" };
+	const auto dst    = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+	attr.size = 1000u;
+
+	auto crc32c = make_digester(digest_algorithm::CRC32C);
+	crc32c->update("abc", 3);
+
+	// The rename fails with EXDEV, the file is copied, verified and removed
+	ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+	EXPECT_CALL(access, try_rename(testing::Eq(src.current_path), testing::Eq(dst.path)))
+	    .WillOnce(testing::Throw(system_exception{ std::make_error_code(std::errc::cross_device_link) }));
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+	EXPECT_CALL(dest_file_ref, copy_from(testing::Ref(source_file_ref), 0u, 1000u, 0u)).WillOnce(testing::Return(true));
+	EXPECT_CALL(access, checksum(testing::Eq(src.current_path), digest_algorithm::CRC32C)).WillOnce(testing::Return(crc32c->value()));
+	EXPECT_CALL(access, checksum(testing::Eq(dst.path), digest_algorithm::CRC32C)).WillOnce(testing::Return(crc32c->value()));
+	EXPECT_CALL(access, remove(testing::Eq(src.current_path))).Times(1);
+
+	const auto result = move_file(access, src, access, dst);
+	EXPECT_EQ(result.dest_path, dst.path);
+	EXPECT_EQ(result.size, 1000u);
 	EXPECT_EQ(src.orig_path, fspath{ "source" });
 	EXPECT_EQ(src.current_path, fspath{ "destination" });
+
+	// Other errors are not handled
+	src = source{ "source" };
+	EXPECT_CALL(access, try_rename(testing::Eq(src.current_path), testing::Eq(dst.path)))
+	    .WillOnce(testing::Throw(system_exception{ std::make_error_code(std::errc::permission_denied) }));
+	EXPECT_CALL(access, open(testing::_, testing::_, testing::_)).Times(0);
+	EXPECT_THROW(move_file(access, src, access, dst), system_exception);
+	EXPECT_EQ(src.current_path, fspath{ "source" });
+}
+
+TEST(OperationsTests, test_move_file_linked)
+{
+	auto       access = nice_mock_access{};
+	auto       src    = source{ "source" };
+	const auto dst    = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+	attr.size = 1000u;
+
+	auto opts      = copy_options{};
+	opts.hard_link = true;
+
+	// A link shares the data with the source file, there is nothing to check before removing the source
+	ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+	EXPECT_CALL(access, try_rename(testing::Eq(src.current_path), testing::Eq(dst.path)))
+	    .WillOnce(testing::Throw(system_exception{ std::make_error_code(std::errc::cross_device_link) }));
+	EXPECT_CALL(access, try_link(testing::Eq(src.current_path), testing::Eq(dst.path))).WillOnce(testing::Return(true));
+	EXPECT_CALL(access, checksum(testing::_, testing::_)).Times(0);
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::make_unique<nice_mock_file>())));
+	EXPECT_CALL(access, open(testing::Eq(dst.path), testing::_, testing::_)).Times(0);
+	EXPECT_CALL(access, remove(testing::Eq(src.current_path))).Times(1);
+
+	const auto result = move_file(access, src, access, dst, opts);
+	EXPECT_TRUE(result.linked);
+	EXPECT_EQ(src.current_path, dst.path);
+}
+
+TEST(OperationsTests, test_move_file_across_accesses)
+{
+	auto       source_access = nice_mock_access{};
+	auto       dest_access   = nice_mock_access{};
+	auto       src           = source{ "source" };
+	const auto dst           = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+	attr.size = 3u;
+
+	auto sha256 = make_digester(digest_algorithm::SHA256);
+	sha256->update("abc", 3);
+	auto other = make_digester(digest_algorithm::SHA256);
+	other->update("abd", 3);
+
+	// No rename between accesses. The copy does not match the source, which is kept.
+	ON_CALL(dest_access, is_remote()).WillByDefault(testing::Return(true));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+	ON_CALL(*source_file, read(testing::_, testing::_)).WillByDefault(testing::Return(0));
+	EXPECT_CALL(source_access, try_rename(testing::_, testing::_)).Times(0);
+	EXPECT_CALL(dest_access, try_rename(testing::_, testing::_)).Times(0);
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+	EXPECT_CALL(source_access, checksum(testing::Eq(src.current_path), digest_algorithm::SHA256))
+	    .WillOnce(testing::Return(sha256->value()));
+	EXPECT_CALL(dest_access, checksum(testing::Eq(dst.path), digest_algorithm::SHA256)).WillOnce(testing::Return(other->value()));
+	EXPECT_CALL(source_access, remove(testing::_)).Times(0);
+
+	EXPECT_THROW(move_file(source_access, src, dest_access, dst), exception);
+	EXPECT_EQ(src.current_path, fspath{ "source" });
 }
 
 MATCHER_P2(BufferEq, expected, size, "")
@@ -60,11 +207,11 @@ TEST(OperationsTests, test_copy_file)
 	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
 	    .Times(1)
 	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(source_access, stat(testing::Eq(src.current_path))).Times(1).WillOnce(testing::Return(make_attributes_lambda()));
 	// "destination" does not exist
-	// This expected call is done by make_dest_path
+	// These expected calls are done by make_dest_path
 	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).Times(1).WillOnce(testing::Return(std::nullopt));
-	EXPECT_CALL(source_access, stat(testing::Eq(src.current_path))).Times(1).WillOnce(testing::Return(make_attributes_lambda()));
-	EXPECT_CALL(dest_access, open(testing::Eq(dst.path), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0664))
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
 	    .Times(1)
 	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
 
@@ -96,4 +243,1527 @@ TEST(OperationsTests, test_copy_file)
 	EXPECT_EQ(copy_file(source_access, src, dest_access, dst, nullptr), dst.path);
 }
 
+TEST(OperationsTests, test_copy_file_created_meanwhile)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto a = attributes{};
+	a.set_mode(S_IFREG | 0664);
+
+	// "destination" does not exist when checked, but cannot be created
+	ON_CALL(source_access, open(testing::_, testing::_, testing::_)).WillByDefault([](const fspath&, int, mode_t) {
+		return std::make_unique<nice_mock_file>();
+	});
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(a));
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(nullptr)));
+	EXPECT_CALL(dest_access, open(testing::_, testing::_, testing::_)).Times(0);
+
+	EXPECT_THROW(copy_file(source_access, src, dest_access, dst, nullptr), system_exception);
+}
+
+TEST(OperationsTests, test_copy_file_direct_io)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts      = copy_options{};
+	opts.direct_io = true;
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	};
+
+	ON_CALL(source_access, is_remote()).WillByDefault(testing::Return(false));
+	ON_CALL(dest_access, is_remote()).WillByDefault(testing::Return(false));
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY | O_DIRECT, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY | O_DIRECT, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	// The transfer buffer must be suitably aligned for direct I/O
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_))
+	    .WillOnce(testing::DoAll(
+	        [](void* buf, std::size_t count) {
+		        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(buf) % 4096u, 0u);
+		        EXPECT_EQ(count % 4096u, 0u);
+	        },
+	        testing::Return(0)));
+
+	EXPECT_EQ(copy_file(source_access, src, dest_access, dst, opts, nullptr).dest_path, dst.path);
+}
+
+TEST(OperationsTests, test_copy_file_direct_io_remote)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts      = copy_options{};
+	opts.direct_io = true;
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	};
+
+	// Direct I/O does not apply to remote files
+	ON_CALL(source_access, is_remote()).WillByDefault(testing::Return(true));
+	ON_CALL(dest_access, is_remote()).WillByDefault(testing::Return(true));
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	EXPECT_EQ(copy_file(source_access, src, dest_access, dst, opts, nullptr).dest_path, dst.path);
+}
+
+TEST(OperationsTests, test_copy_file_preallocate)
+{
+	auto sq = testing::InSequence{};
+
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+
+	// The source file shrinks while it is being copied
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size = 8192u;
+		return a;
+	};
+
+	const auto block_size = std::size_t{ 4096u };
+	char       block[block_size];
+	std::memset(block, 'x', block_size);
+
+	auto opts        = copy_options{};
+	opts.preallocate = true;
+
+	ON_CALL(dest_access, is_remote()).WillByDefault(testing::Return(false));
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(source_access, stat(testing::Eq(src.current_path))).WillOnce(testing::Return(make_attributes_lambda()));
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	EXPECT_CALL(dest_file_ref, allocate(8192u)).WillOnce(testing::Return(true));
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_)).WillOnce([&](void* buf, std::size_t) {
+		std::memcpy(buf, block, block_size);
+		return block_size;
+	});
+	EXPECT_CALL(dest_file_ref, write(BufferEq(block, block_size), block_size)).WillOnce(testing::Return(block_size));
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_)).WillOnce(testing::Return(0));
+	EXPECT_CALL(dest_file_ref, truncate(block_size));
+
+	EXPECT_EQ(copy_file(source_access, src, dest_access, dst, opts, nullptr).dest_path, dst.path);
+}
+
+TEST(OperationsTests, test_copy_file_preallocate_abort)
+{
+	auto sq = testing::InSequence{};
+
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size = 8192u;
+		return a;
+	};
+
+	auto opts        = copy_options{};
+	opts.preallocate = true;
+
+	ON_CALL(dest_access, is_remote()).WillByDefault(testing::Return(false));
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(source_access, stat(testing::Eq(src.current_path))).WillOnce(testing::Return(make_attributes_lambda()));
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	// Nothing was written when the copy fails, so the preallocated space must be released entirely
+	EXPECT_CALL(dest_file_ref, allocate(8192u)).WillOnce(testing::Return(true));
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_)).WillOnce(testing::Throw(std::runtime_error{ "read error" }));
+	EXPECT_CALL(dest_file_ref, truncate(0u));
+
+	EXPECT_THROW(copy_file(source_access, src, dest_access, dst, opts, nullptr), std::runtime_error);
+}
+
+TEST(OperationsTests, test_copy_file_read_ahead)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	constexpr auto block_size = std::size_t{ 4096u };
+
+	auto opts         = copy_options{};
+	opts.buffer_size  = block_size;
+	opts.buffer_count = 3u;
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	};
+
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	// The source file is read on another thread, only the order of the reads and the order of the writes
+	// are known.
+	char blocks[5][block_size];
+	for (auto i = 0; i < 5; ++i)
+	{
+		std::memset(blocks[i], 'a' + i, block_size);
+	}
+
+	auto reads  = testing::Sequence{};
+	auto writes = testing::Sequence{};
+	for (auto i = 0; i < 5; ++i)
+	{
+		EXPECT_CALL(source_file_ref, read(testing::NotNull(), block_size)).InSequence(reads).WillOnce([&blocks, i](void* buf, std::size_t) {
+			std::memcpy(buf, blocks[i], block_size);
+			return block_size;
+		});
+		EXPECT_CALL(dest_file_ref, write(BufferEq(blocks[i], block_size), block_size))
+		    .InSequence(writes)
+		    .WillOnce(testing::Return(block_size));
+	}
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), block_size)).InSequence(reads).WillOnce(testing::Return(0));
+
+	auto progress = std::vector<std::uint64_t>{};
+	EXPECT_EQ(copy_file(source_access, src, dest_access, dst, opts, [&](std::uint64_t n) { progress.push_back(n); }).dest_path, dst.path);
+	EXPECT_EQ(progress, (std::vector<std::uint64_t>{ 4096u, 8192u, 12288u, 16384u, 20480u }));
+}
+
+TEST(OperationsTests, test_copy_file_read_error)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts         = copy_options{};
+	opts.buffer_count = 2u;
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	};
+
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	// The data read before the error is written, then the error is raised on the calling thread
+	auto sq = testing::Sequence{};
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_)).InSequence(sq).WillOnce(testing::ReturnArg<1>());
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_))
+	    .InSequence(sq)
+	    .WillOnce(testing::Throw(std::runtime_error{ "read error" }));
+	EXPECT_CALL(dest_file_ref, write(testing::NotNull(), testing::_)).WillOnce(testing::ReturnArg<1>());
+
+	EXPECT_THROW(copy_file(source_access, src, dest_access, dst, opts, nullptr), std::runtime_error);
+}
+
+TEST(OperationsTests, test_copy_file_buffer_pool)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	// The pool has one buffer in use elsewhere, so this copy must do with the other one
+	auto opts         = copy_options{};
+	opts.pool         = std::make_shared<buffer_pool>(8192u, 2u);
+	opts.buffer_count = 2u;
+	const auto used   = opts.pool->acquire();
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size = 1000000u;
+		return a;
+	};
+
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), 8192u)).WillOnce(testing::Return(0));
+
+	EXPECT_EQ(copy_file(source_access, src, dest_access, dst, opts, nullptr).dest_path, dst.path);
+}
+
+TEST(OperationsTests, test_copy_file_digests)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts    = copy_options{};
+	opts.digests = { digest_algorithm::CRC32C, digest_algorithm::SHA256 };
+	opts.verify  = true;
+
+	auto source_file   = std::make_unique<nice_mock_file>();
+	auto dest_file     = std::make_unique<nice_mock_file>();
+	auto readback_file = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref   = *source_file;
+	auto& dest_file_ref     = *dest_file;
+	auto& readback_file_ref = *readback_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	};
+
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(dst.path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(readback_file))));
+
+	auto&& read_abc = [](void* buf, std::size_t) {
+		std::memcpy(buf, "abc", 3);
+		return std::size_t{ 3u };
+	};
+
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_)).WillOnce(read_abc).WillOnce(testing::Return(0));
+	EXPECT_CALL(dest_file_ref, write(BufferEq("abc", 3), 3)).WillOnce(testing::Return(3));
+	EXPECT_CALL(readback_file_ref, read(testing::NotNull(), testing::_)).WillOnce(read_abc).WillOnce(testing::Return(0));
+
+	const auto result = copy_file(source_access, src, dest_access, dst, opts, nullptr);
+	EXPECT_EQ(result.dest_path, dst.path);
+	EXPECT_EQ(result.size, 3u);
+	ASSERT_EQ(result.digests.size(), 2u);
+	EXPECT_EQ(result.digests[0].algorithm, digest_algorithm::CRC32C);
+	EXPECT_EQ(result.digests[0].to_string(), "364b3fb7");
+	EXPECT_EQ(result.digests[1].algorithm, digest_algorithm::SHA256);
+	EXPECT_EQ(result.digests[1].to_string(), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST(OperationsTests, test_copy_file_verify_mismatch)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts   = copy_options{};
+	opts.verify = true;
+
+	auto source_file   = std::make_unique<nice_mock_file>();
+	auto dest_file     = std::make_unique<nice_mock_file>();
+	auto readback_file = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref   = *source_file;
+	auto& readback_file_ref = *readback_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	};
+
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+	ON_CALL(*dest_file, write(testing::_, testing::_)).WillByDefault(testing::ReturnArg<1>());
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(dst.path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(readback_file))));
+
+	// The destination file reads back different data
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_))
+	    .WillOnce([](void* buf, std::size_t) {
+		    std::memcpy(buf, "abc", 3);
+		    return std::size_t{ 3u };
+	    })
+	    .WillOnce(testing::Return(0));
+	EXPECT_CALL(readback_file_ref, read(testing::NotNull(), testing::_))
+	    .WillOnce([](void* buf, std::size_t) {
+		    std::memcpy(buf, "abd", 3);
+		    return std::size_t{ 3u };
+	    })
+	    .WillOnce(testing::Return(0));
+
+	EXPECT_THROW(copy_file(source_access, src, dest_access, dst, opts, nullptr), flexfs::exception);
+}
+
+TEST(OperationsTests, test_copy_file_verify_remote_checksum)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts   = copy_options{};
+	opts.verify = true;
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	};
+
+	auto sha256 = make_digester(digest_algorithm::SHA256);
+	sha256->update("abc", 3);
+
+	// The remote destination hashes the file with SHA-256 itself, it is not read back
+	ON_CALL(dest_access, is_remote()).WillByDefault(testing::Return(true));
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+	ON_CALL(*dest_file, write(testing::_, testing::_)).WillByDefault(testing::ReturnArg<1>());
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+	EXPECT_CALL(dest_access, checksum(testing::Eq(dst.path), digest_algorithm::SHA256)).WillOnce(testing::Return(sha256->value()));
+
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_))
+	    .WillOnce([](void* buf, std::size_t) {
+		    std::memcpy(buf, "abc", 3);
+		    return std::size_t{ 3u };
+	    })
+	    .WillOnce(testing::Return(0));
+
+	const auto result = copy_file(source_access, src, dest_access, dst, opts, nullptr);
+	ASSERT_EQ(result.digests.size(), 1u);
+	EXPECT_EQ(result.digests[0], sha256->value());
+}
+
+TEST(OperationsTests, test_copy_file_sparse_digest)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts    = copy_options{};
+	opts.sparse  = copy_options::sparse_mode::AUTO;
+	opts.digests = { digest_algorithm::SHA256 };
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+
+	// Source layout: hole [0, 4096), data [4096, 8192), hole [8192, 12288)
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size = 12288u;
+		return a;
+	};
+
+	const auto block_size = std::size_t{ 4096u };
+	char       content[3 * block_size];
+	std::memset(content, 0, sizeof(content));
+	std::memset(content + block_size, 'x', block_size);
+
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+	ON_CALL(*dest_file, write(testing::_, testing::_)).WillByDefault(testing::ReturnArg<1>());
+	ON_CALL(*dest_file, seek(testing::_)).WillByDefault(testing::ReturnArg<0>());
+	ON_CALL(source_file_ref, seek(testing::_)).WillByDefault(testing::ReturnArg<0>());
+	ON_CALL(source_file_ref, seek_data(0u)).WillByDefault(testing::Return(block_size));
+	ON_CALL(source_file_ref, seek_hole(block_size)).WillByDefault(testing::Return(2 * block_size));
+	ON_CALL(source_file_ref, seek_data(2 * block_size)).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_file_ref, read(testing::NotNull(), block_size)).WillByDefault([&](void* buf, std::size_t) {
+		std::memcpy(buf, content + block_size, block_size);
+		return block_size;
+	});
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	// The holes are digested as zeros
+	auto expected = make_digester(digest_algorithm::SHA256);
+	expected->update(content, sizeof(content));
+
+	const auto result = copy_file(source_access, src, dest_access, dst, opts, nullptr);
+	EXPECT_EQ(result.size, sizeof(content));
+	ASSERT_EQ(result.digests.size(), 1u);
+	EXPECT_EQ(result.digests[0], expected->value());
+}
+
+TEST(OperationsTests, test_copy_file_sparse_auto)
+{
+	auto sq = testing::InSequence{};
+
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts   = copy_options{};
+	opts.sparse = copy_options::sparse_mode::AUTO;
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+
+	// Source layout: data [0, 4096), hole [4096, 8192), data [8192, 12288), hole [12288, 16384)
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size = 16384u;
+		return a;
+	};
+
+	const auto block_size = std::size_t{ 4096u };
+	char       block[block_size];
+	std::memset(block, 'x', block_size);
+
+	auto&& read_block = [&](void* buf, std::size_t) {
+		std::memcpy(buf, block, block_size);
+		return block_size;
+	};
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(source_access, stat(testing::Eq(src.current_path))).WillOnce(testing::Return(make_attributes_lambda()));
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	EXPECT_CALL(source_file_ref, seek_data(0u)).WillOnce(testing::Return(0u));
+	EXPECT_CALL(source_file_ref, seek_hole(0u)).WillOnce(testing::Return(4096u));
+	EXPECT_CALL(source_file_ref, seek(0u)).WillOnce(testing::Return(0u));
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), block_size)).WillOnce(read_block);
+	EXPECT_CALL(dest_file_ref, write(BufferEq(block, block_size), block_size)).WillOnce(testing::Return(block_size));
+
+	EXPECT_CALL(source_file_ref, seek_data(4096u)).WillOnce(testing::Return(8192u));
+	EXPECT_CALL(source_file_ref, seek_hole(8192u)).WillOnce(testing::Return(12288u));
+	EXPECT_CALL(source_file_ref, seek(8192u)).WillOnce(testing::Return(8192u));
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), block_size)).WillOnce(read_block);
+	EXPECT_CALL(dest_file_ref, seek(8192u)).WillOnce(testing::Return(8192u));
+	EXPECT_CALL(dest_file_ref, write(BufferEq(block, block_size), block_size)).WillOnce(testing::Return(block_size));
+
+	EXPECT_CALL(source_file_ref, seek_data(12288u)).WillOnce(testing::Return(std::nullopt));
+
+	// The trailing hole is created by extending the file
+	EXPECT_CALL(dest_file_ref, truncate(16384u));
+
+	EXPECT_EQ(copy_file(source_access, src, dest_access, dst, opts, nullptr).dest_path, dst.path);
+}
+
+TEST(OperationsTests, test_copy_file_sparse_always)
+{
+	auto sq = testing::InSequence{};
+
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts   = copy_options{};
+	opts.sparse = copy_options::sparse_mode::ALWAYS;
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+
+	// The source has no holes, but blocks 1 and 3 are all zeros
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size = 16384u;
+		return a;
+	};
+
+	const auto block_size = std::size_t{ 4096u };
+	char       content[4 * block_size];
+	std::memset(content, 0, sizeof(content));
+	std::memset(content, 'a', block_size);
+	std::memset(content + 2 * block_size, 'b', block_size);
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(source_access, stat(testing::Eq(src.current_path))).WillOnce(testing::Return(make_attributes_lambda()));
+	EXPECT_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	EXPECT_CALL(source_file_ref, seek_data(0u)).WillOnce(testing::Return(0u));
+	EXPECT_CALL(source_file_ref, seek_hole(0u)).WillOnce(testing::Return(sizeof(content)));
+	EXPECT_CALL(source_file_ref, seek(0u)).WillOnce(testing::Return(0u));
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), sizeof(content))).WillOnce([&](void* buf, std::size_t) {
+		std::memcpy(buf, content, sizeof(content));
+		return sizeof(content);
+	});
+	EXPECT_CALL(dest_file_ref, write(BufferEq(content, block_size), block_size)).WillOnce(testing::Return(block_size));
+	EXPECT_CALL(dest_file_ref, seek(2 * block_size)).WillOnce(testing::Return(2 * block_size));
+	EXPECT_CALL(dest_file_ref, write(BufferEq(content + 2 * block_size, block_size), block_size)).WillOnce(testing::Return(block_size));
+	EXPECT_CALL(source_file_ref, seek_data(sizeof(content))).WillOnce(testing::Return(std::nullopt));
+	EXPECT_CALL(dest_file_ref, truncate(sizeof(content)));
+
+	EXPECT_EQ(copy_file(source_access, src, dest_access, dst, opts, nullptr).dest_path, dst.path);
+}
+
+TEST(OperationsTests, test_copy_file_resume)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src       = source{ "source" };
+	const auto dst       = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+	const auto part_path = fspath{ "destination.part" };
+	const auto info_path = fspath{ "destination.part.info" };
+
+	auto opts               = copy_options{};
+	opts.resume             = true;
+	opts.resume_verify_size = 2u;
+	opts.digests            = { digest_algorithm::CRC32C };
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+	auto tail_file   = std::make_unique<nice_mock_file>();
+	auto info_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+	auto& tail_file_ref   = *tail_file;
+	auto& info_file_ref   = *info_file;
+
+	auto&& make_attributes_lambda = [](std::uintmax_t size) {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size  = size;
+		a.mtime = std::chrono::system_clock::time_point{ std::chrono::seconds{ 1700000000 } };
+		return a;
+	};
+
+	auto&& read_text = [](const char* text) {
+		return [text](void* buf, std::size_t) {
+			std::memcpy(buf, text, std::strlen(text));
+			return std::strlen(text);
+		};
+	};
+
+	// "abc" of "abcdef" was copied before
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(dest_access, try_stat(testing::Eq(part_path))).WillByDefault(testing::Return(make_attributes_lambda(3u)));
+	ON_CALL(dest_access, exists(testing::Eq(info_path))).WillByDefault(testing::Return(true));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda(6u)));
+	ON_CALL(source_file_ref, seek(testing::_)).WillByDefault(testing::ReturnArg<0>());
+	ON_CALL(dest_file_ref, seek(testing::_)).WillByDefault(testing::ReturnArg<0>());
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(info_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(info_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(part_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(tail_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(part_path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	EXPECT_CALL(info_file_ref, read(testing::NotNull(), testing::_))
+	    .WillOnce(read_text("flexfs-partial 1 6 1700000000\n"))
+	    .WillRepeatedly(testing::Return(0));
+
+	// The tail is compared, the copied part is digested, and the copy continues at offset 3
+	EXPECT_CALL(source_file_ref, seek(testing::_)).Times(testing::AnyNumber());
+	EXPECT_CALL(dest_file_ref, seek(testing::_)).Times(testing::AnyNumber());
+	EXPECT_CALL(dest_access, remove(testing::_)).Times(testing::AnyNumber());
+	EXPECT_CALL(source_file_ref, seek(1u));
+	EXPECT_CALL(tail_file_ref, seek(1u)).WillOnce(testing::Return(1u));
+	EXPECT_CALL(tail_file_ref, read(testing::NotNull(), 2u)).WillOnce(read_text("bc"));
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_))
+	    .WillOnce(read_text("bc"))
+	    .WillOnce(read_text("abc"))
+	    .WillOnce(read_text("def"))
+	    .WillOnce(testing::Return(0));
+	EXPECT_CALL(dest_file_ref, truncate(3u));
+	EXPECT_CALL(dest_file_ref, seek(3u)).WillOnce(testing::Return(3u));
+	EXPECT_CALL(dest_file_ref, write(BufferEq("def", 3), 3)).WillOnce(testing::Return(3));
+	EXPECT_CALL(dest_access, try_rename(testing::Eq(part_path), testing::Eq(dst.path))).WillOnce(testing::Return(true));
+	EXPECT_CALL(dest_access, remove(testing::Eq(info_path)));
+
+	const auto result = copy_file(source_access, src, dest_access, dst, opts, nullptr);
+	EXPECT_EQ(result.dest_path, dst.path);
+	EXPECT_EQ(result.size, 6u);
+	EXPECT_EQ(result.resumed, 3u);
+
+	auto digester = make_digester(digest_algorithm::CRC32C);
+	digester->update("abcdef", 6u);
+	ASSERT_EQ(result.digests.size(), 1u);
+	EXPECT_EQ(result.digests[0], digester->value());
+}
+
+TEST(OperationsTests, test_copy_file_resume_changed_source)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src       = source{ "source" };
+	const auto dst       = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+	const auto part_path = fspath{ "destination.part" };
+	const auto info_path = fspath{ "destination.part.info" };
+
+	auto opts   = copy_options{};
+	opts.resume = true;
+
+	auto source_file   = std::make_unique<nice_mock_file>();
+	auto dest_file     = std::make_unique<nice_mock_file>();
+	auto old_info_file = std::make_unique<nice_mock_file>();
+	auto new_info_file = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref   = *source_file;
+	auto& dest_file_ref     = *dest_file;
+	auto& old_info_file_ref = *old_info_file;
+	auto& new_info_file_ref = *new_info_file;
+
+	auto&& make_attributes_lambda = [](std::uintmax_t size) {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size  = size;
+		a.mtime = std::chrono::system_clock::time_point{ std::chrono::seconds{ 1700000000 } };
+		return a;
+	};
+
+	// The partial file is of an older version of the source file
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(dest_access, try_stat(testing::Eq(part_path))).WillByDefault(testing::Return(make_attributes_lambda(3u)));
+	ON_CALL(dest_access, exists(testing::Eq(info_path))).WillByDefault(testing::Return(true));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda(6u)));
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(info_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(old_info_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(part_path), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(info_path), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(new_info_file))));
+
+	EXPECT_CALL(old_info_file_ref, read(testing::NotNull(), testing::_))
+	    .WillOnce([](void* buf, std::size_t) {
+		    std::memcpy(buf, "flexfs-partial 1 6 1600000000\n", 30);
+		    return std::size_t{ 30u };
+	    })
+	    .WillRepeatedly(testing::Return(0));
+	EXPECT_CALL(new_info_file_ref, write(BufferEq("flexfs-partial 1 6 1700000000\n", 30), 30)).WillOnce(testing::Return(30));
+
+	// Starts over
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_))
+	    .WillOnce([](void* buf, std::size_t) {
+		    std::memcpy(buf, "abcdef", 6);
+		    return std::size_t{ 6u };
+	    })
+	    .WillOnce(testing::Return(0));
+	EXPECT_CALL(dest_file_ref, write(BufferEq("abcdef", 6), 6)).WillOnce(testing::Return(6));
+	EXPECT_CALL(dest_access, try_rename(testing::Eq(part_path), testing::Eq(dst.path))).WillOnce(testing::Return(true));
+
+	const auto result = copy_file(source_access, src, dest_access, dst, opts, nullptr);
+	EXPECT_EQ(result.size, 6u);
+	EXPECT_EQ(result.resumed, 0u);
+}
+
+TEST(OperationsTests, test_copy_file_resume_overwrite)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src       = source{ "source" };
+	const auto dst       = destination{ "destination", std::nullopt, false, destination::conflict_policy::OVERWRITE };
+	const auto part_path = fspath{ "destination.part" };
+	const auto info_path = fspath{ "destination.part.info" };
+
+	auto opts   = copy_options{};
+	opts.resume = true;
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+	auto info_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+	auto& info_file_ref   = *info_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size  = 6u;
+		a.mtime = std::chrono::system_clock::time_point{ std::chrono::seconds{ 1700000000 } };
+		return a;
+	};
+
+	// Neither the destination file nor a partial file exist
+	ON_CALL(dest_access, try_stat(testing::_)).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(dest_access, exists(testing::Eq(info_path))).WillByDefault(testing::Return(true));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+	ON_CALL(info_file_ref, write(testing::_, testing::_)).WillByDefault(testing::ReturnArg<1>());
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(part_path), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(info_path), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(info_file))));
+
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_))
+	    .WillOnce([](void* buf, std::size_t) {
+		    std::memcpy(buf, "abcdef", 6);
+		    return std::size_t{ 6u };
+	    })
+	    .WillOnce(testing::Return(0));
+	EXPECT_CALL(dest_file_ref, write(BufferEq("abcdef", 6), 6)).WillOnce(testing::Return(6));
+
+	// The partial file is renamed over the destination path, which is not removed first
+	EXPECT_CALL(dest_access, remove(testing::Eq(dst.path))).Times(0);
+	EXPECT_CALL(dest_access, rename(testing::Eq(part_path), testing::Eq(dst.path)));
+	EXPECT_CALL(dest_access, remove(testing::Eq(info_path)));
+
+	const auto result = copy_file(source_access, src, dest_access, dst, opts, nullptr);
+	EXPECT_EQ(result.dest_path, dst.path);
+	EXPECT_EQ(result.size, 6u);
+	EXPECT_EQ(result.resumed, 0u);
+}
+
+TEST(OperationsTests, test_copy_file_server_side)
+{
+	auto access = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+	attr.size = 1000000u;
+
+	ON_CALL(access, is_remote()).WillByDefault(testing::Return(true));
+	ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	// A single request, no data passes through
+	EXPECT_CALL(dest_file_ref, copy_from(testing::Ref(source_file_ref), 0u, 1000000u, 0u)).WillOnce(testing::Return(true));
+	EXPECT_CALL(source_file_ref, read(testing::_, testing::_)).Times(0);
+	EXPECT_CALL(dest_file_ref, write(testing::_, testing::_)).Times(0);
+
+	auto progress = std::vector<std::uint64_t>{};
+
+	const auto result = copy_file(access, src, access, dst, copy_options{}, [&](std::uint64_t n) { progress.push_back(n); });
+	EXPECT_EQ(result.dest_path, dst.path);
+	EXPECT_EQ(result.size, 1000000u);
+	EXPECT_EQ(progress, std::vector<std::uint64_t>{ 1000000u });
+
+	// Digests require the data to pass through
+	source_file = std::make_unique<nice_mock_file>();
+	dest_file   = std::make_unique<nice_mock_file>();
+
+	auto opts    = copy_options{};
+	opts.digests = { digest_algorithm::CRC32C };
+
+	EXPECT_CALL(*dest_file, copy_from(testing::_, testing::_, testing::_, testing::_)).Times(0);
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	copy_file(access, src, access, dst, opts, nullptr);
+}
+
+TEST(OperationsTests, test_copy_file_hard_link)
+{
+	auto access = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+	attr.size = 1000000u;
+
+	auto opts      = copy_options{};
+	opts.hard_link = true;
+
+	ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::make_unique<nice_mock_file>())));
+
+	// A second name for the same data, nothing is copied
+	EXPECT_CALL(access, try_link(testing::Eq(src.current_path), testing::Eq(dst.path))).WillOnce(testing::Return(true));
+	EXPECT_CALL(access, try_create(testing::_, testing::_, testing::_)).Times(0);
+
+	auto progress = std::vector<std::uint64_t>{};
+
+	const auto result = copy_file(access, src, access, dst, opts, [&](std::uint64_t n) { progress.push_back(n); });
+	EXPECT_EQ(result.dest_path, dst.path);
+	EXPECT_EQ(result.size, 1000000u);
+	EXPECT_EQ(progress, std::vector<std::uint64_t>{ 1000000u });
+
+	// The data is copied when the link cannot be made, e.g. across file systems
+	auto dest_file = std::make_unique<nice_mock_file>();
+	EXPECT_CALL(*dest_file, copy_from(testing::_, 0u, 1000000u, 0u)).WillOnce(testing::Return(true));
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::make_unique<nice_mock_file>())));
+	EXPECT_CALL(access, try_link(testing::Eq(src.current_path), testing::Eq(dst.path)))
+	    .WillOnce(testing::Throw(system_exception{ std::make_error_code(std::errc::cross_device_link) }));
+	EXPECT_CALL(access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	EXPECT_EQ(copy_file(access, src, access, dst, opts, nullptr).size, 1000000u);
+}
+
+TEST(OperationsTests, test_copy_file_hard_link_overwrite)
+{
+	auto       src       = source{ "source" };
+	const auto dst       = destination{ "destination", std::nullopt, false, destination::conflict_policy::OVERWRITE };
+	const auto temp_path = fspath{ "destination.link" };
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+	attr.size = 1000u;
+
+	auto opts      = copy_options{};
+	opts.hard_link = true;
+
+	{
+		// A new name is linked directly
+		auto access = nice_mock_access{};
+		ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+		EXPECT_CALL(access, try_link(testing::Eq(src.current_path), testing::Eq(dst.path))).WillOnce(testing::Return(true));
+		EXPECT_CALL(access, remove(testing::_)).Times(0);
+		EXPECT_CALL(access, rename(testing::_, testing::_)).Times(0);
+		EXPECT_EQ(copy_file(access, src, access, dst, opts, nullptr).dest_path, dst.path);
+	}
+	{
+		// An existing file is replaced by renaming a link over it, a stale link from before is removed first
+		auto access = nice_mock_access{};
+		ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+		EXPECT_CALL(access, try_link(testing::Eq(src.current_path), testing::Eq(dst.path))).WillOnce(testing::Return(false));
+		EXPECT_CALL(access, try_link(testing::Eq(src.current_path), testing::Eq(temp_path)))
+		    .WillOnce(testing::Return(false))
+		    .WillOnce(testing::Return(true));
+		EXPECT_CALL(access, remove(testing::Eq(temp_path))).Times(1);
+		EXPECT_CALL(access, remove(testing::Eq(dst.path))).Times(0);
+		EXPECT_CALL(access, rename(testing::Eq(temp_path), testing::Eq(dst.path))).Times(1);
+		EXPECT_CALL(access, exists(testing::Eq(temp_path))).WillOnce(testing::Return(false));
+		EXPECT_CALL(access, try_create(testing::_, testing::_, testing::_)).Times(0);
+		EXPECT_EQ(copy_file(access, src, access, dst, opts, nullptr).size, 1000u);
+	}
+	{
+		// When the link cannot be renamed over the file, the data is copied into it
+		auto access    = nice_mock_access{};
+		auto dest_file = std::make_unique<nice_mock_file>();
+		ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+		EXPECT_CALL(access, try_link(testing::Eq(src.current_path), testing::Eq(dst.path))).WillOnce(testing::Return(false));
+		EXPECT_CALL(access, try_link(testing::Eq(src.current_path), testing::Eq(temp_path))).WillOnce(testing::Return(true));
+		EXPECT_CALL(access, rename(testing::Eq(temp_path), testing::Eq(dst.path)))
+		    .WillOnce(testing::Throw(system_exception{ std::make_error_code(std::errc::file_exists) }));
+		EXPECT_CALL(access, exists(testing::Eq(temp_path))).WillOnce(testing::Return(true));
+		EXPECT_CALL(access, remove(testing::Eq(temp_path))).Times(1);
+		EXPECT_CALL(*dest_file, copy_from(testing::_, 0u, 1000u, 0u)).WillOnce(testing::Return(true));
+		EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+		    .WillOnce(testing::Return(testing::ByMove(std::make_unique<nice_mock_file>())));
+		EXPECT_CALL(access, open(testing::Eq(dst.path), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0664))
+		    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+		EXPECT_EQ(copy_file(access, src, access, dst, opts, nullptr).size, 1000u);
+	}
+}
+
+TEST(OperationsTests, test_copy_file_skip_unchanged)
+{
+	auto access = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::AUTORENAME };
+
+	const auto mtime = std::chrono::system_clock::time_point{ std::chrono::seconds{ 1700000000 } };
+
+	auto source_attr = attributes{};
+	source_attr.set_mode(S_IFREG | 0664);
+	source_attr.size  = 1000u;
+	source_attr.mtime = mtime + std::chrono::milliseconds{ 300 };
+
+	// Copied earlier, with the modification time to the second
+	auto dest_attr  = source_attr;
+	dest_attr.mtime = mtime;
+
+	auto opts           = copy_options{};
+	opts.skip_unchanged = copy_options::skip_mode::SIZE_MTIME;
+	opts.preserve_mtime = true;
+
+	ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(source_attr));
+	ON_CALL(access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(dest_attr));
+	EXPECT_CALL(access, open(testing::_, testing::_, testing::_)).Times(0);
+	EXPECT_CALL(access, try_create(testing::_, testing::_, testing::_)).Times(0);
+	EXPECT_CALL(access, set_metadata(testing::_, testing::_, testing::_)).Times(0);
+
+	auto result = copy_file(access, src, access, dst, opts, nullptr);
+	EXPECT_EQ(result.dest_path, dst.path);
+	EXPECT_EQ(result.size, 1000u);
+	EXPECT_TRUE(result.skipped);
+
+	// Changed since, it is copied under the conflict policy and gets the modification time of the source
+	dest_attr.mtime = mtime - std::chrono::seconds{ 1 };
+	ON_CALL(access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(dest_attr));
+
+	auto dest_file = std::make_unique<nice_mock_file>();
+	EXPECT_CALL(*dest_file, copy_from(testing::_, 0u, 1000u, 0u)).WillOnce(testing::Return(true));
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::make_unique<nice_mock_file>())));
+	EXPECT_CALL(access, try_create(testing::Eq(fspath{ "destination~1" }), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+	EXPECT_CALL(access, set_metadata(testing::Eq(fspath{ "destination~1" }), testing::Eq(std::nullopt), testing::Eq(source_attr.mtime)))
+	    .Times(1);
+
+	result = copy_file(access, src, access, dst, opts, nullptr);
+	EXPECT_EQ(result.dest_path, fspath{ "destination~1" });
+	EXPECT_FALSE(result.skipped);
+}
+
+TEST(OperationsTests, test_copy_file_skip_unchanged_checksum)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::OVERWRITE };
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0640);
+	attr.size  = 3u;
+	attr.mtime = std::chrono::system_clock::time_point{ std::chrono::seconds{ 1700000000 } };
+
+	// Different modification time and permissions, same content
+	auto dest_attr  = attr;
+	dest_attr.mtime = attr.mtime.value() + std::chrono::hours{ 1 };
+	dest_attr.set_mode(S_IFREG | 0664);
+
+	auto sha256 = make_digester(digest_algorithm::SHA256);
+	sha256->update("abc", 3);
+
+	auto opts           = copy_options{};
+	opts.skip_unchanged = copy_options::skip_mode::CHECKSUM;
+	opts.preserve_mtime = true;
+	opts.preserve_mode  = true;
+
+	ON_CALL(dest_access, is_remote()).WillByDefault(testing::Return(true));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(dest_attr));
+	EXPECT_CALL(source_access, checksum(testing::Eq(src.current_path), digest_algorithm::SHA256))
+	    .WillOnce(testing::Return(sha256->value()));
+	EXPECT_CALL(dest_access, checksum(testing::Eq(dst.path), digest_algorithm::SHA256)).WillOnce(testing::Return(sha256->value()));
+	EXPECT_CALL(source_access, open(testing::_, testing::_, testing::_)).Times(0);
+	EXPECT_CALL(dest_access, open(testing::_, testing::_, testing::_)).Times(0);
+	EXPECT_CALL(dest_access, set_metadata(testing::Eq(dst.path), testing::Eq(mode_t{ 0640 }), testing::Eq(attr.mtime))).Times(1);
+
+	const auto result = copy_file(source_access, src, dest_access, dst, opts, nullptr);
+	EXPECT_TRUE(result.skipped);
+}
+
+TEST(OperationsTests, test_copy_file_durability)
+{
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+
+	// Returns the wait argument of each sync call on the destination file
+	auto&& run = [&](copy_options::durability_mode durability, bool remote) {
+		auto source_access = nice_mock_access{};
+		auto dest_access   = nice_mock_access{};
+		auto dest_file     = std::make_unique<nice_mock_file>();
+		auto waits         = std::vector<bool>{};
+
+		ON_CALL(*dest_file, sync(testing::_)).WillByDefault([&](bool wait) {
+			waits.push_back(wait);
+			return true;
+		});
+		ON_CALL(dest_access, is_remote()).WillByDefault(testing::Return(remote));
+		ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+		ON_CALL(source_access, open(testing::Eq(src.current_path), testing::_, testing::_))
+		    .WillByDefault([](const fspath&, int, mode_t) { return std::make_unique<nice_mock_file>(); });
+		EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), testing::_, testing::_))
+		    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+		EXPECT_CALL(dest_access, sync_fs(testing::_)).Times(0);
+
+		auto opts       = copy_options{};
+		opts.durability = durability;
+		copy_file(source_access, src, dest_access, dst, opts, nullptr);
+		return waits;
+	};
+
+	EXPECT_EQ(run(copy_options::durability_mode::NONE, false), std::vector<bool>{});
+	EXPECT_EQ(run(copy_options::durability_mode::PER_FILE, false), std::vector<bool>{ true });
+	EXPECT_EQ(run(copy_options::durability_mode::PER_FILE, true), std::vector<bool>{ true });
+
+	// Only the writeback is started, the file system is flushed by the caller
+	EXPECT_EQ(run(copy_options::durability_mode::BATCH, false), std::vector<bool>{ false });
+
+	// No file system flush over SFTP
+	EXPECT_EQ(run(copy_options::durability_mode::BATCH, true), std::vector<bool>{ true });
+}
+
+TEST(OperationsTests, test_copy_file_compression)
+{
+	auto access = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination.gz", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	const auto data = std::string(100000u, 'a');
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+	attr.size = data.size();
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+	auto written     = std::string{};
+
+	ON_CALL(*source_file, read(testing::_, testing::_)).WillByDefault([&, pos = std::size_t{}](void* buf, std::size_t count) mutable {
+		const auto n = std::min(count, data.size() - pos);
+		std::memcpy(buf, data.data() + pos, n);
+		pos += n;
+		return n;
+	});
+	ON_CALL(*dest_file, write(testing::_, testing::_)).WillByDefault([&](const void* buf, std::size_t count) {
+		written.append(static_cast<const char*>(buf), count);
+		return count;
+	});
+	ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), testing::_, testing::_))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(access, try_create(testing::Eq(dst.path), testing::_, testing::_))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	// A link would leave the data uncompressed
+	EXPECT_CALL(access, try_link(testing::_, testing::_)).Times(0);
+
+	auto opts        = copy_options{};
+	opts.compression = copy_options::compression_mode::GZIP;
+	opts.hard_link   = true;
+	opts.digests     = { digest_algorithm::SHA256 };
+
+	auto sha256 = make_digester(digest_algorithm::SHA256);
+	sha256->update(data.data(), data.size());
+
+	auto progress = std::uint64_t{};
+
+	const auto result = copy_file(access, src, access, dst, opts, [&](std::uint64_t n) { progress = n; });
+	EXPECT_EQ(result.size, written.size());
+	EXPECT_LT(result.size, 1000u);
+	EXPECT_EQ(written.substr(0u, 2u), "\x1f\x8b"); // gzip magic
+	EXPECT_EQ(progress, data.size());
+	ASSERT_EQ(result.digests.size(), 1u);
+	EXPECT_EQ(result.digests.front(), sha256->value());
+}
+
+namespace {
+
+// Contents of a mock file, with a read position that follows seek()
+struct mock_file_data
+{
+	std::string data;
+	std::size_t pos = 0u;
+
+	auto read()
+	{
+		return [this](void* buf, std::size_t count) {
+			const auto n = std::min(count, this->data.size() - this->pos);
+			std::memcpy(buf, this->data.data() + this->pos, n);
+			this->pos += n;
+			return n;
+		};
+	}
+
+	auto seek()
+	{
+		return [this](std::uint64_t offset) {
+			this->pos = static_cast<std::size_t>(std::min<std::uint64_t>(offset, this->data.size()));
+			return offset;
+		};
+	}
+};
+
+// Pseudo random data
+std::string random_data(std::size_t size)
+{
+	auto result = std::string(size, '\0');
+	auto seed   = 12345u;
+	for (auto& c : result)
+	{
+		seed = seed * 1103515245u + 12345u;
+		c    = static_cast<char>(seed >> 16);
+	}
+	return result;
+}
+
+} // namespace
+
+TEST(OperationsTests, test_copy_file_delta)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::OVERWRITE };
+
+	auto opts  = copy_options{};
+	opts.delta = true;
+
+	// The second block of 1024 bytes changed
+	auto old_data = mock_file_data{ random_data(3000u) };
+	auto new_data = mock_file_data{ old_data.data };
+	new_data.data.replace(1500u, 5u, "hello");
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto old_file    = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& old_file_ref    = *old_file;
+	auto& dest_file_ref   = *dest_file;
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+	attr.size = 3000u;
+
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+	ON_CALL(dest_access, exists(testing::Eq(dst.path))).WillByDefault(testing::Return(true));
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(attr));
+	ON_CALL(source_file_ref, read(testing::NotNull(), testing::_)).WillByDefault(new_data.read());
+	ON_CALL(source_file_ref, seek(testing::_)).WillByDefault(new_data.seek());
+	ON_CALL(old_file_ref, read(testing::NotNull(), testing::_)).WillByDefault(old_data.read());
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(dst.path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(old_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	// Only the changed block is written, at its offset
+	EXPECT_CALL(dest_file_ref, seek(1024u)).WillOnce(testing::Return(1024u));
+	EXPECT_CALL(dest_file_ref, write(BufferEq(new_data.data.data() + 1024u, 1024u), 1024u)).WillOnce(testing::Return(1024u));
+	EXPECT_CALL(dest_file_ref, truncate(testing::_)).Times(0);
+
+	const auto result = copy_file(source_access, src, dest_access, dst, opts, nullptr);
+	EXPECT_EQ(result.dest_path, dst.path);
+	EXPECT_EQ(result.size, 3000u);
+	EXPECT_EQ(result.reused, 1976u);
+}
+
+TEST(OperationsTests, test_copy_file_delta_insertion)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::OVERWRITE };
+
+	auto opts    = copy_options{};
+	opts.delta   = true;
+	opts.digests = { digest_algorithm::CRC32C };
+
+	// A few bytes inserted at the start move all blocks
+	auto old_data = mock_file_data{ random_data(3000u) };
+	auto new_data = mock_file_data{ "abc" + old_data.data };
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto old_file    = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& old_file_ref    = *old_file;
+	auto& dest_file_ref   = *dest_file;
+
+	auto old_attr = attributes{};
+	old_attr.set_mode(S_IFREG | 0664);
+	old_attr.size = old_data.data.size();
+	auto new_attr = old_attr;
+	new_attr.size = new_data.data.size();
+
+	auto written = std::string{};
+
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(new_attr));
+	ON_CALL(dest_access, exists(testing::Eq(dst.path))).WillByDefault(testing::Return(true));
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(old_attr));
+	ON_CALL(source_file_ref, read(testing::NotNull(), testing::_)).WillByDefault(new_data.read());
+	ON_CALL(source_file_ref, seek(testing::_)).WillByDefault(new_data.seek());
+	ON_CALL(old_file_ref, read(testing::NotNull(), testing::_)).WillByDefault(old_data.read());
+	ON_CALL(dest_file_ref, write(testing::_, testing::_)).WillByDefault([&](const void* buf, std::size_t count) {
+		written.append(static_cast<const char*>(buf), count);
+		return count;
+	});
+
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(dst.path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(old_file))));
+	EXPECT_CALL(dest_access, open(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	// Nothing is kept at its offset, the file is copied as a whole, once
+	EXPECT_CALL(dest_file_ref, truncate(0u));
+
+	auto crc32c = make_digester(digest_algorithm::CRC32C);
+	crc32c->update(new_data.data.data(), new_data.data.size());
+
+	const auto result = copy_file(source_access, src, dest_access, dst, opts, nullptr);
+	EXPECT_EQ(result.size, new_data.data.size());
+	EXPECT_EQ(result.reused, 0u);
+	EXPECT_EQ(written, new_data.data);
+	ASSERT_EQ(result.digests.size(), 1u);
+	EXPECT_EQ(result.digests.front(), crc32c->value());
+}
+
+namespace {
+
+class interrupted_interruptor final : public i_interruptor
+{
+public:
+	void interrupt() override
+	{
+	}
+
+	bool is_interrupted() override
+	{
+		return true;
+	}
+
+	bool wait_for_interruption(std::chrono::milliseconds /*duration*/) override
+	{
+		return true;
+	}
+};
+
+class flag_interruptor final : public i_interruptor
+{
+	bool interrupted_ = false;
+
+public:
+	void interrupt() override
+	{
+		this->interrupted_ = true;
+	}
+
+	bool is_interrupted() override
+	{
+		return this->interrupted_;
+	}
+
+	bool wait_for_interruption(std::chrono::milliseconds /*duration*/) override
+	{
+		return this->interrupted_;
+	}
+};
+
+} // namespace
+
+TEST(OperationsTests, test_copy_file_rate_limit)
+{
+	auto source_access = nice_mock_access{};
+	auto dest_access   = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto opts        = copy_options{};
+	opts.rate_limit  = std::make_shared<rate_limiter>(1u);
+	opts.interruptor = std::make_shared<interrupted_interruptor>();
+
+	auto source_file = std::make_unique<nice_mock_file>();
+	auto dest_file   = std::make_unique<nice_mock_file>();
+
+	auto& source_file_ref = *source_file;
+	auto& dest_file_ref   = *dest_file;
+
+	auto&& make_attributes_lambda = [] {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	};
+
+	ON_CALL(dest_access, try_stat(testing::Eq(dst.path))).WillByDefault(testing::Return(std::nullopt));
+	ON_CALL(source_access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(make_attributes_lambda()));
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(source_file))));
+	EXPECT_CALL(dest_access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	EXPECT_CALL(source_file_ref, read(testing::NotNull(), testing::_)).WillOnce([](void* buf, std::size_t) {
+		std::memcpy(buf, "abc", 3);
+		return std::size_t{ 3u };
+	});
+
+	// 3 bytes at 1 byte per second, the copy is interrupted while it waits for the limiter
+	EXPECT_CALL(dest_file_ref, write(testing::_, testing::_)).Times(0);
+
+	EXPECT_THROW(copy_file(source_access, src, dest_access, dst, opts, nullptr), interrupted_exception);
+}
+
+TEST(OperationsTests, test_copy_file_server_side_chunks)
+{
+	auto access = nice_mock_access{};
+
+	auto       src = source{ "source" };
+	const auto dst = destination{ "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	const auto chunk_size = std::uint64_t{ 67108864u };
+	const auto size       = 2u * chunk_size + 1000u;
+
+	auto attr = attributes{};
+	attr.set_mode(S_IFREG | 0664);
+	attr.size = size;
+
+	auto opts        = copy_options{};
+	auto interruptor = std::make_shared<flag_interruptor>();
+	opts.interruptor = interruptor;
+
+	ON_CALL(access, is_remote()).WillByDefault(testing::Return(true));
+	ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault(testing::Return(attr));
+
+	// One request per chunk, with progress after each
+	auto dest_file = std::make_unique<nice_mock_file>();
+	{
+		auto sq = testing::InSequence{};
+		EXPECT_CALL(*dest_file, copy_from(testing::_, 0u, chunk_size, 0u)).WillOnce(testing::Return(true));
+		EXPECT_CALL(*dest_file, copy_from(testing::_, chunk_size, chunk_size, chunk_size)).WillOnce(testing::Return(true));
+		EXPECT_CALL(*dest_file, copy_from(testing::_, 2u * chunk_size, 1000u, 2u * chunk_size)).WillOnce(testing::Return(true));
+	}
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::make_unique<nice_mock_file>())));
+	EXPECT_CALL(access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	auto progress = std::vector<std::uint64_t>{};
+
+	const auto result = copy_file(access, src, access, dst, opts, [&](std::uint64_t n) { progress.push_back(n); });
+	EXPECT_EQ(result.size, size);
+	EXPECT_EQ(progress, (std::vector<std::uint64_t>{ chunk_size, 2u * chunk_size, size }));
+
+	// Interrupted between two chunks
+	dest_file = std::make_unique<nice_mock_file>();
+	EXPECT_CALL(*dest_file, copy_from(testing::_, 0u, chunk_size, 0u)).WillOnce(testing::Return(true));
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::make_unique<nice_mock_file>())));
+	EXPECT_CALL(access, try_create(testing::Eq(dst.path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(dest_file))));
+
+	EXPECT_THROW(copy_file(access, src, access, dst, opts, [&](std::uint64_t) { interruptor->interrupt(); }), interrupted_exception);
+}
+
 } // namespace flexfs
@@ -0,0 +1,93 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/rate_limiter.h"
+#include "flexfs/core/noop_interruptor.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+
+namespace flexfs {
+
+namespace {
+
+class interrupted final : public i_interruptor
+{
+public:
+	void interrupt() override
+	{
+	}
+
+	bool is_interrupted() override
+	{
+		return true;
+	}
+
+	bool wait_for_interruption(std::chrono::milliseconds /*duration*/) override
+	{
+		return true;
+	}
+};
+
+std::chrono::milliseconds time_acquire(rate_limiter& limiter, std::uint64_t bytes)
+{
+	auto       interruptor = noop_interruptor{};
+	const auto start       = std::chrono::steady_clock::now();
+	limiter.acquire(bytes, interruptor);
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+}
+
+} // namespace
+
+TEST(RateLimiterTests, test_burst)
+{
+	auto limiter = rate_limiter{ 1000000u };
+	EXPECT_EQ(limiter.rate(), 1000000u);
+	EXPECT_EQ(limiter.burst(), 1000000u);
+	// A full bucket is available at once
+	EXPECT_LT(time_acquire(limiter, 1000000u), std::chrono::milliseconds{ 50 });
+	// The next bytes are paced
+	EXPECT_GE(time_acquire(limiter, 100000u), std::chrono::milliseconds{ 90 });
+}
+
+TEST(RateLimiterTests, test_unlimited)
+{
+	auto limiter = rate_limiter{ 0u };
+	EXPECT_LT(time_acquire(limiter, 1000000000u), std::chrono::milliseconds{ 50 });
+}
+
+TEST(RateLimiterTests, test_parent)
+{
+	const auto global = std::make_shared<rate_limiter>(1000000u, 100000u);
+	auto       job1   = rate_limiter{ 0u, 0u, global };
+	auto       job2   = rate_limiter{ 10000000u, 0u, global };
+	EXPECT_EQ(job1.parent(), global);
+
+	// The jobs draw from the same global bucket
+	EXPECT_LT(time_acquire(job1, 100000u), std::chrono::milliseconds{ 50 });
+	EXPECT_GE(time_acquire(job2, 100000u), std::chrono::milliseconds{ 90 });
+}
+
+TEST(RateLimiterTests, test_set_rate)
+{
+	auto limiter = rate_limiter{ 1000000u };
+	limiter.set_rate(100000000u, 1000u);
+	EXPECT_EQ(limiter.rate(), 100000000u);
+	EXPECT_EQ(limiter.burst(), 1000u);
+	// The surplus is capped to the new bucket size, the remaining 999000 bytes take about 10 ms
+	EXPECT_LT(time_acquire(limiter, 1000000u), std::chrono::milliseconds{ 50 });
+}
+
+TEST(RateLimiterTests, test_interrupted)
+{
+	auto limiter     = rate_limiter{ 1000u };
+	auto interruptor = interrupted{};
+	EXPECT_NO_THROW(limiter.acquire(1000u, interruptor));
+	EXPECT_THROW(limiter.acquire(1000u, interruptor), interrupted_exception);
+}
+
+} // namespace flexfs
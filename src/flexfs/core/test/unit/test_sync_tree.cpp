@@ -0,0 +1,243 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "mock_access.h"
+#include "mock_file.h"
+#include "flexfs/core/sync_tree.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace flexfs {
+
+namespace {
+
+const auto t0 = std::chrono::system_clock::time_point{ std::chrono::seconds{ 1700000000 } };
+
+direntry make_entry(const std::string& name, attributes::filetype type, std::uint64_t size, std::chrono::system_clock::time_point mtime)
+{
+	auto e       = direntry{};
+	e.name       = name;
+	e.attr.type  = type;
+	e.attr.size  = size;
+	e.attr.mtime = mtime;
+	return e;
+}
+
+// A tree of directories and file contents, shared by the accesses of all workers
+struct tree
+{
+	std::map<fspath, std::vector<direntry>> dirs;
+	std::map<fspath, std::string>           contents;
+	std::mutex                              mutex;
+	std::vector<fspath>                     mkdirs;
+
+	std::shared_ptr<nice_mock_access> make_access()
+	{
+		auto access = std::make_shared<nice_mock_access>();
+		ON_CALL(*access, exists(testing::_)).WillByDefault([this](const fspath& path) {
+			auto lock = std::lock_guard<std::mutex>{ this->mutex };
+			return this->dirs.count(path) > 0u;
+		});
+		ON_CALL(*access, ls(testing::_)).WillByDefault([this](const fspath& dir) {
+			auto lock = std::lock_guard<std::mutex>{ this->mutex };
+			return this->dirs.at(dir);
+		});
+		ON_CALL(*access, stat(testing::_)).WillByDefault([](const fspath&) {
+			auto a = attributes{};
+			a.set_mode(S_IFREG | 0664);
+			return a;
+		});
+		ON_CALL(*access, mkdir(testing::_, testing::_)).WillByDefault([this](const fspath& path, bool) {
+			auto lock = std::lock_guard<std::mutex>{ this->mutex };
+			this->mkdirs.push_back(path);
+			this->dirs[path];
+		});
+		ON_CALL(*access, open(testing::_, testing::_, testing::_)).WillByDefault([this](const fspath& path, int, mode_t) {
+			auto       file    = std::make_unique<nice_mock_file>();
+			const auto it      = this->contents.find(path);
+			const auto content = it == this->contents.end() ? std::string{} : it->second;
+			ON_CALL(*file, read(testing::_, testing::_)).WillByDefault([content, done = false](void* buf, std::size_t) mutable {
+				if (std::exchange(done, true))
+				{
+					return std::size_t{};
+				}
+				std::memcpy(buf, content.data(), content.size());
+				return content.size();
+			});
+			ON_CALL(*file, write(testing::_, testing::_)).WillByDefault(testing::ReturnArg<1>());
+			return file;
+		});
+		return access;
+	}
+};
+
+std::vector<fspath> dest_paths(const std::vector<sync_action>& plan)
+{
+	auto result = std::vector<fspath>{};
+	for (const auto& action : plan)
+	{
+		result.push_back(action.dest_path);
+	}
+	return result;
+}
+
+} // namespace
+
+TEST(SyncTreeTests, test_sync)
+{
+	auto source = tree{};
+	auto dest   = tree{};
+
+	source.dirs["/s"]   = { make_entry("a", attributes::filetype::REG, 10u, t0),
+		                    make_entry("b", attributes::filetype::REG, 5u, t0 + std::chrono::seconds{ 10 }),
+		                    make_entry("c", attributes::filetype::REG, 3u, t0),
+		                    make_entry("d", attributes::filetype::DIR, 0u, t0),
+		                    make_entry("l", attributes::filetype::LNK, 0u, t0) };
+	source.dirs["/s/d"] = { make_entry("e", attributes::filetype::REG, 3u, t0) };
+	dest.dirs["/t"]     = { make_entry("a", attributes::filetype::REG, 10u, t0 + std::chrono::seconds{ 5 }),
+		                    make_entry("b", attributes::filetype::REG, 5u, t0),
+		                    make_entry("c", attributes::filetype::REG, 4u, t0 + std::chrono::seconds{ 5 }) };
+
+	auto opts         = sync_options{};
+	opts.copy.workers = 2u;
+	opts.dry_run      = true;
+
+	auto&& make_access = [&] { return copy_worker_access{ source.make_access(), dest.make_access() }; };
+
+	// Only a plan
+	auto result = sync_tree(make_access, "/s", "/t", opts);
+	EXPECT_EQ(dest_paths(result.plan), (std::vector<fspath>{ "/t/b", "/t/c", "/t/d", "/t/d/e" }));
+	ASSERT_EQ(result.plan.size(), 4u);
+	EXPECT_EQ(result.plan[0].what, sync_action::kind::COPY);
+	EXPECT_EQ(result.plan[0].why, sync_action::reason::MTIME);
+	EXPECT_EQ(result.plan[1].why, sync_action::reason::SIZE);
+	EXPECT_EQ(result.plan[2].what, sync_action::kind::MKDIR);
+	EXPECT_EQ(result.plan[3].why, sync_action::reason::MISSING);
+	EXPECT_EQ(result.plan[3].source_path, fspath{ "/s/d/e" });
+	EXPECT_EQ(result.plan[3].size, 3u);
+	EXPECT_TRUE(result.copies.empty());
+	EXPECT_TRUE(dest.mkdirs.empty());
+
+	// The same, for real
+	opts.dry_run = false;
+	result       = sync_tree(make_access, "/s", "/t", opts);
+	EXPECT_EQ(result.plan.size(), 4u);
+	EXPECT_EQ(dest.mkdirs, (std::vector<fspath>{ "/t/d" }));
+	ASSERT_EQ(result.copies.size(), 3u);
+	for (const auto& status : result.copies)
+	{
+		EXPECT_TRUE(status.result);
+	}
+	EXPECT_EQ(result.copies[2].result->dest_path, fspath{ "/t/d/e" });
+}
+
+TEST(SyncTreeTests, test_checksum)
+{
+	auto source = tree{};
+	auto dest   = tree{};
+
+	// The destination files are newer, but one has different contents
+	source.dirs["/s"]       = { make_entry("a", attributes::filetype::REG, 3u, t0 + std::chrono::seconds{ 10 }),
+		                        make_entry("b", attributes::filetype::REG, 3u, t0 + std::chrono::seconds{ 10 }) };
+	source.contents["/s/a"] = "xyz";
+	source.contents["/s/b"] = "abc";
+	dest.dirs["/t"]         = { make_entry("a", attributes::filetype::REG, 3u, t0), make_entry("b", attributes::filetype::REG, 3u, t0) };
+	dest.contents["/t/a"]   = "xyz";
+	dest.contents["/t/b"]   = "abd";
+
+	auto opts     = sync_options{};
+	opts.checksum = true;
+	opts.dry_run  = true;
+
+	const auto result = sync_tree([&] { return copy_worker_access{ source.make_access(), dest.make_access() }; }, "/s", "/t", opts);
+	ASSERT_EQ(result.plan.size(), 1u);
+	EXPECT_EQ(result.plan[0].dest_path, fspath{ "/t/b" });
+	EXPECT_EQ(result.plan[0].why, sync_action::reason::CHECKSUM);
+}
+
+TEST(SyncTreeTests, test_missing_top)
+{
+	auto source = tree{};
+	auto dest   = tree{};
+
+	source.dirs["/s"] = { make_entry("a", attributes::filetype::REG, 1u, t0) };
+
+	auto opts = sync_options{};
+
+	const auto result = sync_tree([&] { return copy_worker_access{ source.make_access(), dest.make_access() }; }, "/s", "/t", opts);
+	EXPECT_EQ(dest_paths(result.plan), (std::vector<fspath>{ "/t", "/t/a" }));
+	EXPECT_EQ(dest.mkdirs, (std::vector<fspath>{ "/t" }));
+	ASSERT_EQ(result.copies.size(), 1u);
+	EXPECT_TRUE(result.copies[0].result);
+}
+
+TEST(SyncTreeTests, test_type_conflict)
+{
+	auto source = tree{};
+	auto dest   = tree{};
+
+	// A directory where the destination has a file, and a file where it has a directory
+	source.dirs["/s"]   = { make_entry("d", attributes::filetype::DIR, 0u, t0), make_entry("f", attributes::filetype::REG, 3u, t0) };
+	source.dirs["/s/d"] = { make_entry("e", attributes::filetype::REG, 3u, t0) };
+	dest.dirs["/t"]     = { make_entry("d", attributes::filetype::REG, 3u, t0), make_entry("f", attributes::filetype::DIR, 0u, t0) };
+	dest.dirs["/t/f"]   = {};
+
+	auto&&     make_access = [&] { return copy_worker_access{ source.make_access(), dest.make_access() }; };
+	const auto result      = sync_tree(make_access, "/s", "/t", sync_options{});
+	EXPECT_EQ(dest_paths(result.plan), (std::vector<fspath>{ "/t/d", "/t/f" }));
+	for (const auto& action : result.plan)
+	{
+		EXPECT_EQ(action.what, sync_action::kind::CONFLICT);
+		EXPECT_EQ(action.why, sync_action::reason::TYPE);
+	}
+	EXPECT_TRUE(dest.mkdirs.empty());
+	EXPECT_TRUE(result.copies.empty());
+}
+
+TEST(SyncTreeTests, test_preserved_mtime)
+{
+	auto source = tree{};
+	auto dest   = tree{};
+
+	// With preserved modification times, an older destination file is also out of date
+	source.dirs["/s"] = { make_entry("a", attributes::filetype::REG, 3u, t0), make_entry("b", attributes::filetype::REG, 3u, t0) };
+	dest.dirs["/t"]   = { make_entry("a", attributes::filetype::REG, 3u, t0 + std::chrono::seconds{ 5 }),
+		                  make_entry("b", attributes::filetype::REG, 3u, t0 + std::chrono::milliseconds{ 500 }) };
+
+	auto opts                     = sync_options{};
+	opts.dry_run                  = true;
+	opts.copy.copy.preserve_mtime = true;
+
+	auto&& make_access = [&] { return copy_worker_access{ source.make_access(), dest.make_access() }; };
+	auto   result      = sync_tree(make_access, "/s", "/t", opts);
+	ASSERT_EQ(result.plan.size(), 1u);
+	EXPECT_EQ(result.plan[0].dest_path, fspath{ "/t/a" });
+	EXPECT_EQ(result.plan[0].why, sync_action::reason::MTIME);
+
+	opts.copy.copy.preserve_mtime = false;
+	result                        = sync_tree(make_access, "/s", "/t", opts);
+	EXPECT_TRUE(result.plan.empty());
+}
+
+TEST(SyncTreeTests, test_list_error)
+{
+	auto source = tree{};
+	auto dest   = tree{};
+
+	// "/s" cannot be listed
+	auto&& make_access = [&] { return copy_worker_access{ source.make_access(), dest.make_access() }; };
+	EXPECT_ANY_THROW(sync_tree(make_access, "/s", "/t", sync_options{}));
+}
+
+} // namespace flexfs
@@ -0,0 +1,169 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "mock_access.h"
+#include "mock_file.h"
+#include "flexfs/core/tee_copy.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace flexfs {
+
+namespace {
+
+const auto data = std::string{ "The quick brown fox jumps over the lazy dog" };
+
+// A source access with a file that yields data a few bytes at a time
+void expect_source(nice_mock_access& access, const source& src)
+{
+	auto file = std::make_unique<nice_mock_file>();
+	ON_CALL(*file, read(testing::NotNull(), testing::_)).WillByDefault([offset = std::size_t{}](void* buf, std::size_t count) mutable {
+		const auto n = std::min({ count, std::size_t{ 5u }, data.size() - offset });
+		std::memcpy(buf, data.data() + offset, n);
+		offset += n;
+		return n;
+	});
+	ON_CALL(access, stat(testing::Eq(src.current_path))).WillByDefault([](const fspath&) {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		a.size = data.size();
+		return a;
+	});
+	EXPECT_CALL(access, open(testing::Eq(src.current_path), O_RDONLY | O_BINARY, 0))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(file))));
+}
+
+// A destination access that collects what is written to path in written
+std::shared_ptr<nice_mock_access> make_dest_access(const fspath& path, std::string& written)
+{
+	auto access = std::make_shared<nice_mock_access>();
+	auto file   = std::make_unique<nice_mock_file>();
+	ON_CALL(*file, write(testing::NotNull(), testing::_)).WillByDefault([&written](const void* buf, std::size_t count) {
+		written.append(static_cast<const char*>(buf), count);
+		return count;
+	});
+	EXPECT_CALL(*access, try_create(testing::Eq(path), O_WRONLY | O_BINARY, 0664))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(file))));
+	return access;
+}
+
+destination make_destination(const fspath& path)
+{
+	return destination{ path, std::nullopt, false, destination::conflict_policy::FAIL };
+}
+
+} // namespace
+
+TEST(TeeCopyTests, test_tee_copy)
+{
+	auto       source_access = nice_mock_access{};
+	const auto src           = source{ "source" };
+	expect_source(source_access, src);
+
+	auto written = std::vector<std::string>(3u);
+	auto dests   = std::vector<tee_destination>{};
+	for (auto i = std::size_t{}; i < written.size(); ++i)
+	{
+		const auto path = fspath{ "dest" + std::to_string(i) };
+		dests.push_back(tee_destination{ make_dest_access(path, written[i]), make_destination(path) });
+	}
+
+	auto opts         = tee_copy_options{};
+	opts.queue_depth  = 2u;
+	opts.copy.digests = { digest_algorithm::CRC32C };
+
+	auto progress = std::vector<std::uint64_t>{};
+
+	const auto statuses = tee_copy(source_access, src, dests, opts, [&](std::uint64_t n) { progress.push_back(n); });
+	ASSERT_EQ(statuses.size(), 3u);
+
+	auto crc32c = make_digester(digest_algorithm::CRC32C);
+	crc32c->update(data.data(), data.size());
+	for (auto i = std::size_t{}; i < statuses.size(); ++i)
+	{
+		ASSERT_TRUE(statuses[i].result);
+		EXPECT_EQ(statuses[i].result->dest_path, dests[i].dest.path);
+		EXPECT_EQ(statuses[i].result->size, data.size());
+		EXPECT_EQ(statuses[i].result->digests, std::vector<digest>{ crc32c->value() });
+		EXPECT_EQ(written[i], data);
+	}
+	ASSERT_FALSE(progress.empty());
+	EXPECT_EQ(progress.back(), data.size());
+}
+
+TEST(TeeCopyTests, test_tee_copy_destination_fails)
+{
+	auto       source_access = nice_mock_access{};
+	const auto src           = source{ "source" };
+	expect_source(source_access, src);
+
+	auto written = std::string{};
+	auto second  = std::make_shared<nice_mock_access>();
+	auto third   = std::make_shared<nice_mock_access>();
+	auto dests   = std::vector<tee_destination>{};
+	dests.push_back(tee_destination{ make_dest_access("dest0", written), make_destination("dest0") });
+	dests.push_back(tee_destination{ second, make_destination("dest1") });
+	dests.push_back(tee_destination{ third, make_destination("dest2") });
+
+	// The second destination cannot be written, the third one cannot be created
+	auto failing = std::make_unique<nice_mock_file>();
+	EXPECT_CALL(*failing, write(testing::_, testing::_)).WillOnce(testing::Throw(std::runtime_error{ "disk full" }));
+	EXPECT_CALL(*second, try_create(testing::_, testing::_, testing::_)).WillOnce(testing::Return(testing::ByMove(std::move(failing))));
+	EXPECT_CALL(*third, try_create(testing::_, testing::_, testing::_)).WillOnce(testing::Throw(std::runtime_error{ "no access" }));
+
+	auto opts        = tee_copy_options{};
+	opts.queue_depth = 1u;
+
+	const auto statuses = tee_copy(source_access, src, dests, opts);
+	ASSERT_EQ(statuses.size(), 3u);
+	ASSERT_TRUE(statuses[0].result);
+	EXPECT_EQ(written, data);
+	EXPECT_FALSE(statuses[1].result);
+	EXPECT_TRUE(statuses[1].error);
+	EXPECT_FALSE(statuses[2].result);
+	EXPECT_TRUE(statuses[2].error);
+}
+
+TEST(TeeCopyTests, test_tee_copy_read_error)
+{
+	auto       source_access = nice_mock_access{};
+	const auto src           = source{ "source" };
+
+	auto file = std::make_unique<nice_mock_file>();
+	EXPECT_CALL(*file, read(testing::_, testing::_))
+	    .WillOnce(testing::Return(1u))
+	    .WillOnce(testing::Throw(std::runtime_error{ "I/O error" }));
+	ON_CALL(source_access, stat(testing::_)).WillByDefault([](const fspath&) {
+		auto a = attributes{};
+		a.set_mode(S_IFREG | 0664);
+		return a;
+	});
+	EXPECT_CALL(source_access, open(testing::Eq(src.current_path), testing::_, testing::_))
+	    .WillOnce(testing::Return(testing::ByMove(std::move(file))));
+
+	auto written = std::vector<std::string>(2u);
+	auto dests   = std::vector<tee_destination>{};
+	for (auto i = std::size_t{}; i < written.size(); ++i)
+	{
+		const auto path = fspath{ "dest" + std::to_string(i) };
+		dests.push_back(tee_destination{ make_dest_access(path, written[i]), make_destination(path) });
+	}
+
+	const auto statuses = tee_copy(source_access, src, dests, tee_copy_options{});
+	ASSERT_EQ(statuses.size(), 2u);
+	for (const auto& status : statuses)
+	{
+		EXPECT_FALSE(status.result);
+		EXPECT_TRUE(status.error);
+	}
+}
+
+} // namespace flexfs
@@ -0,0 +1,384 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/core/xxh3.h"
+#include <algorithm>
+#include <cstring>
+
+#if FLEXFS_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+// Implementation of the XXH3 algorithm as specified by xxHash (https://github.com/Cyan4973/xxHash),
+// limited to the 64 bit variant with the default secret and seed.
+
+namespace flexfs {
+
+namespace {
+
+constexpr auto prime32_1 = std::uint64_t{ 0x9e3779b1u };
+constexpr auto prime32_2 = std::uint64_t{ 0x85ebca77u };
+constexpr auto prime32_3 = std::uint64_t{ 0xc2b2ae3du };
+constexpr auto prime64_1 = std::uint64_t{ 0x9e3779b185ebca87u };
+constexpr auto prime64_2 = std::uint64_t{ 0xc2b2ae3d27d4eb4fu };
+constexpr auto prime64_3 = std::uint64_t{ 0x165667b19e3779f9u };
+constexpr auto prime64_4 = std::uint64_t{ 0x85ebca77c2b2ae63u };
+constexpr auto prime64_5 = std::uint64_t{ 0x27d4eb2f165667c5u };
+constexpr auto prime_mx1 = std::uint64_t{ 0x165667919e3779f9u };
+constexpr auto prime_mx2 = std::uint64_t{ 0x9fb21c651e98df25u };
+
+constexpr std::uint8_t secret[192] = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c, //
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, //
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21, //
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c, //
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, //
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8, //
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d, //
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, //
+	0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb, //
+	0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e, //
+	0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, //
+	0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e, //
+};
+
+constexpr auto secret_consume_rate = std::size_t{ 8u };
+constexpr auto stripes_per_block   = (sizeof(secret) - xxh3_digester::stripe_size) / secret_consume_rate;
+constexpr auto midsize_max         = std::size_t{ 240u };
+
+static_assert(xxh3_digester::buffer_size > midsize_max);
+
+std::uint32_t read32(const std::uint8_t* p)
+{
+	auto v = std::uint32_t{};
+	std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+std::uint64_t read64(const std::uint8_t* p)
+{
+	auto v = std::uint64_t{};
+	std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+std::uint64_t rotl64(std::uint64_t v, int r)
+{
+	return (v << r) | (v >> (64 - r));
+}
+
+std::uint64_t swap64(std::uint64_t v)
+{
+	return ((v << 56) & 0xff00000000000000u) | ((v << 40) & 0x00ff000000000000u) | ((v << 24) & 0x0000ff0000000000u) |
+	       ((v << 8) & 0x000000ff00000000u) | ((v >> 8) & 0x00000000ff000000u) | ((v >> 24) & 0x0000000000ff0000u) |
+	       ((v >> 40) & 0x000000000000ff00u) | ((v >> 56) & 0x00000000000000ffu);
+}
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 uint128;
+#endif
+
+std::uint64_t mul128_fold64(std::uint64_t lhs, std::uint64_t rhs)
+{
+#if defined(__SIZEOF_INT128__)
+	const auto product = static_cast<uint128>(lhs) * rhs;
+	return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+#else
+	const auto lo_lo = (lhs & 0xffffffffu) * (rhs & 0xffffffffu);
+	const auto hi_lo = (lhs >> 32) * (rhs & 0xffffffffu);
+	const auto lo_hi = (lhs & 0xffffffffu) * (rhs >> 32);
+	const auto hi_hi = (lhs >> 32) * (rhs >> 32);
+	const auto cross = (lo_lo >> 32) + (hi_lo & 0xffffffffu) + lo_hi;
+	const auto upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+	const auto lower = (cross << 32) | (lo_lo & 0xffffffffu);
+	return lower ^ upper;
+#endif
+}
+
+std::uint64_t xxh64_avalanche(std::uint64_t h)
+{
+	h ^= h >> 33;
+	h *= prime64_2;
+	h ^= h >> 29;
+	h *= prime64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+std::uint64_t avalanche(std::uint64_t h)
+{
+	h ^= h >> 37;
+	h *= prime_mx1;
+	h ^= h >> 32;
+	return h;
+}
+
+std::uint64_t rrmxmx(std::uint64_t h, std::uint64_t len)
+{
+	h ^= rotl64(h, 49) ^ rotl64(h, 24);
+	h *= prime_mx2;
+	h ^= (h >> 35) + len;
+	h *= prime_mx2;
+	return h ^ (h >> 28);
+}
+
+std::uint64_t mix16(const std::uint8_t* input, const std::uint8_t* sec)
+{
+	return mul128_fold64(read64(input) ^ read64(sec), read64(input + 8) ^ read64(sec + 8));
+}
+
+std::uint64_t hash_short(const std::uint8_t* input, std::size_t len)
+{
+	if (len == 0u)
+	{
+		return xxh64_avalanche(read64(secret + 56) ^ read64(secret + 64));
+	}
+	else if (len <= 3u)
+	{
+		const auto combined = (std::uint32_t{ input[0] } << 16) | (std::uint32_t{ input[len >> 1] } << 24) |
+		                      std::uint32_t{ input[len - 1] } | (static_cast<std::uint32_t>(len) << 8);
+		return xxh64_avalanche(std::uint64_t{ combined } ^ (read32(secret) ^ read32(secret + 4)));
+	}
+	else if (len <= 8u)
+	{
+		const auto input64 = read32(input + len - 4) + (std::uint64_t{ read32(input) } << 32);
+		return rrmxmx(input64 ^ (read64(secret + 8) ^ read64(secret + 16)), len);
+	}
+	else if (len <= 16u)
+	{
+		const auto lo = read64(input) ^ (read64(secret + 24) ^ read64(secret + 32));
+		const auto hi = read64(input + len - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+		return avalanche(len + swap64(lo) + hi + mul128_fold64(lo, hi));
+	}
+	else if (len <= 128u)
+	{
+		auto acc = len * prime64_1;
+		if (len > 32u)
+		{
+			if (len > 64u)
+			{
+				if (len > 96u)
+				{
+					acc += mix16(input + 48, secret + 96);
+					acc += mix16(input + len - 64, secret + 112);
+				}
+				acc += mix16(input + 32, secret + 64);
+				acc += mix16(input + len - 48, secret + 80);
+			}
+			acc += mix16(input + 16, secret + 32);
+			acc += mix16(input + len - 32, secret + 48);
+		}
+		acc += mix16(input, secret);
+		acc += mix16(input + len - 16, secret + 16);
+		return avalanche(acc);
+	}
+	else
+	{
+		constexpr auto start_offset = std::size_t{ 3u };
+		constexpr auto last_offset  = std::size_t{ 17u };
+
+		auto acc = len * prime64_1;
+		for (auto i = std::size_t{}; i < 8u; ++i)
+		{
+			acc += mix16(input + 16 * i, secret + 16 * i);
+		}
+		acc          = avalanche(acc);
+		auto acc_end = mix16(input + len - 16, secret + 136 - last_offset);
+		for (auto i = std::size_t{ 8u }; i < len / 16u; ++i)
+		{
+			acc_end += mix16(input + 16 * i, secret + 16 * (i - 8) + start_offset);
+		}
+		return avalanche(acc + acc_end);
+	}
+}
+
+void accumulate_scalar(std::uint64_t* acc, const std::uint8_t* input, const std::uint8_t* sec)
+{
+	for (auto lane = std::size_t{}; lane < 8u; ++lane)
+	{
+		const auto data_val = read64(input + lane * 8);
+		const auto data_key = data_val ^ read64(sec + lane * 8);
+		acc[lane ^ 1] += data_val;
+		acc[lane] += (data_key & 0xffffffffu) * (data_key >> 32);
+	}
+}
+
+void scramble_scalar(std::uint64_t* acc, const std::uint8_t* sec)
+{
+	for (auto lane = std::size_t{}; lane < 8u; ++lane)
+	{
+		auto a = acc[lane];
+		a ^= a >> 47;
+		a ^= read64(sec + lane * 8);
+		a *= prime32_1;
+		acc[lane] = a;
+	}
+}
+
+#if FLEXFS_X86_DISPATCH
+FLEXFS_TARGET("avx2") void accumulate_avx2(std::uint64_t* acc, const std::uint8_t* input, const std::uint8_t* sec)
+{
+	for (auto i = 0; i < 2; ++i)
+	{
+		const auto xacc     = reinterpret_cast<__m256i*>(acc) + i;
+		const auto data_vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input) + i);
+		const auto key_vec  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sec) + i);
+		const auto data_key = _mm256_xor_si256(data_vec, key_vec);
+		const auto product  = _mm256_mul_epu32(data_key, _mm256_srli_epi64(data_key, 32));
+		const auto swapped  = _mm256_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+		_mm256_store_si256(xacc, _mm256_add_epi64(product, _mm256_add_epi64(_mm256_load_si256(xacc), swapped)));
+	}
+}
+
+FLEXFS_TARGET("avx2") void scramble_avx2(std::uint64_t* acc, const std::uint8_t* sec)
+{
+	const auto prime = _mm256_set1_epi32(static_cast<int>(prime32_1));
+	for (auto i = 0; i < 2; ++i)
+	{
+		const auto xacc     = reinterpret_cast<__m256i*>(acc) + i;
+		const auto acc_vec  = _mm256_load_si256(xacc);
+		const auto data_vec = _mm256_xor_si256(acc_vec, _mm256_srli_epi64(acc_vec, 47));
+		const auto data_key = _mm256_xor_si256(data_vec, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sec) + i));
+		const auto prod_lo  = _mm256_mul_epu32(data_key, prime);
+		const auto prod_hi  = _mm256_mul_epu32(_mm256_srli_epi64(data_key, 32), prime);
+		_mm256_store_si256(xacc, _mm256_add_epi64(prod_lo, _mm256_slli_epi64(prod_hi, 32)));
+	}
+}
+#endif
+
+std::uint64_t merge_accs(const std::uint64_t* acc, const std::uint8_t* sec, std::uint64_t start)
+{
+	auto result = start;
+	for (auto i = std::size_t{}; i < 4u; ++i)
+	{
+		result += mul128_fold64(acc[2 * i] ^ read64(sec + 16 * i), acc[2 * i + 1] ^ read64(sec + 16 * i + 8));
+	}
+	return avalanche(result);
+}
+
+} // namespace
+
+xxh3_digester::xxh3_digester(const cpu_features& cpu)
+    : avx2_{ cpu.avx2 }
+    , acc_{ prime32_3, prime64_1, prime64_2, prime64_3, prime64_4, prime32_2, prime64_5, prime32_1 }
+    , stripes_{}
+    , total_{}
+    , buffered_{}
+    , buffer_{}
+    , last_stripe_{}
+{
+}
+
+// Accumulates count stripes. A stripe is only accumulated when more input follows it, the final stripe of
+// the input is processed differently.
+void xxh3_digester::consume(std::uint64_t* acc, std::size_t& stripes, const std::uint8_t* input, std::size_t count) const
+{
+	for (; count; --count, input += stripe_size)
+	{
+#if FLEXFS_X86_DISPATCH
+		if (this->avx2_)
+		{
+			accumulate_avx2(acc, input, secret + stripes * secret_consume_rate);
+			if (++stripes == stripes_per_block)
+			{
+				scramble_avx2(acc, secret + sizeof(secret) - stripe_size);
+				stripes = 0u;
+			}
+			continue;
+		}
+#endif
+		accumulate_scalar(acc, input, secret + stripes * secret_consume_rate);
+		if (++stripes == stripes_per_block)
+		{
+			scramble_scalar(acc, secret + sizeof(secret) - stripe_size);
+			stripes = 0u;
+		}
+	}
+}
+
+void xxh3_digester::update(const void* data, std::size_t size)
+{
+	auto input = static_cast<const std::uint8_t*>(data);
+	this->total_ += size;
+
+	while (size)
+	{
+		if (this->buffered_ == buffer_size)
+		{
+			// More input follows, so the buffered stripes can be accumulated.
+			this->consume(this->acc_, this->stripes_, this->buffer_, buffer_size / stripe_size);
+			std::memcpy(this->last_stripe_, this->buffer_ + buffer_size - stripe_size, stripe_size);
+			this->buffered_ = 0u;
+		}
+		if (this->buffered_ == 0u && size > buffer_size)
+		{
+			// Accumulate directly from the input, keeping at least one byte for the final stripe.
+			const auto count = (size - 1u) / stripe_size;
+			this->consume(this->acc_, this->stripes_, input, count);
+			std::memcpy(this->last_stripe_, input + (count - 1u) * stripe_size, stripe_size);
+			input += count * stripe_size;
+			size -= count * stripe_size;
+		}
+		const auto n = std::min(size, buffer_size - this->buffered_);
+		std::memcpy(this->buffer_ + this->buffered_, input, n);
+		this->buffered_ += n;
+		input += n;
+		size -= n;
+	}
+}
+
+digest xxh3_digester::value() const
+{
+	auto h = std::uint64_t{};
+	if (this->total_ <= midsize_max)
+	{
+		h = hash_short(this->buffer_, static_cast<std::size_t>(this->total_));
+	}
+	else
+	{
+		alignas(32) std::uint64_t acc[8];
+		std::memcpy(acc, this->acc_, sizeof(acc));
+		auto stripes = this->stripes_;
+
+		// All but the final stripe of the buffered data.
+		this->consume(acc, stripes, this->buffer_, (this->buffered_ - 1u) / stripe_size);
+
+		// The final stripe consists of the last 64 bytes of the input, which may extend into the last stripe
+		// that was already accumulated.
+		std::uint8_t final_stripe[stripe_size];
+		if (this->buffered_ >= stripe_size)
+		{
+			std::memcpy(final_stripe, this->buffer_ + this->buffered_ - stripe_size, stripe_size);
+		}
+		else
+		{
+			const auto from_last = stripe_size - this->buffered_;
+			std::memcpy(final_stripe, this->last_stripe_ + this->buffered_, from_last);
+			std::memcpy(final_stripe + from_last, this->buffer_, this->buffered_);
+		}
+		constexpr auto last_acc_start = std::size_t{ 7u };
+		accumulate_scalar(acc, final_stripe, secret + sizeof(secret) - stripe_size - last_acc_start);
+
+		constexpr auto merge_accs_start = std::size_t{ 11u };
+		h = merge_accs(acc, secret + merge_accs_start, this->total_ * prime64_1);
+	}
+
+	auto result = digest{ digest_algorithm::XXH3_64, std::vector<std::uint8_t>(8u) };
+	for (auto i = 0; i < 8; ++i)
+	{
+		result.value[i] = static_cast<std::uint8_t>(h >> (56 - 8 * i));
+	}
+	return result;
+}
+
+} // namespace flexfs
@@ -0,0 +1,41 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/digest.h"
+#include "flexfs/core/cpu_features.h"
+
+namespace flexfs {
+
+// XXH3 64 bit hash (seed 0, default secret), compatible with XXH3_64bits() of xxHash 0.8.
+// The accumulation loop uses AVX2 when available.
+class xxh3_digester final : public i_digester
+{
+public:
+	static constexpr std::size_t stripe_size = 64u;
+	static constexpr std::size_t buffer_size = 4u * stripe_size;
+
+private:
+	bool                        avx2_;
+	alignas(32) std::uint64_t   acc_[8];
+	std::size_t                 stripes_;  // number of stripes accumulated in the current block
+	std::uint64_t               total_;    // number of bytes passed to update()
+	std::size_t                 buffered_; // number of bytes in buffer_
+	std::uint8_t                buffer_[buffer_size];
+	std::uint8_t                last_stripe_[stripe_size]; // last stripe accumulated, the final stripe may overlap it
+
+	void consume(std::uint64_t* acc, std::size_t& stripes, const std::uint8_t* input, std::size_t count) const;
+
+public:
+	explicit xxh3_digester(const cpu_features& cpu = cpu_features::get());
+
+	void   update(const void* data, std::size_t size) override;
+	digest value() const override;
+};
+
+} // namespace flexfs
@@ -9,14 +9,29 @@
 #include "flexfs/core/exceptions.h"
 #include <boost/filesystem/operations.hpp>
 #include <boost/scoped_array.hpp>
+#include <algorithm>
+#include <memory>
 #include <optional>
 #include <chrono>
+#include <vector>
+#include <cstddef>
 
 //#define BOOST_STACKTRACE_USE_BACKTRACE
 #include <boost/stacktrace.hpp>
 
 #ifdef BOOST_WINDOWS_API
 #include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+#endif
+#ifdef __linux__
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #endif
 
 #ifdef BOOST_WINDOWS_API
@@ -30,6 +45,27 @@
 namespace flexfs {
 namespace local {
 
+namespace {
+
+// Amount read at once to compute digests, the interruptor is checked in between
+constexpr auto checksum_chunk_size = std::size_t{ 1024u * 1024u };
+
+int open_fd(const fspath& path, int flags, mode_t mode)
+{
+	fslog(trace, "open path={} flags={:o} mode={:o}", path, flags, mode);
+	auto fd = c_open(path.string().c_str(), flags, mode);
+	if (fd == -1 && errno == EINVAL && (flags & O_DIRECT))
+	{
+		// The file system does not support direct I/O
+		fslog(debug, "O_DIRECT not supported for {}, falling back to buffered I/O", path);
+		fd = c_open(path.string().c_str(), flags & ~O_DIRECT, mode);
+	}
+	fslog(trace, "fd {}", fd);
+	return fd;
+}
+
+} // namespace
+
 access::access(std::shared_ptr<i_interruptor> interruptor)
     : interruptor_{ interruptor }
 {
@@ -163,13 +199,100 @@ void access::rename(const fspath& oldpath, const fspath& newpath)
 	}
 }
 
+bool access::try_rename(const fspath& oldpath, const fspath& newpath)
+{
+	this->interruptor_->throw_if_interrupted();
+
+	fslog(trace, "rename noreplace oldpath={} newpath={}", oldpath, newpath);
+#ifdef BOOST_WINDOWS_API
+	// MoveFileEx does not replace an existing file without MOVEFILE_REPLACE_EXISTING
+	if (::MoveFileExW(oldpath.c_str(), newpath.c_str(), 0))
+	{
+		return true;
+	}
+	const auto err = ::GetLastError();
+	if (err == ERROR_ALREADY_EXISTS || err == ERROR_FILE_EXISTS)
+	{
+		return false;
+	}
+	FLEXFS_THROW(system_exception(std::error_code{ static_cast<int>(err), std::system_category() })
+	             << error_oldpath{ oldpath } << error_newpath{ newpath } << error_opname{ "MoveFileEx" });
+#else
+#ifdef __linux__
+	if (::renameat2(AT_FDCWD, oldpath.c_str(), AT_FDCWD, newpath.c_str(), RENAME_NOREPLACE) == 0)
+	{
+		return true;
+	}
+	else if (errno == EEXIST)
+	{
+		return false;
+	}
+	else if (errno != EINVAL && errno != ENOSYS)
+	{
+		FLEXFS_THROW(system_exception{} << error_oldpath{ oldpath } << error_newpath{ newpath } << error_opname{ "renameat2" });
+	}
+	// The file system does not support RENAME_NOREPLACE
+#endif
+	// A hard link cannot replace newpath either
+	if (::link(oldpath.c_str(), newpath.c_str()) == 0)
+	{
+		if (::unlink(oldpath.c_str()) == -1)
+		{
+			THROW_PATH_OP_ERROR(oldpath, "unlink");
+		}
+		return true;
+	}
+	else if (errno == EEXIST)
+	{
+		return false;
+	}
+
+	// No hard links here, e.g. for a directory or on a FAT file system. Not atomic.
+	fslog(debug, "link {} failed: {}, checking {} before renaming", oldpath, system_exception::getLastErrorCode().message(), newpath);
+	if (this->exists(newpath))
+	{
+		return false;
+	}
+	this->rename(oldpath, newpath);
+	return true;
+#endif
+}
+
+bool access::try_link(const fspath& oldpath, const fspath& newpath)
+{
+	this->interruptor_->throw_if_interrupted();
+
+	fslog(trace, "link oldpath={} newpath={}", oldpath, newpath);
+#ifdef BOOST_WINDOWS_API
+	if (::CreateHardLinkW(newpath.c_str(), oldpath.c_str(), nullptr))
+	{
+		return true;
+	}
+	const auto err = ::GetLastError();
+	if (err == ERROR_ALREADY_EXISTS || err == ERROR_FILE_EXISTS)
+	{
+		return false;
+	}
+	FLEXFS_THROW(system_exception(std::error_code{ static_cast<int>(err), std::system_category() })
+	             << error_oldpath{ oldpath } << error_newpath{ newpath } << error_opname{ "CreateHardLink" });
+#else
+	if (::link(oldpath.c_str(), newpath.c_str()) == 0)
+	{
+		return true;
+	}
+	else if (errno == EEXIST)
+	{
+		return false;
+	}
+	FLEXFS_THROW(system_exception{} << error_oldpath{ oldpath } << error_newpath{ newpath } << error_opname{ "link" });
+#endif
+}
+
 std::unique_ptr<i_file> access::open(const fspath& path, int flags, mode_t mode)
 {
 	this->interruptor_->throw_if_interrupted();
 
-	fslog(trace, "open path={} flags={:o} mode={:o}", path, flags, mode);
-	const auto fd = c_open(path.string().c_str(), flags, mode);
-	fslog(trace, "fd {}", fd);
+	const auto fd = open_fd(path, flags, mode);
 	if (fd == -1)
 	{
 		THROW_PATH_OP_ERROR(path, "open");
@@ -180,11 +303,211 @@ std::unique_ptr<i_file> access::open(const fspath& path, int flags, mode_t mode)
 	}
 }
 
+std::unique_ptr<i_file> access::try_create(const fspath& path, int flags, mode_t mode)
+{
+	this->interruptor_->throw_if_interrupted();
+
+	const auto fd = open_fd(path, flags | O_CREAT | O_EXCL, mode);
+	if (fd != -1)
+	{
+		return std::make_unique<file>(fd, path, this->interruptor_);
+	}
+	else if (errno == EEXIST)
+	{
+		return nullptr;
+	}
+	else
+	{
+		THROW_PATH_OP_ERROR(path, "open");
+	}
+}
+
+std::unique_ptr<mapped_file> access::open_mapped(const fspath& path, mapped_file::advice adv)
+{
+	this->interruptor_->throw_if_interrupted();
+
+	fslog(trace, "open_mapped path={}", path);
+	const auto fd = c_open(path.string().c_str(), O_RDONLY | O_BINARY, 0);
+	fslog(trace, "fd {}", fd);
+	if (fd == -1)
+	{
+		THROW_PATH_OP_ERROR(path, "open");
+	}
+	else
+	{
+		return std::make_unique<mapped_file>(fd, path, adv, this->interruptor_);
+	}
+}
+
 std::shared_ptr<i_watcher> access::create_watcher(const fspath& dir, int cancelfd)
 {
 	return std::make_shared<watcher>(dir, cancelfd);
 }
 
+std::optional<digest> access::checksum(const fspath& path, digest_algorithm algorithm)
+{
+	return this->checksums(path, { algorithm }).front();
+}
+
+std::vector<std::optional<digest>> access::checksums(const fspath& path, const std::vector<digest_algorithm>& algorithms)
+{
+	auto digesters = std::vector<std::unique_ptr<i_digester>>{};
+	for (const auto algorithm : algorithms)
+	{
+		digesters.push_back(make_digester(algorithm));
+	}
+
+	// Read rather than mapped, a mapping of a file that is truncated meanwhile faults (SIGBUS) when read
+	const auto file = this->open(path, O_RDONLY | O_BINARY, 0);
+	auto       buf  = std::vector<char>(checksum_chunk_size);
+	for (auto nread = file->read(buf.data(), buf.size()); nread; nread = file->read(buf.data(), buf.size()))
+	{
+		for (const auto& digester : digesters)
+		{
+			digester->update(buf.data(), nread);
+		}
+	}
+
+	auto result = std::vector<std::optional<digest>>{};
+	for (const auto& digester : digesters)
+	{
+		result.push_back(digester->value());
+	}
+	return result;
+}
+
+void access::set_metadata(const fspath& path, std::optional<mode_t> perms, std::optional<std::chrono::system_clock::time_point> mtime)
+{
+	this->interruptor_->throw_if_interrupted();
+
+	if (perms)
+	{
+		fslog(trace, "chmod path={} mode={:o}", path, perms.value() & 07777);
+		auto ec = boost::system::error_code{};
+		boost::filesystem::permissions(path, static_cast<boost::filesystem::perms>(perms.value() & 07777), ec);
+		if (ec.failed())
+		{
+			FLEXFS_THROW(system_exception(std::error_code{ ec }) << error_path{ path } << error_opname{ "chmod" });
+		}
+	}
+
+	if (mtime)
+	{
+#ifdef BOOST_WINDOWS_API
+		fslog(trace, "last_write_time path={}", path);
+		auto ec = boost::system::error_code{};
+		boost::filesystem::last_write_time(path, std::chrono::system_clock::to_time_t(mtime.value()), ec);
+		if (ec.failed())
+		{
+			FLEXFS_THROW(system_exception(std::error_code{ ec }) << error_path{ path } << error_opname{ "last_write_time" });
+		}
+#else
+		const auto since_epoch = mtime->time_since_epoch();
+		const auto seconds     = std::chrono::floor<std::chrono::seconds>(since_epoch);
+
+		struct timespec times[2];
+		times[0].tv_sec  = 0;
+		times[0].tv_nsec = UTIME_NOW;
+		times[1].tv_sec  = static_cast<time_t>(seconds.count());
+		times[1].tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - seconds).count());
+		fslog(trace, "utimensat path={} mtime={}.{:09}", path, times[1].tv_sec, times[1].tv_nsec);
+		if (::utimensat(AT_FDCWD, path.c_str(), times, 0) == -1)
+		{
+			THROW_PATH_OP_ERROR(path, "utimensat");
+		}
+#endif
+	}
+}
+
+bool access::sync_fs(const fspath& path)
+{
+	this->interruptor_->throw_if_interrupted();
+#ifdef __linux__
+	const auto fd = open_fd(path, O_RDONLY | O_CLOEXEC, 0);
+	if (fd == -1)
+	{
+		THROW_PATH_OP_ERROR(path, "open");
+	}
+	fslog(trace, "syncfs fd={}", fd);
+	const auto rc    = ::syncfs(fd);
+	const auto error = errno;
+	::close(fd);
+	if (rc == -1)
+	{
+		errno = error;
+		THROW_PATH_OP_ERROR(path, "syncfs");
+	}
+	return true;
+#else
+	(void)path;
+	return false;
+#endif
+}
+
+std::optional<std::uint64_t> access::disk_position(const fspath& path, position_kind kind)
+{
+	this->interruptor_->throw_if_interrupted();
+	switch (kind)
+	{
+	case position_kind::INODE:
+	{
+#ifdef BOOST_POSIX_API
+		struct ::stat st
+		{
+		};
+		if (::stat(path.c_str(), &st) == -1)
+		{
+			THROW_PATH_OP_ERROR(path, "stat");
+		}
+		return st.st_ino;
+#else
+		break;
+#endif
+	}
+	case position_kind::EXTENT:
+	{
+#ifdef __linux__
+		const auto fd = open_fd(path, O_RDONLY | O_CLOEXEC, 0);
+		if (fd == -1)
+		{
+			THROW_PATH_OP_ERROR(path, "open");
+		}
+
+		// Room for the first extent only
+		alignas(fiemap) std::byte buf[sizeof(fiemap) + sizeof(fiemap_extent)]{};
+		const auto map       = reinterpret_cast<fiemap*>(buf);
+		map->fm_length       = FIEMAP_MAX_OFFSET;
+		map->fm_extent_count = 1u;
+
+		fslog(trace, "fiemap fd={}", fd);
+		const auto rc    = ::ioctl(fd, FS_IOC_FIEMAP, map);
+		const auto error = errno;
+		::close(fd);
+		if (rc == -1)
+		{
+			if (error == EOPNOTSUPP || error == ENOTTY)
+			{
+				// The file system does not map extents
+				return std::nullopt;
+			}
+			errno = error;
+			THROW_PATH_OP_ERROR(path, "fiemap");
+		}
+		if (map->fm_mapped_extents == 0u || (map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN))
+		{
+			// No data, or not allocated yet
+			return std::nullopt;
+		}
+		return map->fm_extents[0].fe_physical;
+#else
+		break;
+#endif
+	}
+	}
+	(void)path;
+	return std::nullopt;
+}
+
 direntry access::get_direntry(const fspath& path)
 {
 	return make_direntry(boost::filesystem::directory_entry{ path });
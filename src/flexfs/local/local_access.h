@@ -3,6 +3,7 @@
 #include "flexfs/core/api.h"
 #include "flexfs/core/i_access.h"
 #include "flexfs/core/i_interruptor.h"
+#include "flexfs/local/local_mapped_file.h"
 #include <optional>
 
 namespace flexfs {
@@ -15,17 +16,33 @@ class FLEXFS_EXPORT access final : public i_access
 public:
 	explicit access(std::shared_ptr<i_interruptor> interruptor);
 
-	bool                       is_remote() const override;
-	std::vector<direntry>      ls(const fspath& dir) override;
-	bool                       exists(const fspath& path) override;
-	std::optional<attributes>  try_stat(const fspath& path) override;
-	attributes                 stat(const fspath& path) override;
-	attributes                 lstat(const fspath& path) override;
-	void                       remove(const fspath& path) override;
-	void                       mkdir(const fspath& path, bool parents) override;
-	void                       rename(const fspath& oldpath, const fspath& newpath) override;
-	std::unique_ptr<i_file>    open(const fspath& path, int flags, mode_t mode) override;
-	std::shared_ptr<i_watcher> create_watcher(const fspath& dir, int cancelfd) override;
+	bool                         is_remote() const override;
+	std::vector<direntry>        ls(const fspath& dir) override;
+	bool                         exists(const fspath& path) override;
+	std::optional<attributes>    try_stat(const fspath& path) override;
+	attributes                   stat(const fspath& path) override;
+	attributes                   lstat(const fspath& path) override;
+	void                         remove(const fspath& path) override;
+	void                         mkdir(const fspath& path, bool parents) override;
+	void                         rename(const fspath& oldpath, const fspath& newpath) override;
+	std::unique_ptr<i_file>      open(const fspath& path, int flags, mode_t mode) override;
+	std::unique_ptr<i_file>      try_create(const fspath& path, int flags, mode_t mode) override;
+	bool                         try_rename(const fspath& oldpath, const fspath& newpath) override;
+	bool                         try_link(const fspath& oldpath, const fspath& newpath) override;
+	std::shared_ptr<i_watcher>   create_watcher(const fspath& dir, int cancelfd) override;
+	std::optional<digest>        checksum(const fspath& path, digest_algorithm algorithm) override; // always available
+	void                         set_metadata(const fspath&                                        path,
+	                                          std::optional<mode_t>                                perms,
+	                                          std::optional<std::chrono::system_clock::time_point> mtime) override;
+	bool                         sync_fs(const fspath& path) override;
+	std::optional<std::uint64_t> disk_position(const fspath& path, position_kind kind) override; // extents on Linux only
+
+	// Always available, the file is read once for all algorithms
+	std::vector<std::optional<digest>> checksums(const fspath& path, const std::vector<digest_algorithm>& algorithms) override;
+
+	/// @brief Open a file read-only through a memory mapping.
+	/// Opt-in alternative to open(path, O_RDONLY, 0) for read-mostly workloads.
+	std::unique_ptr<mapped_file> open_mapped(const fspath& path, mapped_file::advice adv = mapped_file::advice::SEQUENTIAL);
 
 	static direntry get_direntry(const fspath& path);
 };
@@ -3,11 +3,15 @@
 #include "flexfs/core/logging.h"
 
 #include <boost/system/api_config.hpp>
+#include <algorithm>
+#include <limits>
+#include <cerrno>
 
 #ifdef BOOST_WINDOWS_API
 #include <fcntl.h>
 #include <io.h>
 #else
+#include <fcntl.h>
 #include <unistd.h>
 #endif
 
@@ -15,15 +19,45 @@
 #define c_close(fd) ::_close(fd)
 #define c_read(fd, buf, count) ::_read(fd, buf, static_cast<unsigned int>(count))
 #define c_write(fd, buf, count) ::_write(fd, buf, static_cast<unsigned int>(count))
+#define c_lseek(fd, offset, whence) ::_lseeki64(fd, static_cast<__int64>(offset), whence)
+#define c_ftruncate(fd, size) ::_chsize_s(fd, static_cast<__int64>(size))
 #else
 #define c_close(fd) ::close(fd)
 #define c_read(fd, buf, count) ::read(fd, buf, count)
 #define c_write(fd, buf, count) ::write(fd, buf, count)
+#define c_lseek(fd, offset, whence) ::lseek(fd, static_cast<off_t>(offset), whence)
+#define c_ftruncate(fd, size) ::ftruncate(fd, static_cast<off_t>(size))
 #endif
 
 namespace flexfs {
 namespace local {
 
+namespace {
+
+// Largest amount passed to one copy_file_range call.
+constexpr auto copy_chunk_size = std::uint64_t{ 67108864u };
+
+// O_DIRECT requires the buffer address, the transfer size and the file offset to be aligned to the
+// logical block size of the file system, which is typically not the case for the tail of a file.
+// Clears O_DIRECT so that the transfer can be retried with buffered I/O.
+// Returns false if O_DIRECT was not set.
+bool clear_direct_io(int fd)
+{
+#if defined(BOOST_POSIX_API) && O_DIRECT != 0
+	const auto fl = ::fcntl(fd, F_GETFL);
+	if (fl != -1 && (fl & O_DIRECT))
+	{
+		fslog(trace, "clear O_DIRECT fd={}", fd);
+		return ::fcntl(fd, F_SETFL, fl & ~O_DIRECT) != -1;
+	}
+#else
+	(void)fd;
+#endif
+	return false;
+}
+
+} // namespace
+
 file::file(int fd, const fspath& path, std::shared_ptr<i_interruptor> interruptor)
     : fd_{ fd }
     , path_{ path }
@@ -42,6 +76,10 @@ std::size_t file::read(void* buf, std::size_t count)
 	this->interruptor_->throw_if_interrupted();
 	fslog(trace, "read fd={} count={}", this->fd_, count);
 	auto rc = c_read(this->fd_, buf, count);
+	if (rc < 0 && errno == EINVAL && clear_direct_io(this->fd_))
+	{
+		rc = c_read(this->fd_, buf, count);
+	}
 	if (rc < 0)
 	{
 		FLEXFS_THROW(system_exception{} << error_opname{ "read" } << error_path{ this->path_ });
@@ -54,6 +92,10 @@ std::size_t file::write(const void* buf, std::size_t count)
 	this->interruptor_->throw_if_interrupted();
 	fslog(trace, "write fd={} count={}", this->fd_, count);
 	auto rc = c_write(this->fd_, buf, count);
+	if (rc < 0 && errno == EINVAL && clear_direct_io(this->fd_))
+	{
+		rc = c_write(this->fd_, buf, count);
+	}
 	if (rc < 0)
 	{
 		FLEXFS_THROW(system_exception{} << error_opname{ "write" } << error_path{ this->path_ });
@@ -61,5 +103,193 @@ std::size_t file::write(const void* buf, std::size_t count)
 	return static_cast<std::size_t>(rc);
 }
 
+std::uint64_t file::seek(std::uint64_t offset)
+{
+	this->interruptor_->throw_if_interrupted();
+	fslog(trace, "lseek fd={} offset={}", this->fd_, offset);
+	const auto rc = c_lseek(this->fd_, offset, SEEK_SET);
+	if (rc < 0)
+	{
+		FLEXFS_THROW(system_exception{} << error_opname{ "lseek" } << error_path{ this->path_ });
+	}
+	return static_cast<std::uint64_t>(rc);
+}
+
+void file::truncate(std::uint64_t size)
+{
+	// Not interruptible, this is also used to clean up after an interrupted copy.
+	fslog(trace, "ftruncate fd={} size={}", this->fd_, size);
+	if (c_ftruncate(this->fd_, size) != 0)
+	{
+		FLEXFS_THROW(system_exception{} << error_opname{ "ftruncate" } << error_path{ this->path_ });
+	}
+}
+
+std::optional<std::uint64_t> file::seek_data(std::uint64_t offset)
+{
+#ifdef SEEK_DATA
+	fslog(trace, "lseek SEEK_DATA fd={} offset={}", this->fd_, offset);
+	const auto rc = c_lseek(this->fd_, offset, SEEK_DATA);
+	if (rc >= 0)
+	{
+		return static_cast<std::uint64_t>(rc);
+	}
+	else if (errno == ENXIO)
+	{
+		// No more data after offset
+		return std::nullopt;
+	}
+	else if (errno != EINVAL)
+	{
+		FLEXFS_THROW(system_exception{} << error_opname{ "lseek" } << error_path{ this->path_ });
+	}
+	// else: not supported, the whole file is data
+#endif
+	return offset;
+}
+
+std::uint64_t file::seek_hole(std::uint64_t offset)
+{
+#ifdef SEEK_HOLE
+	fslog(trace, "lseek SEEK_HOLE fd={} offset={}", this->fd_, offset);
+	const auto rc = c_lseek(this->fd_, offset, SEEK_HOLE);
+	if (rc >= 0)
+	{
+		return static_cast<std::uint64_t>(rc);
+	}
+	else if (errno == ENXIO)
+	{
+		// offset is beyond the end of the file
+		return offset;
+	}
+	else if (errno != EINVAL)
+	{
+		FLEXFS_THROW(system_exception{} << error_opname{ "lseek" } << error_path{ this->path_ });
+	}
+	// else: not supported, the whole file is data
+#endif
+	return std::numeric_limits<std::uint64_t>::max();
+}
+
+bool file::allocate(std::uint64_t size)
+{
+#ifdef __linux__
+	this->interruptor_->throw_if_interrupted();
+	fslog(trace, "fallocate fd={} size={}", this->fd_, size);
+	// Not posix_fallocate(), which emulates preallocation by writing zeros on file systems that lack support.
+	// The size is kept, so that the file does not show its full size, mostly zeros, before it is written.
+	if (::fallocate(this->fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) == 0)
+	{
+		return true;
+	}
+	else if (errno != EOPNOTSUPP && errno != ENOSYS)
+	{
+		FLEXFS_THROW(system_exception{} << error_opname{ "fallocate" } << error_path{ this->path_ });
+	}
+#else
+	(void)size;
+#endif
+	return false;
+}
+
+bool file::copy_from(i_file& source, std::uint64_t offset, std::uint64_t count, std::uint64_t dest_offset)
+{
+#ifdef __linux__
+	const auto src = dynamic_cast<file*>(&source);
+	if (!src)
+	{
+		return false;
+	}
+
+	// The kernel copies the data, or shares the extents on file systems that support reflinks
+	auto in_offset  = static_cast<off_t>(offset);
+	auto out_offset = static_cast<off_t>(dest_offset);
+	auto copied     = std::uint64_t{};
+	while (copied < count)
+	{
+		this->interruptor_->throw_if_interrupted();
+		// Bounded, to check for interruption now and then
+		const auto chunk = static_cast<std::size_t>(std::min<std::uint64_t>(count - copied, copy_chunk_size));
+		fslog(trace,
+		      "copy_file_range fd={} offset={} count={} dest fd={} dest offset={}",
+		      src->fd_,
+		      in_offset,
+		      chunk,
+		      this->fd_,
+		      out_offset);
+		const auto rc = ::copy_file_range(src->fd_, &in_offset, this->fd_, &out_offset, chunk, 0u);
+		if (rc > 0)
+		{
+			copied += static_cast<std::uint64_t>(rc);
+		}
+		else if (rc == 0)
+		{
+			// end of the source file
+			break;
+		}
+		else if (copied == 0u && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+		{
+			// not supported for this pair of files, e.g. on different file systems before Linux 5.19
+			return false;
+		}
+		else
+		{
+			FLEXFS_THROW(system_exception{} << error_opname{ "copy_file_range" } << error_path{ this->path_ });
+		}
+	}
+	return true;
+#else
+	(void)source;
+	(void)offset;
+	(void)count;
+	(void)dest_offset;
+	return false;
+#endif
+}
+
+bool file::sync(bool wait)
+{
+	this->interruptor_->throw_if_interrupted();
+#ifdef BOOST_WINDOWS_API
+	if (wait)
+	{
+		fslog(trace, "commit fd={}", this->fd_);
+		if (::_commit(this->fd_) == -1)
+		{
+			FLEXFS_THROW(system_exception{} << error_opname{ "commit" } << error_path{ this->path_ });
+		}
+		return true;
+	}
+#else
+	if (wait)
+	{
+#ifdef __APPLE__
+		fslog(trace, "fsync fd={}", this->fd_);
+		const auto rc = ::fsync(this->fd_);
+#else
+		fslog(trace, "fdatasync fd={}", this->fd_);
+		const auto rc = ::fdatasync(this->fd_);
+#endif
+		if (rc == -1)
+		{
+			FLEXFS_THROW(system_exception{} << error_opname{ "fdatasync" } << error_path{ this->path_ });
+		}
+		return true;
+	}
+#ifdef __linux__
+	fslog(trace, "sync_file_range fd={}", this->fd_);
+	if (::sync_file_range(this->fd_, 0, 0, SYNC_FILE_RANGE_WRITE) == 0)
+	{
+		return true;
+	}
+	else if (errno != ENOSYS && errno != EINVAL && errno != ESPIPE)
+	{
+		FLEXFS_THROW(system_exception{} << error_opname{ "sync_file_range" } << error_path{ this->path_ });
+	}
+#endif
+#endif
+	return false;
+}
+
 } // namespace local
 } // namespace flexfs
@@ -20,6 +20,14 @@ public:
 
 	std::size_t read(void* buf, std::size_t count) override;
 	std::size_t write(const void* buf, std::size_t count) override;
+
+	std::uint64_t                seek(std::uint64_t offset) override;
+	void                         truncate(std::uint64_t size) override;
+	std::optional<std::uint64_t> seek_data(std::uint64_t offset) override;
+	std::uint64_t                seek_hole(std::uint64_t offset) override;
+	bool                         allocate(std::uint64_t size) override;
+	bool                         copy_from(i_file& source, std::uint64_t offset, std::uint64_t count, std::uint64_t dest_offset) override;
+	bool                         sync(bool wait) override;
 };
 
 } // namespace local
@@ -0,0 +1,165 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/local/local_mapped_file.h"
+#include "flexfs/core/exceptions.h"
+#include "flexfs/core/logging.h"
+#include "flexfs/core/formatters.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace flexfs {
+namespace local {
+
+namespace {
+
+int convert_advice(mapped_file::advice adv)
+{
+	switch (adv)
+	{
+	case mapped_file::advice::NORMAL:
+		return MADV_NORMAL;
+	case mapped_file::advice::SEQUENTIAL:
+		return MADV_SEQUENTIAL;
+	case mapped_file::advice::RANDOM:
+		return MADV_RANDOM;
+	case mapped_file::advice::WILLNEED:
+		return MADV_WILLNEED;
+	}
+	FLEXFS_THROW(should_not_happen_exception{});
+}
+
+} // namespace
+
+mapped_file::mapped_file(int fd, const fspath& path, advice adv, std::shared_ptr<i_interruptor> interruptor)
+    : addr_{ nullptr }
+    , size_{}
+    , pos_{}
+    , path_{ path }
+    , interruptor_{ interruptor }
+{
+	struct ::stat st
+	{
+	};
+	if (::fstat(fd, &st) == -1)
+	{
+		const auto ec = system_exception::getLastErrorCode();
+		::close(fd);
+		FLEXFS_THROW(system_exception{ ec } << error_opname{ "fstat" } << error_path{ this->path_ });
+	}
+
+	this->size_ = static_cast<std::size_t>(st.st_size);
+
+	// A zero length mapping is not allowed, an empty file simply has an empty view.
+	if (this->size_)
+	{
+		fslog(trace, "mmap fd={} size={}", fd, this->size_);
+		const auto addr = ::mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED)
+		{
+			const auto ec = system_exception::getLastErrorCode();
+			::close(fd);
+			FLEXFS_THROW(system_exception{ ec } << error_opname{ "mmap" } << error_path{ this->path_ });
+		}
+		this->addr_ = static_cast<std::byte*>(addr);
+	}
+
+	fslog(trace, "close fd={}", fd);
+	::close(fd);
+
+	this->advise(adv);
+}
+
+mapped_file::~mapped_file() noexcept
+{
+	if (this->addr_)
+	{
+		fslog(trace, "munmap addr={} size={}", fmt::ptr(this->addr_), this->size_);
+		::munmap(this->addr_, this->size_);
+	}
+}
+
+std::span<const std::byte> mapped_file::view() const
+{
+	return std::span<const std::byte>{ this->addr_, this->size_ };
+}
+
+void mapped_file::advise(advice adv)
+{
+	if (this->addr_ && ::madvise(this->addr_, this->size_, convert_advice(adv)) == -1)
+	{
+		// Only a hint, failure is not fatal
+		fslog(warn, "madvise failed on {}: {}", this->path_, system_exception::getLastErrorCode().message());
+	}
+}
+
+std::size_t mapped_file::read(void* buf, std::size_t count)
+{
+	this->interruptor_->throw_if_interrupted();
+	const auto n = this->pos_ < this->size_ ? std::min(count, this->size_ - this->pos_) : std::size_t{};
+	if (n)
+	{
+		std::memcpy(buf, this->addr_ + this->pos_, n);
+		this->pos_ += n;
+	}
+	return n;
+}
+
+std::size_t mapped_file::write(const void* /*buf*/, std::size_t /*count*/)
+{
+	FLEXFS_THROW(system_exception{ std::error_code(EBADF, std::system_category()) }
+	             << error_opname{ "write" } << error_path{ this->path_ });
+}
+
+std::uint64_t mapped_file::seek(std::uint64_t offset)
+{
+	this->pos_ = static_cast<std::size_t>(offset);
+	return offset;
+}
+
+void mapped_file::truncate(std::uint64_t /*size*/)
+{
+	FLEXFS_THROW(system_exception{ std::error_code(EBADF, std::system_category()) }
+	             << error_opname{ "truncate" } << error_path{ this->path_ });
+}
+
+std::optional<std::uint64_t> mapped_file::seek_data(std::uint64_t offset)
+{
+	if (offset < this->size_)
+	{
+		return offset;
+	}
+	return std::nullopt;
+}
+
+std::uint64_t mapped_file::seek_hole(std::uint64_t offset)
+{
+	return std::max(offset, std::uint64_t{ this->size_ });
+}
+
+bool mapped_file::allocate(std::uint64_t /*size*/)
+{
+	FLEXFS_THROW(system_exception{ std::error_code(EBADF, std::system_category()) }
+	             << error_opname{ "fallocate" } << error_path{ this->path_ });
+}
+
+bool mapped_file::copy_from(i_file& /*source*/, std::uint64_t /*offset*/, std::uint64_t /*count*/, std::uint64_t /*dest_offset*/)
+{
+	FLEXFS_THROW(system_exception{ std::error_code(EBADF, std::system_category()) }
+	             << error_opname{ "copy_from" } << error_path{ this->path_ });
+}
+
+bool mapped_file::sync(bool /*wait*/)
+{
+	return true;
+}
+
+} // namespace local
+} // namespace flexfs
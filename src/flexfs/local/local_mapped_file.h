@@ -0,0 +1,67 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include "flexfs/core/i_file.h"
+#include "flexfs/core/i_interruptor.h"
+#include "flexfs/core/fspath.h"
+#include <memory>
+#include <span>
+#include <cstddef>
+
+namespace flexfs {
+namespace local {
+
+/// @brief Read-only file backed by a memory mapping.
+/// Besides the regular i_file interface, the mapped contents can be accessed directly through view(),
+/// which allows consumers to hash or parse a file without copying it into a buffer first.
+class FLEXFS_EXPORT mapped_file final : public i_file
+{
+public:
+	enum class advice
+	{
+		NORMAL,     // MADV_NORMAL
+		SEQUENTIAL, // MADV_SEQUENTIAL
+		RANDOM,     // MADV_RANDOM
+		WILLNEED    // MADV_WILLNEED
+	};
+
+private:
+	std::byte*                     addr_;
+	std::size_t                    size_;
+	std::size_t                    pos_;
+	fspath                         path_;
+	std::shared_ptr<i_interruptor> interruptor_;
+
+public:
+	/// Maps the file opened as @a fd. The file descriptor is owned by this object and is closed
+	/// before the constructor returns, the mapping itself stays valid until destruction.
+	explicit mapped_file(int fd, const fspath& path, advice adv, std::shared_ptr<i_interruptor> interruptor);
+	~mapped_file() noexcept;
+
+	mapped_file(const mapped_file&)            = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	std::span<const std::byte> view() const;
+	void                       advise(advice adv);
+
+	std::size_t read(void* buf, std::size_t count) override;
+	std::size_t write(const void* buf, std::size_t count) override; // always throws, the mapping is read-only
+
+	std::uint64_t                seek(std::uint64_t offset) override;
+	void                         truncate(std::uint64_t size) override; // always throws, the mapping is read-only
+	std::optional<std::uint64_t> seek_data(std::uint64_t offset) override;
+	std::uint64_t                seek_hole(std::uint64_t offset) override;
+	bool                         allocate(std::uint64_t size) override; // always throws, the mapping is read-only
+	bool copy_from(i_file& source, std::uint64_t offset, std::uint64_t count, std::uint64_t dest_offset) override; // always throws
+	bool sync(bool wait) override; // nothing to flush, the mapping is read-only
+};
+
+} // namespace local
+} // namespace flexfs
@@ -11,8 +11,12 @@
 #include "flexfs/core/noop_interruptor.h"
 #include "flexfs/core/direntry.h"
 #include "flexfs/core/i_file.h"
+#include "flexfs/core/digest.h"
 #include <boost/filesystem/operations.hpp>
+#include <chrono>
 #include <optional>
+#include <string>
+#include <vector>
 #include <gtest/gtest.h>
 
 namespace flexfs {
@@ -149,6 +153,193 @@ TEST_F(LocalAccessTests, test_open)
 	EXPECT_NE(a.open(p, O_RDONLY, 0).get(), nullptr);
 }
 
+TEST_F(LocalAccessTests, test_open_direct_io_unaligned)
+{
+	const auto p = this->work_dir() / "file";
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	// Buffer, size and offset are not aligned, the file must fall back to buffered I/O.
+	{
+		auto f = a.open(p, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+		EXPECT_EQ(f->write("hello", 5), 5u);
+		EXPECT_EQ(f->write(" world", 6), 6u);
+	}
+	{
+		auto f   = a.open(p, O_RDONLY | O_DIRECT, 0);
+		char buf[16]{};
+		EXPECT_EQ(f->read(buf, 11), 11u);
+		EXPECT_EQ(std::string(buf, 11), "hello world");
+	}
+}
+
+TEST_F(LocalAccessTests, test_open_sparse)
+{
+	const auto p = this->work_dir() / "file";
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	{
+		auto f = a.open(p, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		EXPECT_EQ(f->write("hello", 5), 5u);
+		EXPECT_EQ(f->seek(1048576u), 1048576u);
+		EXPECT_EQ(f->write("world", 5), 5u);
+		f->truncate(2097152u);
+	}
+	EXPECT_EQ(a.stat(p).size, 2097152u);
+	{
+		auto f = a.open(p, O_RDONLY, 0);
+		// Whether holes are reported depends on the file system, the data must be found regardless.
+		EXPECT_EQ(f->seek_data(0u), 0u);
+		EXPECT_GE(f->seek_hole(0u), 5u);
+		const auto data = f->seek_data(6u);
+		ASSERT_TRUE(data.has_value());
+		EXPECT_LE(data.value(), 1048576u);
+		EXPECT_GE(f->seek_hole(1048576u), 1048581u);
+		EXPECT_EQ(f->seek_data(2097152u), std::nullopt);
+		EXPECT_EQ(f->seek(1048576u), 1048576u);
+		char buf[8]{};
+		EXPECT_EQ(f->read(buf, 5), 5u);
+		EXPECT_EQ(std::string(buf, 5), "world");
+	}
+}
+
+TEST_F(LocalAccessTests, test_open_allocate)
+{
+	const auto p = this->work_dir() / "file";
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	auto       f = a.open(p, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	// Preallocation depends on the file system, the size does not change either way
+	f->allocate(65536u);
+	EXPECT_EQ(a.stat(p).size, 0u);
+	EXPECT_EQ(f->write("hello", 5), 5u);
+	f->truncate(5u);
+	EXPECT_EQ(a.stat(p).size, 5u);
+}
+
+TEST_F(LocalAccessTests, test_try_create)
+{
+	const auto p = this->work_dir() / "file";
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	auto       f = a.try_create(p, O_WRONLY, 0644);
+	ASSERT_NE(f, nullptr);
+	EXPECT_EQ(f->write("hello", 5), 5u);
+	EXPECT_EQ(a.try_create(p, O_WRONLY, 0644), nullptr);
+	EXPECT_EQ(a.stat(p).size, 5u);
+	EXPECT_ANY_THROW(a.try_create(this->work_dir() / "missing" / "file", O_WRONLY, 0644));
+}
+
+TEST_F(LocalAccessTests, test_try_rename)
+{
+	const auto p1 = this->work_dir() / "file1";
+	const auto p2 = this->work_dir() / "file2";
+	const auto p3 = this->work_dir() / "file3";
+	auto       a  = access{ std::make_shared<noop_interruptor>() };
+	this->touch(p1);
+	this->touch(p2);
+	EXPECT_FALSE(a.try_rename(p1, p2));
+	EXPECT_TRUE(a.exists(p1));
+	EXPECT_TRUE(a.try_rename(p1, p3));
+	EXPECT_FALSE(a.exists(p1));
+	EXPECT_TRUE(a.exists(p3));
+	EXPECT_ANY_THROW(a.try_rename(p1, this->work_dir() / "file4"));
+}
+
+TEST_F(LocalAccessTests, test_try_link)
+{
+	const auto p1 = this->work_dir() / "file1";
+	const auto p2 = this->work_dir() / "file2";
+	const auto p3 = this->work_dir() / "file3";
+	auto       a  = access{ std::make_shared<noop_interruptor>() };
+	a.open(p1, O_WRONLY | O_CREAT | O_TRUNC, 0644)->write("abc", 3);
+	this->touch(p2);
+	EXPECT_FALSE(a.try_link(p1, p2));
+	EXPECT_EQ(a.stat(p2).size, 0u);
+	EXPECT_TRUE(a.try_link(p1, p3));
+	EXPECT_TRUE(a.exists(p1));
+	EXPECT_EQ(a.stat(p3).size, 3u);
+	EXPECT_ANY_THROW(a.try_link(this->work_dir() / "missing", this->work_dir() / "file4"));
+}
+
+TEST_F(LocalAccessTests, test_checksum)
+{
+	const auto p = this->work_dir() / "file";
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	a.open(p, O_WRONLY | O_CREAT | O_TRUNC, 0644)->write("abc", 3);
+	for (const auto algorithm : { digest_algorithm::CRC32C, digest_algorithm::XXH3_64, digest_algorithm::SHA256 })
+	{
+		auto digester = make_digester(algorithm);
+		digester->update("abc", 3);
+		EXPECT_EQ(a.checksum(p, algorithm), digester->value());
+	}
+	EXPECT_ANY_THROW(a.checksum(this->work_dir() / "missing", digest_algorithm::CRC32C));
+
+	const auto algorithms = std::vector<digest_algorithm>{ digest_algorithm::SHA256, digest_algorithm::CRC32C };
+	const auto digests    = a.checksums(p, algorithms);
+	ASSERT_EQ(digests.size(), 2u);
+	EXPECT_EQ(digests[0], a.checksum(p, digest_algorithm::SHA256));
+	EXPECT_EQ(digests[1], a.checksum(p, digest_algorithm::CRC32C));
+}
+
+TEST_F(LocalAccessTests, test_copy_from)
+{
+	const auto p1 = this->work_dir() / "file1";
+	const auto p2 = this->work_dir() / "file2";
+	auto       a  = access{ std::make_shared<noop_interruptor>() };
+	a.open(p1, O_WRONLY | O_CREAT | O_TRUNC, 0644)->write("abcdef", 6);
+	auto in  = a.open(p1, O_RDONLY, 0);
+	auto out = a.open(p2, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#ifdef __linux__
+	// Stops at the end of the source file
+	ASSERT_TRUE(out->copy_from(*in, 1u, 100u, 2u));
+	out.reset();
+	char buf[16]{};
+	EXPECT_EQ(a.open(p2, O_RDONLY, 0)->read(buf, sizeof(buf)), 7u);
+	EXPECT_EQ(std::string(buf, 7u), std::string("\0\0bcdef", 7u));
+#else
+	EXPECT_FALSE(out->copy_from(*in, 1u, 100u, 2u));
+#endif
+}
+
+TEST_F(LocalAccessTests, test_set_metadata)
+{
+	const auto p     = this->work_dir() / "file";
+	const auto mtime = std::chrono::system_clock::time_point{ std::chrono::seconds{ 1700000000 } };
+	auto       a     = access{ std::make_shared<noop_interruptor>() };
+	this->touch(p);
+	a.set_metadata(p, mode_t{ 0640 }, mtime);
+	const auto attr = a.stat(p);
+	EXPECT_EQ(attr.get_mode() & 07777, 0640u);
+	EXPECT_EQ(attr.mtime, mtime);
+	a.set_metadata(p, std::nullopt, std::nullopt);
+	EXPECT_ANY_THROW(a.set_metadata(this->work_dir() / "missing", std::nullopt, mtime));
+}
+
+TEST_F(LocalAccessTests, test_sync)
+{
+	const auto p = this->work_dir() / "file";
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	auto       f = a.open(p, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	f->write("abc", 3);
+	EXPECT_TRUE(f->sync(true));
+#ifdef __linux__
+	EXPECT_TRUE(f->sync(false));
+	EXPECT_TRUE(a.sync_fs(this->work_dir()));
+	EXPECT_ANY_THROW(a.sync_fs(this->work_dir() / "missing"));
+#else
+	EXPECT_FALSE(a.sync_fs(this->work_dir()));
+#endif
+}
+
+TEST_F(LocalAccessTests, test_disk_position)
+{
+	const auto p = this->work_dir() / "file";
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	this->touch(p);
+#ifdef BOOST_POSIX_API
+	EXPECT_TRUE(a.disk_position(p, i_access::position_kind::INODE));
+	EXPECT_ANY_THROW(a.disk_position(this->work_dir() / "missing", i_access::position_kind::INODE));
+#endif
+	// An empty file has no extents
+	EXPECT_FALSE(a.disk_position(p, i_access::position_kind::EXTENT));
+}
+
 TEST_F(LocalAccessTests, test_create_watcher)
 {
 	const auto p = this->work_dir() / "dir";
@@ -0,0 +1,141 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "local_fs_test_fixture.h"
+#include "flexfs/local/local_access.h"
+#include "flexfs/core/operations.h"
+#include "flexfs/core/rate_limiter.h"
+#include "flexfs/core/noop_interruptor.h"
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <gtest/gtest.h>
+
+namespace flexfs {
+namespace local {
+
+// Copies between files of the local access, where the kernel can do the copy
+class LocalCopyTests : public LocalFsTestFixture
+{
+protected:
+	void write_file(const fspath& p, const std::string& data) const
+	{
+		auto os = boost::filesystem::ofstream{ p, std::ios::binary };
+		os << data;
+	}
+
+	std::string read_file(const fspath& p) const
+	{
+		auto is = boost::filesystem::ifstream{ p, std::ios::binary };
+		return std::string{ std::istreambuf_iterator<char>{ is }, std::istreambuf_iterator<char>{} };
+	}
+};
+
+TEST_F(LocalCopyTests, test_copy_file)
+{
+	const auto data = std::string(1048576u, 'x');
+	this->write_file(this->work_dir() / "source", data);
+
+	auto       a   = access{ std::make_shared<noop_interruptor>() };
+	const auto dst = destination{ this->work_dir() / "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+
+	auto       progress = std::uint64_t{};
+	const auto result   = copy_file(a, source{ this->work_dir() / "source" }, a, dst, copy_options{}, [&](auto n) { progress = n; });
+	EXPECT_EQ(result.size, data.size());
+	EXPECT_EQ(progress, data.size());
+	EXPECT_EQ(this->read_file(result.dest_path), data);
+}
+
+TEST_F(LocalCopyTests, test_copy_file_rate_limit)
+{
+	const auto data = std::string(393216u, 'x');
+	this->write_file(this->work_dir() / "source", data);
+
+	// The kernel copy would not be limited
+	auto       a        = access{ std::make_shared<noop_interruptor>() };
+	const auto dst      = destination{ this->work_dir() / "destination", std::nullopt, false, destination::conflict_policy::FAIL };
+	auto       opts     = copy_options{};
+	opts.rate_limit     = std::make_shared<rate_limiter>(1048576u, 65536u);
+	const auto start    = std::chrono::steady_clock::now();
+	const auto result   = copy_file(a, source{ this->work_dir() / "source" }, a, dst, opts);
+	const auto duration = std::chrono::steady_clock::now() - start;
+	EXPECT_GE(duration, std::chrono::milliseconds{ 250 });
+	EXPECT_EQ(this->read_file(result.dest_path), data);
+}
+
+TEST_F(LocalCopyTests, test_copy_file_sparse)
+{
+	// Starts with data, has a hole in the middle, if the file system makes one
+	auto data = std::string(100000u, 'a');
+	data.resize(2097152u);
+	data.append(100000u, 'b');
+	{
+		auto os = boost::filesystem::ofstream{ this->work_dir() / "source", std::ios::binary };
+		os.write(data.data(), 100000);
+		os.seekp(2097152);
+		os.write(data.data() + 2097152, 100000);
+	}
+
+	auto a = access{ std::make_shared<noop_interruptor>() };
+	for (const auto mode : { copy_options::sparse_mode::AUTO, copy_options::sparse_mode::ALWAYS })
+	{
+		const auto dst    = destination{ this->work_dir() / "destination", std::nullopt, false, destination::conflict_policy::OVERWRITE };
+		auto       opts   = copy_options{};
+		opts.sparse       = mode;
+		const auto result = copy_file(a, source{ this->work_dir() / "source" }, a, dst, opts);
+		EXPECT_EQ(result.size, data.size());
+		EXPECT_EQ(this->read_file(result.dest_path), data);
+	}
+}
+
+TEST_F(LocalCopyTests, test_hard_link_overwrite)
+{
+	const auto source_path = this->work_dir() / "source";
+	const auto dest_path   = this->work_dir() / "destination";
+	this->write_file(source_path, "new");
+	this->write_file(dest_path, "old");
+
+	auto       a         = access{ std::make_shared<noop_interruptor>() };
+	const auto dst       = destination{ dest_path, std::nullopt, false, destination::conflict_policy::OVERWRITE };
+	auto       opts      = copy_options{};
+	opts.hard_link       = true;
+	const auto temp_path = fspath{ dest_path.string() + ".link" };
+
+	// Replaced by a link, also when it already is one
+	for (auto i = 0; i < 2; ++i)
+	{
+		EXPECT_EQ(copy_file(a, source{ source_path }, a, dst, opts).dest_path, dest_path);
+		EXPECT_EQ(this->read_file(dest_path), "new");
+		EXPECT_EQ(boost::filesystem::hard_link_count(source_path), 2u);
+		EXPECT_FALSE(boost::filesystem::exists(temp_path));
+	}
+}
+
+TEST_F(LocalCopyTests, test_move_file)
+{
+	const auto source_path = this->work_dir() / "source";
+	const auto dest_path   = this->work_dir() / "destination";
+	this->write_file(source_path, "abc");
+
+	// Renamed, also between two accesses
+	auto       a     = access{ std::make_shared<noop_interruptor>() };
+	auto       b     = access{ std::make_shared<noop_interruptor>() };
+	const auto inode = a.disk_position(source_path, i_access::position_kind::INODE);
+	auto       src   = source{ source_path };
+	const auto dst   = destination{ dest_path, std::nullopt, false, destination::conflict_policy::FAIL };
+	EXPECT_EQ(move_file(a, src, b, dst).dest_path, dest_path);
+	EXPECT_EQ(src.current_path, dest_path);
+	EXPECT_FALSE(boost::filesystem::exists(source_path));
+	EXPECT_EQ(this->read_file(dest_path), "abc");
+	EXPECT_EQ(b.disk_position(dest_path, i_access::position_kind::INODE), inode);
+}
+
+} // namespace local
+} // namespace flexfs
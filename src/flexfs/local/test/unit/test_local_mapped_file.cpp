@@ -0,0 +1,83 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "local_fs_test_fixture.h"
+#include "flexfs/local/local_access.h"
+#include "flexfs/local/local_mapped_file.h"
+#include "flexfs/core/noop_interruptor.h"
+#include <boost/filesystem/fstream.hpp>
+#include <array>
+#include <cstring>
+#include <gtest/gtest.h>
+
+namespace flexfs {
+namespace local {
+
+class LocalMappedFileTests : public LocalFsTestFixture
+{
+protected:
+	void write_file(const fspath& p, const std::string& contents) const
+	{
+		auto os = boost::filesystem::ofstream{ p, std::ios::binary };
+		os << contents;
+	}
+};
+
+TEST_F(LocalMappedFileTests, test_view)
+{
+	const auto p = this->work_dir() / "file";
+	this->write_file(p, "hello world");
+	auto       a    = access{ std::make_shared<noop_interruptor>() };
+	const auto f    = a.open_mapped(p);
+	const auto view = f->view();
+	ASSERT_EQ(view.size(), 11u);
+	EXPECT_EQ(std::memcmp(view.data(), "hello world", view.size()), 0);
+}
+
+TEST_F(LocalMappedFileTests, test_view_of_empty_file)
+{
+	const auto p = this->work_dir() / "file";
+	this->touch(p);
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	const auto f = a.open_mapped(p);
+	EXPECT_TRUE(f->view().empty());
+	auto buf = std::array<char, 16>{};
+	EXPECT_EQ(f->read(buf.data(), buf.size()), 0u);
+}
+
+TEST_F(LocalMappedFileTests, test_read)
+{
+	const auto p = this->work_dir() / "file";
+	this->write_file(p, "hello world");
+	auto       a   = access{ std::make_shared<noop_interruptor>() };
+	const auto f   = a.open_mapped(p, mapped_file::advice::WILLNEED);
+	auto       buf = std::array<char, 8>{};
+	ASSERT_EQ(f->read(buf.data(), buf.size()), 8u);
+	EXPECT_EQ(std::memcmp(buf.data(), "hello wo", 8), 0);
+	ASSERT_EQ(f->read(buf.data(), buf.size()), 3u);
+	EXPECT_EQ(std::memcmp(buf.data(), "rld", 3), 0);
+	EXPECT_EQ(f->read(buf.data(), buf.size()), 0u);
+}
+
+TEST_F(LocalMappedFileTests, test_write)
+{
+	const auto p = this->work_dir() / "file";
+	this->write_file(p, "hello world");
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	const auto f = a.open_mapped(p);
+	EXPECT_ANY_THROW(f->write("x", 1));
+}
+
+TEST_F(LocalMappedFileTests, test_open_mapped_nonexistent)
+{
+	const auto p = this->work_dir() / "file";
+	auto       a = access{ std::make_shared<noop_interruptor>() };
+	EXPECT_ANY_THROW(a.open_mapped(p));
+}
+
+} // namespace local
+} // namespace flexfs
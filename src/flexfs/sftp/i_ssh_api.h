@@ -53,26 +53,55 @@ public:
 	virtual const char* ssh_get_error(void* error)                                                                                = 0;
 	virtual char*       ssh_get_hexa(const unsigned char* what, size_t len)                                                       = 0;
 	virtual void        ssh_string_free_char(char* s)                                                                             = 0;
+	virtual ssh_channel ssh_channel_new(ssh_session session)                                                                      = 0;
+	virtual int         ssh_channel_open_session(ssh_channel channel)                                                             = 0;
+	virtual int         ssh_channel_request_exec(ssh_channel channel, const char* cmd)                                            = 0;
+	virtual int         ssh_channel_read(ssh_channel channel, void* dest, uint32_t count, int is_stderr)                          = 0;
+	virtual int         ssh_channel_send_eof(ssh_channel channel)                                                                 = 0;
+	virtual int         ssh_channel_close(ssh_channel channel)                                                                    = 0;
+	virtual void        ssh_channel_free(ssh_channel channel)                                                                     = 0;
+	virtual int         ssh_channel_get_exit_status(ssh_channel channel)                                                          = 0;
 
-	virtual sftp_session    sftp_new(ssh_session session)                                                  = 0;
-	virtual void            sftp_free(sftp_session sftp)                                                   = 0;
-	virtual int             sftp_init(sftp_session sftp)                                                   = 0;
-	virtual sftp_attributes sftp_stat(sftp_session session, const char* path)                              = 0;
-	virtual sftp_attributes sftp_lstat(sftp_session session, const char* path)                             = 0;
-	virtual char*           sftp_readlink(sftp_session sftp, const char* path)                             = 0;
-	virtual sftp_dir        sftp_opendir(sftp_session session, const char* path)                           = 0;
-	virtual int             sftp_closedir(sftp_dir dir)                                                    = 0;
-	virtual sftp_attributes sftp_readdir(sftp_session session, sftp_dir dir)                               = 0;
-	virtual sftp_file       sftp_open(sftp_session session, const char* file, int accesstype, mode_t mode) = 0;
-	virtual int             sftp_close(sftp_file file)                                                     = 0;
-	virtual ssize_t         sftp_read(sftp_file file, void* buf, size_t count)                             = 0;
-	virtual ssize_t         sftp_write(sftp_file file, const void* buf, size_t count)                      = 0;
-	virtual int             sftp_mkdir(sftp_session sftp, const char* directory, mode_t mode)              = 0;
-	virtual int             sftp_rename(sftp_session sftp, const char* original, const char* newname)      = 0;
-	virtual int             sftp_unlink(sftp_session sftp, const char* file)                               = 0;
-	virtual void            sftp_attributes_free(sftp_attributes file)                                     = 0;
-	virtual int             sftp_dir_eof(sftp_dir dir)                                                     = 0;
-	virtual int             sftp_get_error(sftp_session sftp)                                              = 0;
+	virtual sftp_session    sftp_new(ssh_session session)                                                      = 0;
+	virtual void            sftp_free(sftp_session sftp)                                                       = 0;
+	virtual int             sftp_init(sftp_session sftp)                                                       = 0;
+	virtual sftp_attributes sftp_stat(sftp_session session, const char* path)                                  = 0;
+	virtual sftp_attributes sftp_lstat(sftp_session session, const char* path)                                 = 0;
+	virtual char*           sftp_readlink(sftp_session sftp, const char* path)                                 = 0;
+	virtual sftp_dir        sftp_opendir(sftp_session session, const char* path)                               = 0;
+	virtual int             sftp_closedir(sftp_dir dir)                                                        = 0;
+	virtual sftp_attributes sftp_readdir(sftp_session session, sftp_dir dir)                                   = 0;
+	virtual sftp_file       sftp_open(sftp_session session, const char* file, int accesstype, mode_t mode)     = 0;
+	virtual int             sftp_close(sftp_file file)                                                         = 0;
+	virtual ssize_t         sftp_read(sftp_file file, void* buf, size_t count)                                 = 0;
+	virtual ssize_t         sftp_write(sftp_file file, const void* buf, size_t count)                          = 0;
+	virtual int             sftp_seek64(sftp_file file, uint64_t new_offset)                                   = 0;
+	virtual int             sftp_mkdir(sftp_session sftp, const char* directory, mode_t mode)                  = 0;
+	virtual int             sftp_rename(sftp_session sftp, const char* original, const char* newname)          = 0;
+	virtual int             sftp_unlink(sftp_session sftp, const char* file)                                   = 0;
+	virtual int             sftp_setstat(sftp_session sftp, const char* file, sftp_attributes attr)            = 0;
+	virtual void            sftp_attributes_free(sftp_attributes file)                                         = 0;
+	virtual int             sftp_dir_eof(sftp_dir dir)                                                         = 0;
+	virtual int             sftp_get_error(sftp_session sftp)                                                  = 0;
+	virtual int             sftp_extension_supported(sftp_session sftp, const char* name, const char* version) = 0;
+	virtual int             sftp_fsync(sftp_file file)                                                         = 0;
+	virtual int             sftp_copy_data(sftp_file source,
+	                                       uint64_t  read_from,
+	                                       uint64_t  read_length,
+	                                       sftp_file dest,
+	                                       uint64_t  write_to)                                                 = 0;
+	virtual int             sftp_check_file_name(sftp_session   sftp,
+	                                             const char*    path,
+	                                             const char*    algorithm,
+	                                             unsigned char* hash,
+	                                             size_t*        hash_len)                                      = 0;
+	virtual int             sftp_posix_rename(sftp_session sftp, const char* original, const char* newname)    = 0;
+	virtual int             sftp_hardlink(sftp_session sftp, const char* oldpath, const char* newpath)         = 0;
+	virtual int             sftp_limits(sftp_session sftp,
+	                                    uint64_t*    max_packet_length,
+	                                    uint64_t*    max_read_length,
+	                                    uint64_t*    max_write_length,
+	                                    uint64_t*    max_open_handles)                                         = 0;
 };
 
 } // namespace sftp
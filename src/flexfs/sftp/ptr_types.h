@@ -17,6 +17,7 @@ namespace sftp {
 using ssh_key_ptr      = std::shared_ptr<std::remove_pointer<ssh_key>::type>;
 using ssh_session_ptr  = std::shared_ptr<std::remove_pointer<ssh_session>::type>;
 using sftp_session_ptr = std::shared_ptr<std::remove_pointer<sftp_session>::type>;
+using ssh_channel_ptr  = std::shared_ptr<std::remove_pointer<ssh_channel>::type>;
 
 } // namespace sftp
 } // namespace flexfs
@@ -11,11 +11,14 @@
 #include "flexfs/sftp/sftp_watcher.h"
 #include "flexfs/sftp/sftp_session.h"
 #include "flexfs/sftp/ssh_api.h"
+#include "flexfs/sftp/ssh_exec.h"
 #include "flexfs/core/direntry.h"
 #include "flexfs/core/attributes.h"
 #include "flexfs/core/logging.h"
 #include "flexfs/core/formatters.h"
+#include <fmt/format.h>
 #include <optional>
+#include <string_view>
 #include <type_traits>
 #include <chrono>
 #include <cassert>
@@ -29,6 +32,33 @@ namespace {
 
 using sftp_attributes_ptr = std::shared_ptr<std::remove_pointer<sftp_attributes>::type>;
 
+constexpr auto sha256_size     = std::size_t{ 32u };
+constexpr auto xxh3_size       = std::size_t{ 8u };
+constexpr auto max_exec_output = std::size_t{ 4096u }; // of a checksum command
+
+std::optional<std::vector<std::uint8_t>> parse_hex(std::string_view hex)
+{
+	const auto nibble = [](char c) {
+		return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+	};
+	if (hex.size() % 2u)
+	{
+		return std::nullopt;
+	}
+	auto result = std::vector<std::uint8_t>{};
+	for (auto i = std::size_t{}; i < hex.size(); i += 2u)
+	{
+		const auto high = nibble(hex[i]);
+		const auto low  = nibble(hex[i + 1u]);
+		if (high < 0 || low < 0)
+		{
+			return std::nullopt;
+		}
+		result.push_back(static_cast<std::uint8_t>((high << 4) | low));
+	}
+	return result;
+}
+
 attributes::filetype convert_file_type(const sftp_attributes in)
 {
 	switch (in->type)
@@ -209,6 +239,7 @@ class access::impl final : public i_access, public std::enable_shared_from_this<
 	std::shared_ptr<i_interruptor> interruptor_;
 	std::shared_ptr<session>       session_;
 	std::uint32_t                  watcher_scan_interval_ms_;
+	bool                           exec_checksums_;
 
 public:
 	explicit impl(i_ssh_api*                              api,
@@ -220,6 +251,7 @@ public:
 	    , interruptor_{ interruptor }
 	    , session_{ std::make_shared<session>(api, opts, known_hosts, ssh_identity_factory, interruptor) }
 	    , watcher_scan_interval_ms_{ opts.watcher_scan_interval_ms }
+	    , exec_checksums_{ opts.exec_checksums }
 	{
 		fslog(trace, "sftp access: host={}, port={}, user={}", opts.host, opts.port, opts.user);
 		(void)this->api_;
@@ -360,6 +392,18 @@ public:
 	{
 		this->interruptor_->throw_if_interrupted();
 
+		if (this->session_->extensions().posix_rename)
+		{
+			// Replaces newpath, like rename(2)
+			fslog(trace, "sftp_posix_rename oldpath={} newpath={}", oldpath, newpath);
+			if (this->api_->sftp_posix_rename(this->session_->sftp(), oldpath.string().c_str(), newpath.string().c_str()) < 0)
+			{
+				FLEXFS_THROW(sftp_exception(this->session_)
+				             << error_opname{ "sftp_posix_rename" } << error_oldpath{ oldpath } << error_newpath{ newpath });
+			}
+			return;
+		}
+
 		fslog(trace, "sftp_rename oldpath={} newpath={}", oldpath, newpath);
 		if (this->api_->sftp_rename(this->session_->sftp(), oldpath.string().c_str(), newpath.string().c_str()) < 0)
 		{
@@ -368,6 +412,100 @@ public:
 		}
 	}
 
+	bool try_rename(const fspath& oldpath, const fspath& newpath) override
+	{
+		this->interruptor_->throw_if_interrupted();
+
+		// From protocol version 4 on, libssh asks the server to overwrite newpath
+		if (this->session_->sftp()->version >= 4 && this->exists(newpath))
+		{
+			return false;
+		}
+
+		// A version 3 rename fails if newpath exists
+		fslog(trace, "sftp_rename oldpath={} newpath={}", oldpath, newpath);
+		if (this->api_->sftp_rename(this->session_->sftp(), oldpath.string().c_str(), newpath.string().c_str()) < 0)
+		{
+			const auto error = sftp_exception(this->session_)
+			                   << error_opname{ "sftp_rename" } << error_oldpath{ oldpath } << error_newpath{ newpath };
+			if (this->collided(newpath))
+			{
+				return false;
+			}
+			FLEXFS_THROW(error);
+		}
+		return true;
+	}
+
+	bool try_link(const fspath& oldpath, const fspath& newpath) override
+	{
+		this->interruptor_->throw_if_interrupted();
+
+		if (!this->session_->extensions().hardlink)
+		{
+			FLEXFS_THROW(system_exception(std::make_error_code(std::errc::operation_not_supported), "hardlink@openssh.com")
+			             << error_opname{ "sftp_hardlink" } << error_oldpath{ oldpath } << error_newpath{ newpath });
+		}
+
+		fslog(trace, "sftp_hardlink oldpath={} newpath={}", oldpath, newpath);
+		if (this->api_->sftp_hardlink(this->session_->sftp(), oldpath.string().c_str(), newpath.string().c_str()) < 0)
+		{
+			const auto error = sftp_exception(this->session_)
+			                   << error_opname{ "sftp_hardlink" } << error_oldpath{ oldpath } << error_newpath{ newpath };
+			if (this->collided(newpath))
+			{
+				return false;
+			}
+			FLEXFS_THROW(error);
+		}
+		return true;
+	}
+
+	void set_metadata(const fspath&                                        path,
+	                  std::optional<mode_t>                                perms,
+	                  std::optional<std::chrono::system_clock::time_point> mtime) override
+	{
+		this->interruptor_->throw_if_interrupted();
+
+		auto attr = sftp_attributes_struct{};
+		if (perms)
+		{
+			attr.flags |= SSH_FILEXFER_ATTR_PERMISSIONS;
+			attr.permissions = perms.value() & 07777;
+		}
+		if (mtime)
+		{
+			attr.flags |= SSH_FILEXFER_ATTR_ACMODTIME;
+			attr.atime = static_cast<std::uint32_t>(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
+			attr.mtime = static_cast<std::uint32_t>(std::chrono::system_clock::to_time_t(mtime.value()));
+		}
+		if (attr.flags == 0u)
+		{
+			return;
+		}
+
+		fslog(trace, "sftp_setstat path={} flags={:#x}", path, attr.flags);
+		if (this->api_->sftp_setstat(this->session_->sftp(), path.string().c_str(), &attr) < 0)
+		{
+			FLEXFS_THROW(sftp_exception(this->session_) << error_opname{ "sftp_setstat" } << error_path{ path });
+		}
+	}
+
+	bool sync_fs(const fspath& /*path*/) override
+	{
+		return false;
+	}
+
+	std::optional<std::uint64_t> disk_position(const fspath& /*path*/, position_kind /*kind*/) override
+	{
+		return std::nullopt;
+	}
+
+	const server_limits& limits() const
+	{
+		return this->session_->limits();
+	}
+
 	std::unique_ptr<i_file> open(const fspath& path, int flags, mode_t mode) override
 	{
 		this->interruptor_->throw_if_interrupted();
@@ -385,11 +523,117 @@ public:
 		}
 	}
 
+	std::unique_ptr<i_file> try_create(const fspath& path, int flags, mode_t mode) override
+	{
+		this->interruptor_->throw_if_interrupted();
+
+		flags |= O_CREAT | O_EXCL;
+		fslog(trace, "sftp_open path={} flags={:o} mode={:o}", path, flags, mode);
+		const auto fd = this->api_->sftp_open(this->session_->sftp(), path.string().c_str(), flags, mode);
+		fslog(trace, "fd {}", static_cast<void*>(fd));
+		if (fd == nullptr)
+		{
+			const auto error = sftp_exception(this->session_) << error_opname{ "sftp_open" } << error_path{ path };
+			if (this->collided(path))
+			{
+				return nullptr;
+			}
+			FLEXFS_THROW(error);
+		}
+		else
+		{
+			return std::make_unique<file>(this->api_, fd, path, this->session_, this->interruptor_);
+		}
+	}
+
 	std::shared_ptr<i_watcher> create_watcher(const fspath& dir, int cancelfd) override
 	{
 		(void)cancelfd;
 		return std::make_shared<watcher>(dir, this->watcher_scan_interval_ms_, this->shared_from_this(), this->interruptor_);
 	}
+
+	std::optional<digest> checksum(const fspath& path, digest_algorithm algorithm) override
+	{
+		this->interruptor_->throw_if_interrupted();
+
+		auto command = std::string{};
+		switch (algorithm)
+		{
+		case digest_algorithm::SHA256:
+			if (this->session_->extensions().check_file)
+			{
+				unsigned char hash[64];
+				auto          hash_len = sizeof(hash);
+				if (this->api_->sftp_check_file_name(this->session_->sftp(), path.string().c_str(), "sha256", hash, &hash_len) == SSH_OK
+				    && hash_len == sha256_size)
+				{
+					return digest{ algorithm, std::vector<std::uint8_t>(hash, hash + hash_len) };
+				}
+				fslog(debug, "check-file-name failed for {}", path);
+			}
+			command = fmt::format("sha256sum -b -- {}", shell_quote(path.string()));
+			break;
+		case digest_algorithm::XXH3_64:
+			command = fmt::format("xxhsum -H3 -- {}", shell_quote(path.string()));
+			break;
+		case digest_algorithm::CRC32C:
+			return std::nullopt;
+		}
+
+		if (!this->exec_checksums_)
+		{
+			return std::nullopt;
+		}
+
+		// The output is "<hex> <path>", xxhsum may prefix the hex with "XXH3_"
+		const auto result = ssh_exec(this->api_, this->session_->ssh(), command, *this->interruptor_, max_exec_output);
+		if (!result)
+		{
+			return std::nullopt;
+		}
+		if (result->exit_status != 0)
+		{
+			fslog(debug, "{} exited with status {}", command, result->exit_status);
+			return std::nullopt;
+		}
+		auto hex = std::string_view{ result->output };
+		hex      = hex.substr(0u, hex.find_first_of(" \t\n"));
+		if (hex.starts_with("XXH3_"))
+		{
+			hex.remove_prefix(5u);
+		}
+		auto value = parse_hex(hex);
+		if (!value || value->size() != (algorithm == digest_algorithm::SHA256 ? sha256_size : xxh3_size))
+		{
+			fslog(debug, "unexpected output of {}: {}", command, result->output);
+			return std::nullopt;
+		}
+		return digest{ algorithm, std::move(value.value()) };
+	}
+
+private:
+	// Whether the last request failed because path exists. Servers such as OpenSSH report this as a generic
+	// failure, then path is checked.
+	bool collided(const fspath& path)
+	{
+		switch (this->api_->sftp_get_error(this->session_->sftp()))
+		{
+		case SSH_FX_FILE_ALREADY_EXISTS:
+			return true;
+		case SSH_FX_FAILURE:
+		{
+			const auto attrib = this->api_->sftp_lstat(this->session_->sftp(), path.string().c_str());
+			if (attrib)
+			{
+				this->api_->sftp_attributes_free(attrib);
+				return true;
+			}
+			return false;
+		}
+		default:
+			return false;
+		}
+	}
 };
 
 namespace {
@@ -472,5 +716,45 @@ std::shared_ptr<i_watcher> access::create_watcher(const fspath& dir, int cancelf
 	return this->pimpl_->create_watcher(dir, cancelfd);
 }
 
+std::unique_ptr<i_file> access::try_create(const fspath& path, int flags, mode_t mode)
+{
+	return this->pimpl_->try_create(path, flags, mode);
+}
+
+bool access::try_rename(const fspath& oldpath, const fspath& newpath)
+{
+	return this->pimpl_->try_rename(oldpath, newpath);
+}
+
+bool access::try_link(const fspath& oldpath, const fspath& newpath)
+{
+	return this->pimpl_->try_link(oldpath, newpath);
+}
+
+void access::set_metadata(const fspath& path, std::optional<mode_t> perms, std::optional<std::chrono::system_clock::time_point> mtime)
+{
+	this->pimpl_->set_metadata(path, perms, mtime);
+}
+
+bool access::sync_fs(const fspath& path)
+{
+	return this->pimpl_->sync_fs(path);
+}
+
+std::optional<std::uint64_t> access::disk_position(const fspath& path, position_kind kind)
+{
+	return this->pimpl_->disk_position(path, kind);
+}
+
+const server_limits& access::limits() const
+{
+	return this->pimpl_->limits();
+}
+
+std::optional<digest> access::checksum(const fspath& path, digest_algorithm algorithm)
+{
+	return this->pimpl_->checksum(path, algorithm);
+}
+
 } // namespace sftp
 } // namespace flexfs
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "flexfs/sftp/sftp_options.h"
+#include "flexfs/sftp/sftp_limits.h"
 #include "flexfs/sftp/i_ssh_knownhosts.h"
 #include "flexfs/sftp/i_ssh_identity_factory.h"
 #include "flexfs/core/i_access.h"
@@ -48,7 +49,29 @@ public:
 	void                       mkdir(const fspath& path, bool parents) override;
 	void                       rename(const fspath& oldpath, const fspath& newpath) override;
 	std::unique_ptr<i_file>    open(const fspath& path, int flags, mode_t mode) override;
+	std::unique_ptr<i_file>    try_create(const fspath& path, int flags, mode_t mode) override;
+	bool                       try_rename(const fspath& oldpath, const fspath& newpath) override;
+	bool                       try_link(const fspath& oldpath, const fspath& newpath) override;
 	std::shared_ptr<i_watcher> create_watcher(const fspath& dir, int cancelfd) override;
+
+	// Uses the check-file-name extension for SHA-256 where offered, and otherwise runs sha256sum or xxhsum over
+	// an exec channel if options::exec_checksums allows it. Not available for CRC32C, nor when the command cannot
+	// be run.
+	std::optional<digest> checksum(const fspath& path, digest_algorithm algorithm) override;
+
+	// The modification time is set with a resolution of one second, as SFTP version 3 has no subsecond times
+	void set_metadata(const fspath&                                        path,
+	                  std::optional<mode_t>                                perms,
+	                  std::optional<std::chrono::system_clock::time_point> mtime) override;
+
+	// Not supported by SFTP, returns false. Files are synced one by one instead, see file::sync.
+	bool sync_fs(const fspath& path) override;
+
+	// The placement of remote files is not known, returns std::nullopt.
+	std::optional<std::uint64_t> disk_position(const fspath& path, position_kind kind) override;
+
+	// The request sizes the server accepts. Reads and writes of files are split and merged to use them.
+	const server_limits& limits() const;
 };
 
 } // namespace sftp
@@ -8,16 +8,38 @@
 #include "flexfs/sftp/sftp_file.h"
 #include "flexfs/sftp/sftp_exceptions.h"
 #include "flexfs/core/logging.h"
+#include "flexfs/core/formatters.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <fcntl.h>
 
 namespace flexfs {
 namespace sftp {
 
+namespace {
+
+// Largest amount copied by one copy-data request, which the server completes before it replies.
+constexpr auto copy_chunk_size = std::uint64_t{ 67108864u };
+
+// Maximum length of the data of one request, zero when the server did not announce it
+std::size_t max_request_length(std::uint64_t limit)
+{
+	return static_cast<std::size_t>(std::min<std::uint64_t>(limit, std::numeric_limits<std::size_t>::max()));
+}
+
+} // namespace
+
 file::file(i_ssh_api* api, sftp_file fd, const fspath& path, std::shared_ptr<session> session, std::shared_ptr<i_interruptor> interruptor)
     : api_{ api }
     , fd_{ fd }
     , path_{ path }
     , session_{ session }
     , interruptor_{ interruptor }
+    , offset_{}
+    , read_ahead_{}
+    , read_pos_{}
 {
 }
 
@@ -27,7 +49,7 @@ file::~file() noexcept
 	this->api_->sftp_close(this->fd_);
 }
 
-std::size_t file::read(void* buf, std::size_t count)
+std::size_t file::read_request(void* buf, std::size_t count)
 {
 	this->interruptor_->throw_if_interrupted();
 	fslog(trace, "sftp_read fd={} count={}", fmt::ptr(this->fd_), count);
@@ -39,7 +61,7 @@ std::size_t file::read(void* buf, std::size_t count)
 	return static_cast<std::size_t>(rc);
 }
 
-std::size_t file::write(const void* buf, std::size_t count)
+std::size_t file::write_request(const void* buf, std::size_t count)
 {
 	this->interruptor_->throw_if_interrupted();
 	fslog(trace, "sftp_write fd={} count={}", fmt::ptr(this->fd_), count);
@@ -51,5 +73,217 @@ std::size_t file::write(const void* buf, std::size_t count)
 	return static_cast<std::size_t>(rc);
 }
 
+void file::discard_read_ahead()
+{
+	if (this->read_pos_ < this->read_ahead_.size())
+	{
+		// The server is ahead of the caller, move it back
+		this->seek(this->offset_);
+	}
+	else
+	{
+		this->read_ahead_.clear();
+		this->read_pos_ = 0u;
+	}
+}
+
+std::size_t file::read(void* buf, std::size_t count)
+{
+	auto result = std::size_t{};
+	if (this->read_pos_ < this->read_ahead_.size())
+	{
+		result = std::min(count, this->read_ahead_.size() - this->read_pos_);
+		std::memcpy(buf, this->read_ahead_.data() + this->read_pos_, result);
+		this->read_pos_ += result;
+		this->offset_ += result;
+		return result;
+	}
+
+	const auto max_length = max_request_length(this->session_->limits().max_read_length);
+	if (max_length == 0u)
+	{
+		result = this->read_request(buf, count);
+		this->offset_ += result;
+	}
+	else if (count < max_length)
+	{
+		// Merged into one request of the maximum size, the rest is kept for the next reads. Nothing is kept
+		// when the request fails.
+		this->read_ahead_.resize(max_length);
+		try
+		{
+			this->read_ahead_.resize(this->read_request(this->read_ahead_.data(), max_length));
+		}
+		catch (...)
+		{
+			this->read_ahead_.clear();
+			this->read_pos_ = 0u;
+			throw;
+		}
+		result = std::min(count, this->read_ahead_.size());
+		std::memcpy(buf, this->read_ahead_.data(), result);
+		this->read_pos_ = result;
+		this->offset_ += result;
+	}
+	else
+	{
+		// Split into requests of the maximum size, up to the end of the file
+		auto ptr = static_cast<char*>(buf);
+		while (result < count)
+		{
+			const auto length = std::min(count - result, max_length);
+			const auto n      = this->read_request(ptr + result, length);
+			result += n;
+			this->offset_ += n;
+			if (n < length)
+			{
+				break;
+			}
+		}
+	}
+	return result;
+}
+
+std::size_t file::write(const void* buf, std::size_t count)
+{
+	this->discard_read_ahead();
+
+	const auto max_length = max_request_length(this->session_->limits().max_write_length);
+	auto       result     = std::size_t{};
+	if (max_length == 0u)
+	{
+		result = this->write_request(buf, count);
+		this->offset_ += result;
+	}
+	else
+	{
+		// Split into requests of the maximum size. Not merged, the file cannot be flushed before it is closed.
+		auto ptr = static_cast<const char*>(buf);
+		while (result < count)
+		{
+			const auto length = std::min(count - result, max_length);
+			const auto n      = this->write_request(ptr + result, length);
+			result += n;
+			this->offset_ += n;
+			if (n < length)
+			{
+				break;
+			}
+		}
+	}
+	return result;
+}
+
+std::uint64_t file::seek(std::uint64_t offset)
+{
+	this->read_ahead_.clear();
+	this->read_pos_ = 0u;
+
+	this->interruptor_->throw_if_interrupted();
+	fslog(trace, "sftp_seek64 fd={} offset={}", fmt::ptr(this->fd_), offset);
+	if (this->api_->sftp_seek64(this->fd_, offset) < 0)
+	{
+		FLEXFS_THROW(sftp_exception(this->session_) << error_opname{ "sftp_seek64" } << error_path{ this->path_ });
+	}
+	this->offset_ = offset;
+	return offset;
+}
+
+void file::truncate(std::uint64_t size)
+{
+	this->discard_read_ahead();
+
+	this->interruptor_->throw_if_interrupted();
+	fslog(trace, "sftp_setstat path={} size={}", this->path_, size);
+	// There is no ftruncate in the SFTP protocol, set the size through the path instead
+	auto attr  = sftp_attributes_struct{};
+	attr.flags = SSH_FILEXFER_ATTR_SIZE;
+	attr.size  = size;
+	if (this->api_->sftp_setstat(this->session_->sftp(), this->path_.string().c_str(), &attr) < 0)
+	{
+		FLEXFS_THROW(sftp_exception(this->session_) << error_opname{ "sftp_setstat" } << error_path{ this->path_ });
+	}
+}
+
+std::optional<std::uint64_t> file::seek_data(std::uint64_t offset)
+{
+	return offset;
+}
+
+std::uint64_t file::seek_hole(std::uint64_t /*offset*/)
+{
+	return std::numeric_limits<std::uint64_t>::max();
+}
+
+bool file::allocate(std::uint64_t /*size*/)
+{
+	return false;
+}
+
+bool file::copy_from(i_file& source, std::uint64_t offset, std::uint64_t count, std::uint64_t dest_offset)
+{
+	const auto src = dynamic_cast<file*>(&source);
+	if (!src || !this->session_->extensions().copy_data || !this->session_->same_server(*src->session_))
+	{
+		return false;
+	}
+	if (count == 0u)
+	{
+		return true;
+	}
+	this->discard_read_ahead();
+
+	// Handles are only valid within their session, a file of another session is opened again in this one
+	auto source_fd = src->fd_;
+	auto reopened  = std::unique_ptr<file>{};
+	if (src->session_ != this->session_)
+	{
+		this->interruptor_->throw_if_interrupted();
+		fslog(trace, "sftp_open path={}", src->path_);
+		source_fd = this->api_->sftp_open(this->session_->sftp(), src->path_.string().c_str(), O_RDONLY, 0);
+		if (!source_fd)
+		{
+			FLEXFS_THROW(sftp_exception(this->session_) << error_opname{ "sftp_open" } << error_path{ src->path_ });
+		}
+		reopened = std::make_unique<file>(this->api_, source_fd, src->path_, this->session_, this->interruptor_);
+	}
+
+	// Bounded, to check for interruption now and then
+	for (auto copied = std::uint64_t{}; copied < count;)
+	{
+		this->interruptor_->throw_if_interrupted();
+		const auto chunk = std::min(count - copied, copy_chunk_size);
+		fslog(trace,
+		      "copy-data fd={} offset={} count={} dest fd={} dest offset={}",
+		      fmt::ptr(source_fd),
+		      offset + copied,
+		      chunk,
+		      fmt::ptr(this->fd_),
+		      dest_offset + copied);
+		if (this->api_->sftp_copy_data(source_fd, offset + copied, chunk, this->fd_, dest_offset + copied) < 0)
+		{
+			FLEXFS_THROW(sftp_exception(this->session_) << error_opname{ "copy-data" } << error_path{ this->path_ });
+		}
+		copied += chunk;
+	}
+	return true;
+}
+
+bool file::sync(bool /*wait*/)
+{
+	if (!this->session_->extensions().fsync)
+	{
+		return false;
+	}
+
+	this->interruptor_->throw_if_interrupted();
+	fslog(trace, "sftp_fsync fd={}", fmt::ptr(this->fd_));
+	if (this->api_->sftp_fsync(this->fd_) < 0)
+	{
+		FLEXFS_THROW(sftp_exception(this->session_) << error_opname{ "sftp_fsync" } << error_path{ this->path_ });
+	}
+	return true;
+}
+
 } // namespace sftp
 } // namespace flexfs
@@ -14,11 +14,15 @@
 #include "flexfs/core/fspath.h"
 #include "flexfs/core/api.h"
 #include <memory>
+#include <vector>
 #include <cstddef>
+#include <cstdint>
 
 namespace flexfs {
 namespace sftp {
 
+// Reads and writes are split into requests of the maximum sizes the server announced through the
+// limits@openssh.com extension, and small reads are served from a read-ahead of one maximum size request.
 class FLEXFS_EXPORT file final : public i_file
 {
 	i_ssh_api*                     api_;
@@ -26,6 +30,13 @@ class FLEXFS_EXPORT file final : public i_file
 	fspath                         path_;
 	std::shared_ptr<session>       session_;
 	std::shared_ptr<i_interruptor> interruptor_;
+	std::uint64_t                  offset_;     // as seen by the caller, the server is ahead by the unread read-ahead
+	std::vector<char>              read_ahead_; // read from the server, not yet by the caller
+	std::size_t                    read_pos_;   // in read_ahead_
+
+	std::size_t read_request(void* buf, std::size_t count);
+	std::size_t write_request(const void* buf, std::size_t count);
+	void        discard_read_ahead();
 
 public:
 	explicit file(i_ssh_api*                     api,
@@ -37,6 +48,18 @@ public:
 
 	std::size_t read(void* buf, std::size_t count) override;
 	std::size_t write(const void* buf, std::size_t count) override;
+
+	std::uint64_t                seek(std::uint64_t offset) override;
+	void                         truncate(std::uint64_t size) override;
+	std::optional<std::uint64_t> seek_data(std::uint64_t offset) override; // holes cannot be detected over SFTP
+	std::uint64_t                seek_hole(std::uint64_t offset) override; // holes cannot be detected over SFTP
+	bool                         allocate(std::uint64_t size) override;     // not supported by SFTP, returns false
+
+	// Uses the copy-data extension when source is a file on the same server
+	bool copy_from(i_file& source, std::uint64_t offset, std::uint64_t count, std::uint64_t dest_offset) override;
+
+	// Uses the fsync@openssh.com extension, which always waits
+	bool sync(bool wait) override;
 };
 
 } // namespace sftp
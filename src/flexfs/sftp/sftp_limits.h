@@ -0,0 +1,27 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/core/api.h"
+#include <cstdint>
+
+namespace flexfs {
+namespace sftp {
+
+// Limits of the server, as announced through the limits@openssh.com extension. Zero where not known, the
+// maximum number of open handles is also zero when the server does not limit it.
+struct FLEXFS_EXPORT server_limits
+{
+	std::uint64_t max_packet_length = 0u;
+	std::uint64_t max_read_length   = 0u; // of the data of one read request
+	std::uint64_t max_write_length  = 0u; // of the data of one write request
+	std::uint64_t max_open_handles  = 0u;
+};
+
+} // namespace sftp
+} // namespace flexfs
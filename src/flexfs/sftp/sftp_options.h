@@ -10,6 +10,7 @@
 #include "flexfs/core/api.h"
 #include <string>
 #include <optional>
+#include <vector>
 #include <cstddef>
 
 namespace flexfs {
@@ -28,6 +29,26 @@ struct FLEXFS_EXPORT options
 
 	std::uint32_t watcher_scan_interval_ms = 5000;
 
+	// Let access::checksum run sha256sum or xxhsum on the server when the SFTP check-file-name extension does not
+	// provide the digest. Requires an account with shell access, leave it off for servers that only allow SFTP
+	// (e.g. ForceCommand internal-sftp or a chroot). The file is read back to compute the digest otherwise.
+	bool exec_checksums = false;
+
+	// Algorithm preferences, most preferred first, e.g. { "aes128-gcm@openssh.com", "chacha20-poly1305@openssh.com" }
+	// for ciphers that are cheap on CPUs with AES instructions. An empty list keeps the libssh defaults. The
+	// session fails to connect when the server supports none of the algorithms in a list. The MACs do not
+	// matter for ciphers that authenticate the data themselves, such as the two above.
+	std::vector<std::string> ciphers; // in both directions
+	std::vector<std::string> macs;    // in both directions
+	std::vector<std::string> key_exchanges;
+	std::vector<std::string> host_key_algorithms;
+
+	// SSH compression (zlib) of all traffic of the session, in both directions. Saves time on slow links for
+	// data that compresses well, costs CPU time on fast links. It is negotiated when the session connects, so
+	// use separate sessions for the files that should be compressed and those that should not.
+	bool                        compression = false;
+	std::optional<std::int32_t> compression_level; // 1 (fastest) to 9 (smallest), the libssh default if not set
+
 	enum class ssh_log_level
 	{
 		NOLOG,
@@ -17,6 +17,7 @@
 #include "flexfs/core/logging.h"
 #include "flexfs/core/log_level.h"
 #include "flexfs/core/formatters.h"
+#include <boost/algorithm/string/join.hpp>
 #include <fmt/format.h>
 #include <cassert>
 #include <libssh/callbacks.h>
@@ -87,6 +88,24 @@ class session::impl final
 	ssh_session_ptr                 ssh_;
 	std::unique_ptr<ssh_connection> connection_;
 	sftp_session_ptr                sftp_;
+	server_extensions               extensions_;
+	server_limits                   limits_;
+	std::string                     server_; // user@host:port
+
+	// Sets a comma separated list of algorithms, unless algorithms is empty
+	void set_algorithms(ssh_session ssh, ssh_options_e type, const std::vector<std::string>& algorithms)
+	{
+		if (algorithms.empty())
+		{
+			return;
+		}
+		const auto list = boost::algorithm::join(algorithms, ",");
+		if (this->api_->ssh_options_set(ssh, type, list.c_str()) < 0)
+		{
+			// The message of libssh names the algorithms it does not know
+			FLEXFS_THROW(ssh_exception(ssh) << error_opname{ "ssh_options_set" });
+		}
+	}
 
 	static void connect_status_callback(void* userdata, float status)
 	{
@@ -108,6 +127,9 @@ public:
 	    , ssh_{}
 	    , connection_{}
 	    , sftp_{}
+	    , extensions_{}
+	    , limits_{}
+	    , server_{ fmt::format("{}@{}:{}", opts.user, opts.host, opts.port.value_or(22u)) }
 	{
 		this->api_->ssh_set_log_callback(ssh_logging_callback);
 
@@ -136,6 +158,20 @@ public:
 		const auto verbosity = convert_ssh_logging_verbosity(opts.ssh_logging_verbosity);
 		this->api_->ssh_options_set(ssh.get(), SSH_OPTIONS_LOG_VERBOSITY, &verbosity);
 
+		this->set_algorithms(ssh.get(), SSH_OPTIONS_CIPHERS_C_S, opts.ciphers);
+		this->set_algorithms(ssh.get(), SSH_OPTIONS_CIPHERS_S_C, opts.ciphers);
+		this->set_algorithms(ssh.get(), SSH_OPTIONS_HMAC_C_S, opts.macs);
+		this->set_algorithms(ssh.get(), SSH_OPTIONS_HMAC_S_C, opts.macs);
+		this->set_algorithms(ssh.get(), SSH_OPTIONS_KEY_EXCHANGE, opts.key_exchanges);
+		this->set_algorithms(ssh.get(), SSH_OPTIONS_HOSTKEYS, opts.host_key_algorithms);
+
+		this->api_->ssh_options_set(ssh.get(), SSH_OPTIONS_COMPRESSION, opts.compression ? "yes" : "no");
+		if (opts.compression_level)
+		{
+			const auto level = int{ opts.compression_level.value() };
+			this->api_->ssh_options_set(ssh.get(), SSH_OPTIONS_COMPRESSION_LEVEL, &level);
+		}
+
 		auto connection = std::make_unique<ssh_connection>(this->api_, ssh);
 
 		this->interruptor_->throw_if_interrupted();
@@ -297,6 +333,43 @@ public:
 			}
 		}
 
+		this->extensions_.copy_data    = this->api_->sftp_extension_supported(sftp.get(), "copy-data", "1") != 0;
+		this->extensions_.check_file   = this->api_->sftp_extension_supported(sftp.get(), "check-file-name", "1") != 0;
+		this->extensions_.posix_rename = this->api_->sftp_extension_supported(sftp.get(), "posix-rename@openssh.com", "1") != 0;
+		this->extensions_.hardlink     = this->api_->sftp_extension_supported(sftp.get(), "hardlink@openssh.com", "1") != 0;
+		this->extensions_.fsync        = this->api_->sftp_extension_supported(sftp.get(), "fsync@openssh.com", "1") != 0;
+		this->extensions_.limits       = this->api_->sftp_extension_supported(sftp.get(), "limits@openssh.com", "1") != 0;
+		fslog(debug,
+		      "server extensions: copy-data={}, check-file-name={}, posix-rename={}, hardlink={}, fsync={}, limits={}",
+		      this->extensions_.copy_data,
+		      this->extensions_.check_file,
+		      this->extensions_.posix_rename,
+		      this->extensions_.hardlink,
+		      this->extensions_.fsync,
+		      this->extensions_.limits);
+
+		if (this->extensions_.limits)
+		{
+			auto&      l  = this->limits_;
+			const auto rc = this->api_->sftp_limits(
+			    sftp.get(), &l.max_packet_length, &l.max_read_length, &l.max_write_length, &l.max_open_handles);
+			if (rc == SSH_OK)
+			{
+				fslog(debug,
+				      "server limits: packet={}, read={}, write={}, open handles={}",
+				      l.max_packet_length,
+				      l.max_read_length,
+				      l.max_write_length,
+				      l.max_open_handles);
+			}
+			else
+			{
+				// Not needed to work with the server, the request sizes of libssh are used instead
+				fslog(warn, "limits@openssh.com failed: {}", this->api_->ssh_get_error(ssh.get()));
+				l = server_limits{};
+			}
+		}
+
 		this->connection_ = std::move(connection);
 		this->ssh_        = ssh;
 		this->sftp_       = sftp;
@@ -318,6 +391,21 @@ public:
 	{
 		return this->sftp_.get();
 	}
+
+	const server_extensions& extensions() const
+	{
+		return this->extensions_;
+	}
+
+	const server_limits& limits() const
+	{
+		return this->limits_;
+	}
+
+	const std::string& server() const
+	{
+		return this->server_;
+	}
 };
 
 session::session(i_ssh_api*                              api,
@@ -343,5 +431,20 @@ sftp_session session::sftp() const
 	return this->pimpl_->sftp();
 }
 
+const server_extensions& session::extensions() const
+{
+	return this->pimpl_->extensions();
+}
+
+const server_limits& session::limits() const
+{
+	return this->pimpl_->limits();
+}
+
+bool session::same_server(const session& other) const
+{
+	return this->pimpl_->server() == other.pimpl_->server();
+}
+
 } // namespace sftp
 } // namespace flexfs
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "flexfs/sftp/sftp_options.h"
+#include "flexfs/sftp/sftp_limits.h"
 #include "flexfs/sftp/i_ssh_api.h"
 #include "flexfs/sftp/i_ssh_knownhosts.h"
 #include "flexfs/sftp/i_ssh_identity_factory.h"
@@ -20,6 +21,17 @@
 namespace flexfs {
 namespace sftp {
 
+// SFTP protocol extensions offered by the server, detected after sftp_init
+struct server_extensions
+{
+	bool copy_data    = false; // copy-data 1, server side copies between two open files
+	bool check_file   = false; // check-file-name 1, digests computed by the server
+	bool posix_rename = false; // posix-rename@openssh.com 1, rename that replaces an existing file
+	bool hardlink     = false; // hardlink@openssh.com 1, hard links
+	bool fsync        = false; // fsync@openssh.com 1, flushes an open file to stable storage
+	bool limits       = false; // limits@openssh.com 1, maximum request sizes, see server_limits
+};
+
 class FLEXFS_EXPORT session
 {
 	class impl;
@@ -33,8 +45,13 @@ public:
 	                 std::shared_ptr<i_interruptor>          interruptor);
 	~session() noexcept;
 
-	ssh_session  ssh() const;
-	sftp_session sftp() const;
+	ssh_session              ssh() const;
+	sftp_session             sftp() const;
+	const server_extensions& extensions() const;
+	const server_limits&     limits() const;
+
+	// Whether both sessions log in to the same account on the same server, so that a path means the same file
+	bool same_server(const session& other) const;
 };
 
 } // namespace sftp
@@ -6,10 +6,192 @@
 //
 
 #include "flexfs/sftp/ssh_api.h"
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <cstddef>
+#include <cstring>
 
 namespace flexfs {
 namespace sftp {
 
+// libssh 0.11 has functions for the limits@openssh.com and hardlink@openssh.com extensions. The others, and these
+// two with older versions, are requested on the channel of the SFTP session, which needs the members of the SFTP
+// session and file structures. These are known up to libssh 0.11; with a later version, where they may no longer
+// be public, the extensions are reported as not supported instead.
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 11, 0)
+#define FLEXFS_LIBSSH_EXTENSION_FUNCTIONS 1
+#else
+#define FLEXFS_LIBSSH_EXTENSION_FUNCTIONS 0
+#endif
+#if LIBSSH_VERSION_INT < SSH_VERSION_INT(0, 12, 0)
+#define FLEXFS_LIBSSH_RAW_EXTENSIONS 1
+#else
+#define FLEXFS_LIBSSH_RAW_EXTENSIONS 0
+#endif
+
+namespace {
+
+// Upper bound for the size of a reply to an extended request
+constexpr auto max_reply_length = uint32_t{ 256u * 1024u };
+
+void put_uint32(std::string& out, uint32_t value)
+{
+	for (auto shift = 24; shift >= 0; shift -= 8)
+	{
+		out.push_back(static_cast<char>((value >> shift) & 0xffu));
+	}
+}
+
+void put_uint64(std::string& out, uint64_t value)
+{
+	put_uint32(out, static_cast<uint32_t>(value >> 32));
+	put_uint32(out, static_cast<uint32_t>(value));
+}
+
+void put_string(std::string& out, const void* data, std::size_t size)
+{
+	put_uint32(out, static_cast<uint32_t>(size));
+	out.append(static_cast<const char*>(data), size);
+}
+
+void put_string(std::string& out, const char* str)
+{
+	put_string(out, str, std::strlen(str));
+}
+
+uint32_t get_uint32(const char* p)
+{
+	const auto u = reinterpret_cast<const unsigned char*>(p);
+	return (uint32_t{ u[0] } << 24) | (uint32_t{ u[1] } << 16) | (uint32_t{ u[2] } << 8) | uint32_t{ u[3] };
+}
+
+[[maybe_unused]] uint64_t get_uint64(const char* p)
+{
+	return (uint64_t{ get_uint32(p) } << 32) | uint64_t{ get_uint32(p + 4) };
+}
+
+// Reads a string at pos of in and moves pos past it. Returns std::nullopt if in is too short.
+std::optional<std::string> get_string(const std::string& in, std::size_t& pos)
+{
+	if (in.size() - pos < 4u || in.size() - pos - 4u < get_uint32(in.data() + pos))
+	{
+		return std::nullopt;
+	}
+	const auto size = get_uint32(in.data() + pos);
+	auto       str  = in.substr(pos + 4u, size);
+	pos += 4u + size;
+	return str;
+}
+
+bool skip_string(const std::string& in, std::size_t& pos)
+{
+	return get_string(in, pos).has_value();
+}
+
+#if FLEXFS_LIBSSH_RAW_EXTENSIONS
+
+bool read_exact(ssh_channel channel, char* buf, std::size_t count)
+{
+	while (count)
+	{
+		const auto rc = ::ssh_channel_read(channel, buf, static_cast<uint32_t>(count), 0);
+		if (rc <= 0)
+		{
+			return false;
+		}
+		buf += rc;
+		count -= static_cast<std::size_t>(rc);
+	}
+	return true;
+}
+
+void set_error(sftp_session sftp, int code)
+{
+	sftp->errnum = code;
+}
+
+// Sends an SSH_FXP_EXTENDED request, of which request holds the data after the request id, and reads a reply
+// of the expected type. The data after the request id of the reply is returned in reply.
+// The packets are exchanged on the channel of the SFTP session, with a request id taken from the session so it
+// does not collide with those of libssh. Requests are only made synchronously, but a reply to an earlier request
+// that was given up on (e.g. one that libssh stopped waiting for) may still arrive first. Such replies are read
+// and dropped until the one with the request id of this request arrives.
+// An SSH_FXP_STATUS reply sets the error of the SFTP session.
+int extended_request(sftp_session sftp, const std::string& request, uint8_t expected_type, std::string& reply)
+{
+	const auto id = ++sftp->id_counter;
+
+	auto packet = std::string{};
+	put_uint32(packet, static_cast<uint32_t>(request.size() + 5u));
+	packet.push_back(static_cast<char>(SSH_FXP_EXTENDED));
+	put_uint32(packet, id);
+	packet.append(request);
+
+	if (::ssh_channel_write(sftp->channel, packet.data(), static_cast<uint32_t>(packet.size())) != static_cast<int>(packet.size()))
+	{
+		set_error(sftp, SSH_FX_CONNECTION_LOST);
+		return SSH_ERROR;
+	}
+
+	// length, type, request id
+	auto header = std::string(9u, '\0');
+	for (;;)
+	{
+		if (!read_exact(sftp->channel, header.data(), header.size()))
+		{
+			set_error(sftp, SSH_FX_CONNECTION_LOST);
+			return SSH_ERROR;
+		}
+		const auto length = get_uint32(header.data());
+		if (length < 5u || length > max_reply_length)
+		{
+			set_error(sftp, SSH_FX_BAD_MESSAGE);
+			return SSH_ERROR;
+		}
+		reply.resize(length - 5u);
+		if (!read_exact(sftp->channel, reply.data(), reply.size()))
+		{
+			set_error(sftp, SSH_FX_CONNECTION_LOST);
+			return SSH_ERROR;
+		}
+		if (get_uint32(header.data() + 5) == id)
+		{
+			break;
+		}
+	}
+
+	const auto type = static_cast<uint8_t>(header[4]);
+	if (type != expected_type && type != SSH_FXP_STATUS)
+	{
+		set_error(sftp, SSH_FX_BAD_MESSAGE);
+		return SSH_ERROR;
+	}
+	if (type == SSH_FXP_STATUS)
+	{
+		// status code, message, language tag
+		const auto code = reply.size() < 4u ? SSH_FX_BAD_MESSAGE : static_cast<int>(get_uint32(reply.data()));
+		set_error(sftp, code == SSH_FX_OK && expected_type != SSH_FXP_STATUS ? SSH_FX_BAD_MESSAGE : code);
+		return code == SSH_FX_OK && expected_type == SSH_FXP_STATUS ? SSH_OK : SSH_ERROR;
+	}
+	return SSH_OK;
+}
+
+#else
+
+void set_error(sftp_session, int)
+{
+}
+
+int extended_request(sftp_session, const std::string&, uint8_t, std::string&)
+{
+	return SSH_ERROR;
+}
+
+#endif
+
+} // namespace
+
 ssh_api::ssh_api()
 {
 }
@@ -137,6 +319,46 @@ void ssh_api::ssh_string_free_char(char* s)
 	return ::ssh_string_free_char(s);
 }
 
+ssh_channel ssh_api::ssh_channel_new(ssh_session session)
+{
+	return ::ssh_channel_new(session);
+}
+
+int ssh_api::ssh_channel_open_session(ssh_channel channel)
+{
+	return ::ssh_channel_open_session(channel);
+}
+
+int ssh_api::ssh_channel_request_exec(ssh_channel channel, const char* cmd)
+{
+	return ::ssh_channel_request_exec(channel, cmd);
+}
+
+int ssh_api::ssh_channel_read(ssh_channel channel, void* dest, uint32_t count, int is_stderr)
+{
+	return ::ssh_channel_read(channel, dest, count, is_stderr);
+}
+
+int ssh_api::ssh_channel_send_eof(ssh_channel channel)
+{
+	return ::ssh_channel_send_eof(channel);
+}
+
+int ssh_api::ssh_channel_close(ssh_channel channel)
+{
+	return ::ssh_channel_close(channel);
+}
+
+void ssh_api::ssh_channel_free(ssh_channel channel)
+{
+	::ssh_channel_free(channel);
+}
+
+int ssh_api::ssh_channel_get_exit_status(ssh_channel channel)
+{
+	return ::ssh_channel_get_exit_status(channel);
+}
+
 sftp_session ssh_api::sftp_new(ssh_session session)
 {
 	return ::sftp_new(session);
@@ -202,6 +424,11 @@ ssize_t ssh_api::sftp_write(sftp_file file, const void* buf, size_t count)
 	return ::sftp_write(file, buf, count);
 }
 
+int ssh_api::sftp_seek64(sftp_file file, uint64_t new_offset)
+{
+	return ::sftp_seek64(file, new_offset);
+}
+
 int ssh_api::sftp_mkdir(sftp_session sftp, const char* directory, mode_t mode)
 {
 	return ::sftp_mkdir(sftp, directory, mode);
@@ -217,6 +444,11 @@ int ssh_api::sftp_unlink(sftp_session sftp, const char* file)
 	return ::sftp_unlink(sftp, file);
 }
 
+int ssh_api::sftp_setstat(sftp_session sftp, const char* file, sftp_attributes attr)
+{
+	return ::sftp_setstat(sftp, file, attr);
+}
+
 void ssh_api::sftp_attributes_free(sftp_attributes file)
 {
 	return ::sftp_attributes_free(file);
@@ -232,5 +464,138 @@ int ssh_api::sftp_get_error(sftp_session sftp)
 	return ::sftp_get_error(sftp);
 }
 
+int ssh_api::sftp_extension_supported(sftp_session sftp, const char* name, const char* version)
+{
+#if !FLEXFS_LIBSSH_RAW_EXTENSIONS
+	// Those that cannot be requested with this version of libssh
+	for (const auto raw : { "copy-data", "check-file-name", "posix-rename@openssh.com" })
+	{
+		if (std::strcmp(name, raw) == 0)
+		{
+			return 0;
+		}
+	}
+#endif
+	return ::sftp_extension_supported(sftp, name, version);
+}
+
+int ssh_api::sftp_fsync(sftp_file file)
+{
+	return ::sftp_fsync(file);
+}
+
+int ssh_api::sftp_copy_data(sftp_file source, uint64_t read_from, uint64_t read_length, sftp_file dest, uint64_t write_to)
+{
+#if FLEXFS_LIBSSH_RAW_EXTENSIONS
+	auto request = std::string{};
+	put_string(request, "copy-data");
+	put_string(request, ssh_string_data(source->handle), ssh_string_len(source->handle));
+	put_uint64(request, read_from);
+	put_uint64(request, read_length);
+	put_string(request, ssh_string_data(dest->handle), ssh_string_len(dest->handle));
+	put_uint64(request, write_to);
+
+	auto reply = std::string{};
+	return extended_request(dest->sftp, request, SSH_FXP_STATUS, reply);
+#else
+	(void)source, (void)read_from, (void)read_length, (void)dest, (void)write_to;
+	return SSH_ERROR;
+#endif
+}
+
+int ssh_api::sftp_check_file_name(sftp_session sftp, const char* path, const char* algorithm, unsigned char* hash, size_t* hash_len)
+{
+	// Hash the whole file (offset 0, length 0) as one block (block size 0)
+	auto request = std::string{};
+	put_string(request, "check-file-name");
+	put_string(request, path);
+	put_string(request, algorithm);
+	put_uint64(request, 0u);
+	put_uint64(request, 0u);
+	put_uint32(request, 0u);
+
+	// The reply has the name of the extension and the algorithm that was used, followed by the hash
+	auto reply = std::string{};
+	if (extended_request(sftp, request, SSH_FXP_EXTENDED_REPLY, reply) != SSH_OK)
+	{
+		return SSH_ERROR;
+	}
+	auto pos = std::size_t{};
+	if (!skip_string(reply, pos) || get_string(reply, pos) != algorithm || reply.size() - pos > *hash_len)
+	{
+		set_error(sftp, SSH_FX_BAD_MESSAGE);
+		return SSH_ERROR;
+	}
+	*hash_len = reply.size() - pos;
+	std::copy(reply.begin() + static_cast<std::ptrdiff_t>(pos), reply.end(), hash);
+	return SSH_OK;
+}
+
+int ssh_api::sftp_posix_rename(sftp_session sftp, const char* original, const char* newname)
+{
+	auto request = std::string{};
+	put_string(request, "posix-rename@openssh.com");
+	put_string(request, original);
+	put_string(request, newname);
+
+	auto reply = std::string{};
+	return extended_request(sftp, request, SSH_FXP_STATUS, reply);
+}
+
+int ssh_api::sftp_hardlink(sftp_session sftp, const char* oldpath, const char* newpath)
+{
+#if FLEXFS_LIBSSH_EXTENSION_FUNCTIONS
+	return ::sftp_hardlink(sftp, oldpath, newpath);
+#else
+	auto request = std::string{};
+	put_string(request, "hardlink@openssh.com");
+	put_string(request, oldpath);
+	put_string(request, newpath);
+
+	auto reply = std::string{};
+	return extended_request(sftp, request, SSH_FXP_STATUS, reply);
+#endif
+}
+
+int ssh_api::sftp_limits(sftp_session sftp,
+                         uint64_t*    max_packet_length,
+                         uint64_t*    max_read_length,
+                         uint64_t*    max_write_length,
+                         uint64_t*    max_open_handles)
+{
+#if FLEXFS_LIBSSH_EXTENSION_FUNCTIONS
+	const auto limits = ::sftp_limits(sftp);
+	if (!limits)
+	{
+		return SSH_ERROR;
+	}
+	*max_packet_length = limits->max_packet_length;
+	*max_read_length   = limits->max_read_length;
+	*max_write_length  = limits->max_write_length;
+	*max_open_handles  = limits->max_open_handles;
+	::sftp_limits_free(limits);
+	return SSH_OK;
+#else
+	auto request = std::string{};
+	put_string(request, "limits@openssh.com");
+
+	auto reply = std::string{};
+	if (extended_request(sftp, request, SSH_FXP_EXTENDED_REPLY, reply) != SSH_OK)
+	{
+		return SSH_ERROR;
+	}
+	if (reply.size() < 32u)
+	{
+		set_error(sftp, SSH_FX_BAD_MESSAGE);
+		return SSH_ERROR;
+	}
+	*max_packet_length = get_uint64(reply.data());
+	*max_read_length   = get_uint64(reply.data() + 8);
+	*max_write_length  = get_uint64(reply.data() + 16);
+	*max_open_handles  = get_uint64(reply.data() + 24);
+	return SSH_OK;
+#endif
+}
+
 } // namespace sftp
 } // namespace flexfs
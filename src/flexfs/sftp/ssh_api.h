@@ -51,6 +51,14 @@ public:
 	const char* ssh_get_error(void* error) override;
 	char*       ssh_get_hexa(const unsigned char* what, size_t len) override;
 	void        ssh_string_free_char(char* s) override;
+	ssh_channel ssh_channel_new(ssh_session session) override;
+	int         ssh_channel_open_session(ssh_channel channel) override;
+	int         ssh_channel_request_exec(ssh_channel channel, const char* cmd) override;
+	int         ssh_channel_read(ssh_channel channel, void* dest, uint32_t count, int is_stderr) override;
+	int         ssh_channel_send_eof(ssh_channel channel) override;
+	int         ssh_channel_close(ssh_channel channel) override;
+	void        ssh_channel_free(ssh_channel channel) override;
+	int         ssh_channel_get_exit_status(ssh_channel channel) override;
 
 	sftp_session    sftp_new(ssh_session session) override;
 	void            sftp_free(sftp_session sftp) override;
@@ -65,12 +73,27 @@ public:
 	int             sftp_close(sftp_file file) override;
 	ssize_t         sftp_read(sftp_file file, void* buf, size_t count) override;
 	ssize_t         sftp_write(sftp_file file, const void* buf, size_t count) override;
+	int             sftp_seek64(sftp_file file, uint64_t new_offset) override;
 	int             sftp_mkdir(sftp_session sftp, const char* directory, mode_t mode) override;
 	int             sftp_rename(sftp_session sftp, const char* original, const char* newname) override;
 	int             sftp_unlink(sftp_session sftp, const char* file) override;
+	int             sftp_setstat(sftp_session sftp, const char* file, sftp_attributes attr) override;
 	void            sftp_attributes_free(sftp_attributes file) override;
 	int             sftp_dir_eof(sftp_dir dir) override;
 	int             sftp_get_error(sftp_session sftp) override;
+	int             sftp_extension_supported(sftp_session sftp, const char* name, const char* version) override;
+	int             sftp_fsync(sftp_file file) override;
+
+	// SFTP extensions that libssh has no functions for
+	int sftp_copy_data(sftp_file source, uint64_t read_from, uint64_t read_length, sftp_file dest, uint64_t write_to) override;
+	int sftp_check_file_name(sftp_session sftp, const char* path, const char* algorithm, unsigned char* hash, size_t* hash_len) override;
+	int sftp_posix_rename(sftp_session sftp, const char* original, const char* newname) override;
+	int sftp_hardlink(sftp_session sftp, const char* oldpath, const char* newpath) override;
+	int sftp_limits(sftp_session sftp,
+	                uint64_t*    max_packet_length,
+	                uint64_t*    max_read_length,
+	                uint64_t*    max_write_length,
+	                uint64_t*    max_open_handles) override;
 };
 
 } // namespace sftp
@@ -0,0 +1,94 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "flexfs/sftp/ssh_exec.h"
+#include "flexfs/sftp/sftp_exceptions.h"
+#include "flexfs/sftp/ptr_types.h"
+#include "flexfs/core/exceptions.h"
+#include "flexfs/core/logging.h"
+#include <algorithm>
+
+namespace flexfs {
+namespace sftp {
+
+std::optional<ssh_exec_result> ssh_exec(i_ssh_api*         api,
+                                        ssh_session        session,
+                                        const std::string& command,
+                                        i_interruptor&     interruptor,
+                                        std::size_t        max_output)
+{
+	interruptor.throw_if_interrupted();
+
+	fslog(trace, "ssh exec command={}", command);
+	const auto channel = ssh_channel_ptr{ api->ssh_channel_new(session), [api](auto c) { api->ssh_channel_free(c); } };
+	if (!channel)
+	{
+		fslog(debug, "ssh_channel_new failed: {}", api->ssh_get_error(session));
+		return std::nullopt;
+	}
+	if (api->ssh_channel_open_session(channel.get()) != SSH_OK)
+	{
+		fslog(debug, "ssh_channel_open_session failed: {}", api->ssh_get_error(session));
+		return std::nullopt;
+	}
+	if (api->ssh_channel_request_exec(channel.get(), command.c_str()) != SSH_OK)
+	{
+		// Refused, e.g. by a server without shell access
+		fslog(debug, "ssh_channel_request_exec failed: {}", api->ssh_get_error(session));
+		api->ssh_channel_close(channel.get());
+		return std::nullopt;
+	}
+
+	// No input. A server that runs something else instead, such as sftp-server for ForceCommand internal-sftp,
+	// then exits rather than waiting for it.
+	api->ssh_channel_send_eof(channel.get());
+
+	auto result = ssh_exec_result{ -1, {} };
+	char buf[4096];
+	for (;;)
+	{
+		interruptor.throw_if_interrupted();
+		const auto rc = api->ssh_channel_read(channel.get(), buf, sizeof(buf), 0);
+		if (rc < 0)
+		{
+			fslog(debug, "ssh_channel_read failed: {}", api->ssh_get_error(session));
+			api->ssh_channel_close(channel.get());
+			return std::nullopt;
+		}
+		else if (rc == 0)
+		{
+			break;
+		}
+		result.output.append(buf, std::min(static_cast<std::size_t>(rc), max_output - result.output.size()));
+	}
+
+	api->ssh_channel_close(channel.get());
+	result.exit_status = api->ssh_channel_get_exit_status(channel.get());
+	fslog(trace, "ssh exec exit status={}", result.exit_status);
+	return result;
+}
+
+std::string shell_quote(const std::string& arg)
+{
+	auto result = std::string{ "'" };
+	for (const auto c : arg)
+	{
+		if (c == '\'')
+		{
+			result += "'\\''";
+		}
+		else
+		{
+			result += c;
+		}
+	}
+	result += '\'';
+	return result;
+}
+
+} // namespace sftp
+} // namespace flexfs
@@ -0,0 +1,37 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "flexfs/sftp/i_ssh_api.h"
+#include "flexfs/core/i_interruptor.h"
+#include <optional>
+#include <string>
+#include <cstddef>
+
+namespace flexfs {
+namespace sftp {
+
+struct ssh_exec_result
+{
+	int         exit_status;
+	std::string output; // standard output, truncated to max_output bytes
+};
+
+// Runs a command on the server over an exec channel of the SSH session. The command gets no input. Returns
+// std::nullopt when the command cannot be run, e.g. on a server that only allows SFTP.
+std::optional<ssh_exec_result> ssh_exec(i_ssh_api*         api,
+                                        ssh_session        session,
+                                        const std::string& command,
+                                        i_interruptor&     interruptor,
+                                        std::size_t        max_output);
+
+// Quotes an argument for a POSIX shell
+std::string shell_quote(const std::string& arg);
+
+} // namespace sftp
+} // namespace flexfs
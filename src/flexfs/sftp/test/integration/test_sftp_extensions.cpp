@@ -0,0 +1,237 @@
+//
+// Copyright (C) 2023 Patrick Rotsaert
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Tests the SFTP extensions against a real SSH server, through the libssh that is built with. They are skipped
+// unless FLEXFS_TEST_SFTP_HOST is set. Further settings are read from the environment:
+//   FLEXFS_TEST_SFTP_PORT      default 22
+//   FLEXFS_TEST_SFTP_USER      default $USER
+//   FLEXFS_TEST_SFTP_PASSWORD  the private keys in ~/.ssh are used if not set
+//   FLEXFS_TEST_SFTP_DIR       a writable directory on the server, default /tmp
+// The host key is not verified. A test is skipped when the server does not offer the extension it tests.
+
+#include "flexfs/sftp/sftp_access.h"
+#include "flexfs/core/attributes.h"
+#include "flexfs/core/i_file.h"
+#include "flexfs/core/noop_interruptor.h"
+#include "flexfs/core/exceptions.h"
+#include <boost/exception/get_error_info.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+namespace flexfs {
+namespace sftp {
+
+namespace {
+
+class accept_all_hosts final : public i_ssh_known_hosts
+{
+public:
+	result verify(const std::string& /*host*/, const std::string& /*pubkey_hash*/) override
+	{
+		return result::KNOWN;
+	}
+
+	void persist(const std::string& /*host*/, const std::string& /*pubkey_hash*/) override
+	{
+	}
+};
+
+class home_ssh_identities final : public i_ssh_identity_factory
+{
+public:
+	std::vector<std::shared_ptr<ssh_identity>> create() override
+	{
+		auto       result = std::vector<std::shared_ptr<ssh_identity>>{};
+		const auto home   = std::getenv("HOME");
+		if (!home)
+		{
+			return result;
+		}
+		for (const auto name : { "id_ed25519", "id_ecdsa", "id_rsa" })
+		{
+			auto file = std::ifstream{ std::string{ home } + "/.ssh/" + name };
+			if (file)
+			{
+				auto pkey = std::ostringstream{};
+				pkey << file.rdbuf();
+				result.push_back(std::make_shared<ssh_identity>(ssh_identity{ name, pkey.str() }));
+			}
+		}
+		return result;
+	}
+};
+
+std::string getenv_or(const char* name, const std::string& fallback)
+{
+	const auto value = std::getenv(name);
+	return value ? std::string{ value } : fallback;
+}
+
+} // namespace
+
+class SftpExtensionTests : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		const auto host = std::getenv("FLEXFS_TEST_SFTP_HOST");
+		if (!host)
+		{
+			GTEST_SKIP() << "FLEXFS_TEST_SFTP_HOST is not set";
+		}
+
+		auto opts = options{};
+		opts.host = host;
+		opts.port = static_cast<std::uint16_t>(std::stoul(getenv_or("FLEXFS_TEST_SFTP_PORT", "22")));
+		opts.user = getenv_or("FLEXFS_TEST_SFTP_USER", getenv_or("USER", ""));
+		if (const auto password = std::getenv("FLEXFS_TEST_SFTP_PASSWORD"))
+		{
+			opts.password = password;
+		}
+
+		this->access_ = std::make_shared<access>(
+		    opts, std::make_shared<accept_all_hosts>(), std::make_shared<home_ssh_identities>(), std::make_shared<noop_interruptor>());
+
+		this->dir_    = fspath{ getenv_or("FLEXFS_TEST_SFTP_DIR", "/tmp") };
+		this->prefix_ = "flexfs-integration-test-" + std::to_string(::getpid()) + "-";
+	}
+
+	void TearDown() override
+	{
+		if (this->access_)
+		{
+			for (const auto name : { "source", "destination", "link" })
+			{
+				if (this->access_->exists(this->path(name)))
+				{
+					this->access_->remove(this->path(name));
+				}
+			}
+		}
+	}
+
+	// Of a file in the test directory, with a name that does not collide with other test runs
+	fspath path(const std::string& name) const
+	{
+		return this->dir_ / (this->prefix_ + name);
+	}
+
+	void write_file(const fspath& path, const std::string& data)
+	{
+		auto file = this->access_->open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		EXPECT_EQ(file->write(data.data(), data.size()), data.size());
+	}
+
+	std::string read_file(const fspath& path)
+	{
+		auto file = this->access_->open(path, O_RDONLY, 0);
+		auto data = std::string{};
+		auto buf  = std::string(65536u, '\0');
+		while (const auto n = file->read(buf.data(), buf.size()))
+		{
+			data.append(buf, 0u, n);
+		}
+		return data;
+	}
+
+	std::shared_ptr<access> access_;
+	fspath                  dir_;
+	std::string             prefix_;
+};
+
+TEST_F(SftpExtensionTests, test_limits)
+{
+	const auto& limits = this->access_->limits();
+	if (!limits.max_packet_length)
+	{
+		GTEST_SKIP() << "limits@openssh.com is not offered";
+	}
+	EXPECT_GT(limits.max_read_length, 0u);
+	EXPECT_GT(limits.max_write_length, 0u);
+	EXPECT_LE(limits.max_read_length, limits.max_packet_length);
+	EXPECT_LE(limits.max_write_length, limits.max_packet_length);
+}
+
+TEST_F(SftpExtensionTests, test_posix_rename)
+{
+	// Overwrites the existing file, also when requested several times on the session
+	for (auto i = 0; i < 3; ++i)
+	{
+		const auto data = "new " + std::to_string(i);
+		this->write_file(this->path("source"), data);
+		this->write_file(this->path("destination"), "old");
+		this->access_->rename(this->path("source"), this->path("destination"));
+		EXPECT_FALSE(this->access_->exists(this->path("source")));
+		EXPECT_EQ(this->read_file(this->path("destination")), data);
+	}
+}
+
+TEST_F(SftpExtensionTests, test_hard_link)
+{
+	this->write_file(this->path("source"), "abc");
+	try
+	{
+		EXPECT_TRUE(this->access_->try_link(this->path("source"), this->path("link")));
+	}
+	catch (const system_exception& e)
+	{
+		const auto ec = boost::get_error_info<error_code>(e);
+		if (ec && *ec == std::errc::operation_not_supported)
+		{
+			GTEST_SKIP() << "hardlink@openssh.com is not offered";
+		}
+		throw;
+	}
+	EXPECT_FALSE(this->access_->try_link(this->path("source"), this->path("link")));
+	EXPECT_EQ(this->read_file(this->path("link")), "abc");
+
+	// Both names refer to the same file
+	this->write_file(this->path("source"), "def");
+	EXPECT_EQ(this->read_file(this->path("link")), "def");
+}
+
+TEST_F(SftpExtensionTests, test_copy_data)
+{
+	const auto data = std::string(40000u, 'x') + "end";
+	this->write_file(this->path("source"), data);
+
+	auto source = this->access_->open(this->path("source"), O_RDONLY, 0);
+	auto dest   = this->access_->open(this->path("destination"), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (!dest->copy_from(*source, 0u, data.size(), 0u))
+	{
+		GTEST_SKIP() << "copy-data is not offered";
+	}
+	dest.reset();
+	EXPECT_EQ(this->read_file(this->path("destination")), data);
+
+	// The session is still in step with libssh
+	EXPECT_EQ(this->access_->stat(this->path("destination")).size, std::optional<uintmax_t>{ data.size() });
+}
+
+TEST_F(SftpExtensionTests, test_checksum)
+{
+	this->write_file(this->path("source"), "abc");
+	const auto digest = this->access_->checksum(this->path("source"), digest_algorithm::SHA256);
+	if (!digest)
+	{
+		GTEST_SKIP() << "check-file-name is not offered";
+	}
+	EXPECT_EQ(digest->to_string(), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	EXPECT_EQ(this->read_file(this->path("source")), "abc");
+}
+
+} // namespace sftp
+} // namespace flexfs